@@ -54,6 +54,52 @@ uint32_t bch3121_decode(uint32_t *message, uint32_t codeword);
  */
 int bch3121_decode_and_correct(uint32_t *message, uint32_t codeword);
 
+/**
+ * Decode 4 interleaved BCH(31,21) codewords in parallel.
+ *
+ * The codewords are bit-sliced: nibble N of the interleaved data holds bit N of
+ * each codeword, with codeword 0 in the least significant bit of the nibble.
+ * This is the layout WaveBird packets use, so packet data can be decoded
+ * without deinterleaving it first.
+ *
+ * @param messages 4-element array to store the 21-bit decoded messages, which may contain errors
+ * @param syndromes 4-element array to store the syndrome of each codeword
+ * @param interleaved the 124-bit interleaved codewords, as 4 32-bit words, least significant word first
+ *
+ * @return bitmask of codewords with non-zero syndromes
+ */
+uint8_t bch3121_decode_x4(uint32_t *messages, uint32_t *syndromes, const uint32_t *interleaved);
+
+/**
+ * Decode 4 interleaved BCH(31,21) codewords in parallel, applying error correction if possible.
+ *
+ * @param messages 4-element array to store the 21-bit decoded messages, if successful
+ * @param interleaved the 124-bit interleaved codewords, see bch3121_decode_x4()
+ *
+ * @return successful decodes will return the total number of corrected errors,
+ *         otherwise a negative error code will be returned
+ */
+int bch3121_decode_and_correct_x4(uint32_t *messages, const uint32_t *interleaved);
+
+/**
+ * Decode 4 interleaved BCH(31,21) codewords in parallel, applying error correction if possible,
+ * and report the result for each codeword.
+ *
+ * Unlike bch3121_decode_and_correct_x4(), every codeword is corrected even if
+ * another one fails, so the caller gets the full picture of a bad packet.
+ *
+ * @param messages 4-element array to store the 21-bit decoded messages
+ * @param syndromes 4-element array to store the syndrome of each codeword
+ * @param corrected 4-element array to store the number of corrected errors in each codeword,
+ *                  or a negative error code if it could not be corrected
+ * @param interleaved the 124-bit interleaved codewords, see bch3121_decode_x4()
+ *
+ * @return successful decodes will return the total number of corrected errors,
+ *         otherwise a negative error code will be returned
+ */
+int bch3121_decode_and_correct_x4_detailed(uint32_t *messages, uint32_t *syndromes, int8_t *corrected,
+                                           const uint32_t *interleaved);
+
 /**
  * Generate a syndrome table for BCH(31,21) error correction.
  *
@@ -0,0 +1,69 @@
+/**
+ * Streaming WaveBird bitstream decoder.
+ *
+ * Finds WaveBird packets in a raw demodulated bitstream, for radios without a
+ * packet handler which can strip the preamble and sync word, and for host-side
+ * analysis of raw captures.
+ *
+ * The bitstream is pushed in chunks of any size, MSB first, and packets may
+ * start at any bit offset. The stream is searched for the end of the preamble
+ * and the sync word (0xAAAA1234), allowing a configurable number of bit errors,
+ * and the 19 bytes which follow are passed to a callback, aligned and ready to
+ * be decoded with wavebird_packet_decode() or similar.
+ *
+ * Only the last 16 bits of the 32-bit preamble are used, since the start of
+ * the preamble is often lost while the receiver settles.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wavebird/packet.h"
+
+// End of the preamble and the sync word, the last bits before each packet
+#define WAVEBIRD_BITSTREAM_SYNC_PATTERN 0xAAAA1234
+
+// Packet callback function
+typedef void (*wavebird_bitstream_packet_fn_t)(const uint8_t *packet, void *context);
+
+/**
+ * Streaming bitstream decoder state.
+ */
+typedef struct {
+  wavebird_bitstream_packet_fn_t packet_fn; // Called with each packet found
+  void *context;                            // Passed to packet_fn
+  uint64_t window;                          // Most recently pushed bits, the latest in the least significant bit
+  uint32_t sync_count;                      // Number of sync patterns found
+  uint8_t max_sync_errors;                  // Bit errors allowed in the sync pattern
+  uint8_t offset;                           // Bit offset of the current packet, relative to the pushed bytes
+  int8_t packet_length;                     // Bytes of the current packet received, or -1 while searching for sync
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];    // The current packet
+} wavebird_bitstream_t;
+
+/**
+ * Initialize a bitstream decoder.
+ *
+ * Allowing a few sync pattern errors finds more packets in a noisy stream,
+ * but each extra error allowed makes false syncs on noise far more likely.
+ * While receiving a false packet, a real packet starting inside it is missed.
+ *
+ * @param bitstream the bitstream decoder
+ * @param max_sync_errors number of bit errors to allow in the sync pattern, 0-2 are sensible values
+ * @param packet_fn callback function for packets found in the stream
+ * @param context passed to the callback function
+ */
+void wavebird_bitstream_init(wavebird_bitstream_t *bitstream, uint8_t max_sync_errors,
+                             wavebird_bitstream_packet_fn_t packet_fn, void *context);
+
+/**
+ * Push the next chunk of the bitstream.
+ *
+ * The packet callback is called for each packet completed by this chunk.
+ *
+ * @param bitstream the bitstream decoder
+ * @param data the next bytes of the bitstream, MSB first
+ * @param length number of bytes
+ */
+void wavebird_bitstream_push(wavebird_bitstream_t *bitstream, const uint8_t *data, size_t length);
@@ -0,0 +1,128 @@
+/**
+ * Multi-controller demultiplexer.
+ *
+ * Every WaveBird on a channel broadcasts to every receiver on that channel,
+ * so a receiver in a room full of controllers sees packets from all of them.
+ * The demultiplexer keeps a small table of the controllers seen recently,
+ * with their last input state and origin, packet counts, and link quality,
+ * so the firmware can choose which controller to listen to by policy.
+ *
+ * Controllers are looked up by their 10-bit controller ID in constant time.
+ * When the table is full, the least recently seen controller is evicted.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wavebird/message.h"
+#include "wavebird/packet.h"
+
+// Number of controllers to track
+#define WAVEBIRD_DEMUX_CONTROLLERS 8
+
+// Marks an unused slot in the controller ID index and LRU list
+#define WAVEBIRD_DEMUX_NONE 0xFF
+
+// Controller selection policies, see wavebird_demux_select()
+enum {
+  WB_DEMUX_SELECT_FIRST_SEEN,  // The controller which has been tracked the longest
+  WB_DEMUX_SELECT_MOST_RECENT, // The controller which sent the most recent packet
+  WB_DEMUX_SELECT_STRONGEST,   // The controller with the best link quality
+};
+
+/**
+ * State of a controller seen on the channel.
+ */
+typedef struct {
+  uint16_t controller_id;
+  bool has_input;             // Set once an input state packet has been decoded
+  bool has_origin;            // Set once an origin packet has been decoded
+  wavebird_gc_state_t input;  // Last input state
+  wavebird_gc_state_t origin; // Last origin
+  uint32_t packets;           // Packets seen, including those which were only partially decoded
+  uint32_t first_seen;        // Timestamp of the first packet since the controller was tracked
+  uint32_t last_seen;         // Timestamp of the most recent packet
+  uint8_t link_quality;       // Moving average of packet quality, 255 for packets without bit errors
+  uint8_t prev;               // Slot of the next more recently seen controller
+  uint8_t next;               // Slot of the next less recently seen controller
+} wavebird_demux_controller_t;
+
+/**
+ * Multi-controller demultiplexer state.
+ */
+typedef struct {
+  wavebird_demux_controller_t controllers[WAVEBIRD_DEMUX_CONTROLLERS];
+  uint8_t index[WB_MESSAGE_HEADER_CONTROLLER_ID + 1]; // Slot of each controller ID, or WAVEBIRD_DEMUX_NONE
+  uint8_t count;                                      // Number of controllers tracked
+  uint8_t most_recent;                                // Head of the LRU list
+  uint8_t least_recent;                               // Tail of the LRU list
+  uint32_t evictions;                                 // Controllers evicted to make room for new ones
+} wavebird_demux_t;
+
+/**
+ * Initialize an empty demultiplexer.
+ *
+ * @param demux the demultiplexer
+ */
+void wavebird_demux_init(wavebird_demux_t *demux);
+
+/**
+ * Record a packet from a controller, without its contents.
+ *
+ * Use this for packets which were dropped after decoding just the header,
+ * see wavebird_packet_decode_header(), so they still count towards the
+ * controller's activity.
+ *
+ * @param demux the demultiplexer
+ * @param controller_id the 10-bit controller ID from the packet header
+ * @param now the current time, in any monotonic unit
+ *
+ * @return the controller's state
+ */
+wavebird_demux_controller_t *wavebird_demux_touch(wavebird_demux_t *demux, uint16_t controller_id, uint32_t now);
+
+/**
+ * Record a decoded packet from a controller.
+ *
+ * @param demux the demultiplexer
+ * @param state the decoded controller state, see wavebird_packet_decode_gc_state()
+ * @param result the packet's decode diagnostics, or NULL to leave the link quality unchanged
+ * @param now the current time, in any monotonic unit
+ *
+ * @return the controller's state
+ */
+wavebird_demux_controller_t *wavebird_demux_update(wavebird_demux_t *demux, const wavebird_gc_state_t *state,
+                                                   const wavebird_decode_result_t *result, uint32_t now);
+
+/**
+ * Find a tracked controller.
+ *
+ * @param demux the demultiplexer
+ * @param controller_id the 10-bit controller ID
+ *
+ * @return the controller's state, or NULL if it isn't tracked
+ */
+wavebird_demux_controller_t *wavebird_demux_find(wavebird_demux_t *demux, uint16_t controller_id);
+
+/**
+ * Stop tracking controllers which have not been seen for a while.
+ *
+ * @param demux the demultiplexer
+ * @param now the current time
+ * @param timeout how long a controller can go without sending a packet before it is dropped
+ *
+ * @return the number of controllers dropped
+ */
+int wavebird_demux_expire(wavebird_demux_t *demux, uint32_t now, uint32_t timeout);
+
+/**
+ * Select a controller by policy.
+ *
+ * @param demux the demultiplexer
+ * @param policy the selection policy, see WB_DEMUX_SELECT_*
+ *
+ * @return the selected controller's state, or NULL if no controllers are tracked
+ */
+wavebird_demux_controller_t *wavebird_demux_select(wavebird_demux_t *demux, int policy);
@@ -0,0 +1,115 @@
+/**
+ * WaveBird DSSS despreader.
+ *
+ * Turns a stream of demodulated chips back into bits, for host-side analysis
+ * of raw chip captures, including marginal signals the radio's own despreader
+ * rejects.
+ *
+ * Each bit is spread into the 15 chips of the WaveBird chipping code (see
+ * radio.h), sent MSB first. A 1 bit is sent as the code and a 0 bit as its
+ * complement. Chips are pushed as signed soft samples (positive for a 1 chip),
+ * at 1 to WAVEBIRD_DESPREADER_MAX_OVERSAMPLE samples per chip, or as packed
+ * hard chips.
+ *
+ * While searching, the code is correlated against the samples ending at every
+ * sample offset. Once the normalized correlation crosses the lock threshold,
+ * one bit is produced per code period, and chip timing is tracked by also
+ * correlating one sample early and one sample late, moving by a sample once
+ * either correlates best for a few bits in a row. Lock is dropped after a run
+ * of weak correlations, such as at the end of a transmission. The search
+ * carries on while locked, and moves to a much stronger correlation once it
+ * is confirmed a bit period later, so a false lock on noise is abandoned as
+ * soon as a real transmission starts.
+ *
+ * Each bit comes with its normalized correlation as a confidence, so the bits
+ * can be packed and searched with the bitstream decoder (see bitstream.h), and
+ * the confidence passed to wavebird_packet_decode_soft() as bit reliability.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DSSS chipping code, and the number of chips per bit
+#define WAVEBIRD_DSSS_CODE  0x164F
+#define WAVEBIRD_DSSS_CHIPS 15
+
+// Most samples per chip supported, and the resulting longest bit period in samples
+#define WAVEBIRD_DESPREADER_MAX_OVERSAMPLE 4
+#define WAVEBIRD_DESPREADER_MAX_SPAN       (WAVEBIRD_DSSS_CHIPS * WAVEBIRD_DESPREADER_MAX_OVERSAMPLE)
+
+// Correlator taps, the longest bit period padded to whole 16-sample blocks
+#define WAVEBIRD_DESPREADER_TAPS ((WAVEBIRD_DESPREADER_MAX_SPAN + 15) / 16 * 16)
+
+// Samples of history kept, must hold at least one bit period and the early and late samples
+#define WAVEBIRD_DESPREADER_HISTORY 256
+
+// Consecutive bits below the unlock threshold before lock is dropped
+#define WAVEBIRD_DESPREADER_LOCK_LOSS_BITS 8
+
+// Most bits one push of a number of samples can produce, for sizing the output buffers
+#define WAVEBIRD_DESPREADER_MAX_BITS(samples) ((samples) / (WAVEBIRD_DSSS_CHIPS - 1) + 1)
+
+/**
+ * Despreader state.
+ */
+typedef struct {
+  int8_t taps[WAVEBIRD_DESPREADER_TAPS];       // Chipping code, +1/-1 per sample, then 0 padding
+  int8_t history[WAVEBIRD_DESPREADER_HISTORY]; // Most recent samples
+  uint16_t fill;                               // Samples in the history
+  uint16_t magnitude;                          // Total magnitude of the samples in the latest bit period
+  uint8_t samples_per_chip;                    // Samples per chip
+  uint8_t span;                                // Samples per bit
+  uint8_t length;                              // Samples correlated per bit, the span padded to whole blocks
+  uint8_t lock_threshold;                      // Confidence needed to lock, 0-255 (default 160)
+  uint8_t unlock_threshold;                    // Confidence below which a bit is weak, 0-255 (default 96)
+  bool locked;                                 // Set while producing bits
+  uint8_t countdown;                           // Samples until the next bit is correlated, while locked
+  uint8_t candidate;                           // Samples until a candidate lock is confirmed, or 0 if none
+  uint8_t strength;                            // Average confidence over the last few bits
+  uint8_t weak_bits;                           // Consecutive weak bits
+  int8_t timing_error;                         // Consecutive bits the early (negative) or late (positive) sample won
+  uint32_t locks;                              // Number of times lock was acquired
+  uint32_t adjustments;                        // Number of chip timing adjustments made while locked
+} wavebird_despreader_t;
+
+/**
+ * Initialize a despreader.
+ *
+ * @param despreader the despreader
+ * @param samples_per_chip number of samples per chip, 1 to WAVEBIRD_DESPREADER_MAX_OVERSAMPLE
+ */
+void wavebird_despreader_init(wavebird_despreader_t *despreader, uint8_t samples_per_chip);
+
+/**
+ * Push the next soft samples of the chip stream.
+ *
+ * @param despreader the despreader
+ * @param bits buffer to store the despread bits, one 0 or 1 per byte, WAVEBIRD_DESPREADER_MAX_BITS(count) entries
+ * @param confidence buffer to store the confidence in each bit (0 = none, 255 = perfect correlation), or NULL
+ * @param samples the next samples, positive for a 1 chip
+ * @param count number of samples
+ *
+ * @return the number of bits produced
+ */
+size_t wavebird_despreader_push(wavebird_despreader_t *despreader, uint8_t *bits, uint8_t *confidence,
+                                const int8_t *samples, size_t count);
+
+/**
+ * Push the next hard chips of the chip stream.
+ *
+ * Each chip is treated as one full-scale sample, so the despreader should be
+ * initialized with 1 sample per chip.
+ *
+ * @param despreader the despreader
+ * @param bits buffer to store the despread bits, one 0 or 1 per byte, WAVEBIRD_DESPREADER_MAX_BITS(count) entries
+ * @param confidence buffer to store the confidence in each bit, or NULL
+ * @param chips the next chips, packed MSB first
+ * @param count number of chips
+ *
+ * @return the number of bits produced
+ */
+size_t wavebird_despreader_push_hard(wavebird_despreader_t *despreader, uint8_t *bits, uint8_t *confidence,
+                                     const uint8_t *chips, size_t count);
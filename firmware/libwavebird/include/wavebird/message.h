@@ -107,6 +107,29 @@ typedef union {
 #define WB_BUTTONS_Y          (1 << 10)
 #define WB_BUTTONS_START      (1 << 11)
 
+/**
+ * Message header bits.
+ */
+#define WB_MESSAGE_HEADER_ORIGIN        (1 << 10)
+#define WB_MESSAGE_HEADER_CONTROLLER_ID 0x3FF
+
+/**
+ * Controller state, decoded straight from a WaveBird packet.
+ *
+ * The buttons and analog values are laid out like the start of a GameCube
+ * controller's SI input state (struct si_device_gc_input_state), so they can
+ * be copied into the SI response without any further unpacking. The buttons
+ * are remapped to the SI button bits, with the SI status bits left clear.
+ *
+ * For origin messages the buttons are clear, and the analog values are the
+ * origin values.
+ */
+typedef struct {
+  uint16_t header;    // 16-bit message header (see above)
+  uint8_t buttons[2]; // Start, Y, X, B, A in bits 4-0, then L, R, Z, Up, Down, Right, Left in bits 6-0
+  uint8_t analog[6];  // Stick X/Y, C-stick X/Y, left/right analog trigger
+} wavebird_gc_state_t;
+
 /**
  * Get the controller ID from the header of a WaveBird message.
  *
@@ -285,4 +308,28 @@ static inline uint8_t wavebird_origin_get_trigger_left(const uint8_t *message)
 static inline uint8_t wavebird_origin_get_trigger_right(const uint8_t *message)
 {
   return (message[7] & 0x0F) << 4 | message[8] >> 4;
-}
\ No newline at end of file
+}
+
+/**
+ * Get the controller ID from a decoded controller state.
+ *
+ * @param state the controller state decoded from a WaveBird packet
+ *
+ * @return the controller ID
+ */
+static inline uint16_t wavebird_gc_state_get_controller_id(const wavebird_gc_state_t *state)
+{
+  return state->header & WB_MESSAGE_HEADER_CONTROLLER_ID;
+}
+
+/**
+ * Get the message type from a decoded controller state.
+ *
+ * @param state the controller state decoded from a WaveBird packet
+ *
+ * @return the message type
+ */
+static inline uint8_t wavebird_gc_state_get_type(const wavebird_gc_state_t *state)
+{
+  return state->header & WB_MESSAGE_HEADER_ORIGIN ? WB_MESSAGE_TYPE_ORIGIN : WB_MESSAGE_TYPE_INPUT_STATE;
+}
@@ -25,12 +25,19 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "wavebird/message.h"
+
 #define WAVEBIRD_PACKET_BYTES 19
+#define WAVEBIRD_PACKET_BITS (WAVEBIRD_PACKET_BYTES * 8)
 #define WAVEBIRD_MESSAGE_BYTES 11
 
+// Number of recently decoded packets a decoder context remembers for history-assisted repair
+#define WAVEBIRD_DECODER_HISTORY 4
+
 /**
  * Packet decoding error codes
  */
@@ -39,9 +46,53 @@ enum {
   WB_PACKET_ERR_DECODE_FAILED,
 };
 
+/**
+ * Packet decoding results, for successful decodes which needed extra work
+ */
+enum {
+  WB_PACKET_RESCUED = 1,
+  WB_PACKET_REPAIRED,
+};
+
 // CRC function prototype, to allow for hardware CRC calculation
 typedef uint16_t (*wavebird_packet_crc_fn_t)(const uint8_t *data, size_t length);
 
+/**
+ * Packet decoder context.
+ *
+ * Holds the configuration and scratch state used to decode and encode packets,
+ * so packets can be decoded from interrupt context, or from multiple threads,
+ * by giving each its own context. A context must only be used by one caller at
+ * a time.
+ *
+ * The wavebird_packet_* functions use a shared default context, so they are
+ * not reentrant.
+ */
+typedef struct {
+  wavebird_packet_crc_fn_t crc_fn;               // See wavebird_decoder_set_crc_fn()
+  uint16_t recovery_budget;                      // See wavebird_decoder_set_recovery_budget()
+  bool history_repair;                           // See wavebird_decoder_set_history_repair()
+  uint8_t history_count;                         // Number of packets in the history
+  uint8_t history_next;                          // Next history entry to replace, once the history is full
+  uint32_t history[WAVEBIRD_DECODER_HISTORY][4]; // Decoded codewords of recent packets, one per controller and type
+  uint8_t crc_state[WAVEBIRD_MESSAGE_BYTES];     // Scratch space for the (transposed) CRC input
+} wavebird_decoder_t;
+
+/**
+ * Per-packet decoding details, see wavebird_packet_decode_ex().
+ *
+ * The number of corrected bits gives an estimate of the pre-FEC bit error
+ * rate, which starts rising well before packets start to be dropped.
+ */
+typedef struct {
+  uint32_t syndromes[4];  // Syndrome of each received codeword, 0 if it was received without errors
+  int8_t corrected[4];    // Bits corrected in each codeword, or a negative error code if it was uncorrectable
+  int8_t failed_codeword; // First codeword which could not be corrected, or -1 if they all decoded
+  uint8_t corrected_bits; // Total bits corrected in the packet, including by recovery or repair
+  uint16_t expected_crc;  // CRC received in the packet
+  uint16_t actual_crc;    // CRC of the decoded message, or 0 if the codewords could not be decoded
+} wavebird_decode_result_t;
+
 /**
  * Get the CRC value from a WaveBird packet.
  *
@@ -93,6 +144,117 @@ static inline void wavebird_packet_set_footer(uint8_t *packet, uint16_t footer)
   packet[18] = footer & 0xFF;
 }
 
+/**
+ * Initialize a decoder context, with the built-in CRC function and recovery disabled.
+ *
+ * @param decoder the decoder context
+ */
+void wavebird_decoder_init(wavebird_decoder_t *decoder);
+
+/**
+ * Set the CRC function a decoder context uses, see wavebird_packet_set_crc_fn().
+ *
+ * @param decoder the decoder context
+ * @param crc_fn function to calculate the CRC, or NULL for the built-in CRC
+ */
+void wavebird_decoder_set_crc_fn(wavebird_decoder_t *decoder, wavebird_packet_crc_fn_t crc_fn);
+
+/**
+ * Set a decoder context's budget for recovering packets, see wavebird_packet_set_recovery_budget().
+ *
+ * @param decoder the decoder context
+ * @param max_candidates maximum number of candidates to check per packet, or 0 to disable recovery
+ */
+void wavebird_decoder_set_recovery_budget(wavebird_decoder_t *decoder, uint16_t max_candidates);
+
+/**
+ * Enable or disable history-assisted repair for a decoder context, see wavebird_packet_set_history_repair().
+ *
+ * @param decoder the decoder context
+ * @param enabled true to enable repair
+ */
+void wavebird_decoder_set_history_repair(wavebird_decoder_t *decoder, bool enabled);
+
+/**
+ * Decode a WaveBird packet into an 84-bit message, using a decoder context.
+ *
+ * See wavebird_packet_decode() for the possible results.
+ *
+ * @param decoder the decoder context
+ * @param message byte array to store the decoded message
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success
+ */
+int wavebird_decoder_decode(wavebird_decoder_t *decoder, uint8_t *message, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet straight into a controller state, using a decoder context.
+ *
+ * See wavebird_packet_decode_gc_state() for details.
+ *
+ * @param decoder the decoder context
+ * @param state the controller state to store the decoded packet in
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success
+ */
+int wavebird_decoder_decode_gc_state(wavebird_decoder_t *decoder, wavebird_gc_state_t *state, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet into an 84-bit message, and report decoding details, using a decoder context.
+ *
+ * See wavebird_packet_decode_ex() for details.
+ *
+ * @param decoder the decoder context
+ * @param message byte array to store the decoded message
+ * @param result the decoding details
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success
+ */
+int wavebird_decoder_decode_ex(wavebird_decoder_t *decoder, uint8_t *message, wavebird_decode_result_t *result,
+                               const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet straight into a controller state, and report decoding details, using a decoder context.
+ *
+ * See wavebird_packet_decode_gc_state() and wavebird_packet_decode_ex() for details.
+ *
+ * @param decoder the decoder context
+ * @param state the controller state to store the decoded packet in
+ * @param result the decoding details
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success
+ */
+int wavebird_decoder_decode_gc_state_ex(wavebird_decoder_t *decoder, wavebird_gc_state_t *state,
+                                        wavebird_decode_result_t *result, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet using per-bit reliability information, using a decoder context.
+ *
+ * See wavebird_packet_decode_soft() for details.
+ *
+ * @param decoder the decoder context
+ * @param message byte array to store the decoded message
+ * @param packet the 19-byte packet from the radio
+ * @param reliability confidence in each bit of the packet, WAVEBIRD_PACKET_BITS entries
+ *
+ * @return negative error code on failure, 0 or a positive result on success
+ */
+int wavebird_decoder_decode_soft(wavebird_decoder_t *decoder, uint8_t *message, const uint8_t *packet,
+                                 const uint8_t *reliability);
+
+/**
+ * Encode a 84-bit message into a WaveBird packet, using a decoder context.
+ *
+ * @param decoder the decoder context
+ * @param packet byte array to store the 19-byte packet
+ * @param message the 84-bit message to encode
+ */
+void wavebird_decoder_encode(wavebird_decoder_t *decoder, uint8_t *packet, const uint8_t *message);
+
 /**
  * Set the CRC function to use for packet encoding and decoding, to allow for
  * hardware CRC calculation when available.
@@ -100,10 +262,60 @@ static inline void wavebird_packet_set_footer(uint8_t *packet, uint16_t footer)
  * Functions must provide a CRC-CCITT implementation, with polynomial 0x1021,
  * and initial value 0x0000.
  *
- * @param crc_fn function to calculate the CRC
+ * @param crc_fn function to calculate the CRC, or NULL for the built-in CRC
  */
 void wavebird_packet_set_crc_fn(wavebird_packet_crc_fn_t crc_fn);
 
+/**
+ * The built-in CRC-CCITT implementation.
+ *
+ * The implementation is chosen at build time, see WAVEBIRD_CRC_CCITT. Packets
+ * only use it when WAVEBIRD_PACKET_CRC_TABLE is disabled and no other CRC
+ * function is set.
+ *
+ * @param data data to calculate the CRC of
+ * @param length length of the data in bytes
+ *
+ * @return the CRC value
+ */
+uint16_t wavebird_packet_crc_ccitt(const uint8_t *data, size_t length);
+
+/**
+ * Set the budget for recovering packets with a single uncorrectable codeword.
+ *
+ * When one codeword has 3 or more errors, but the other 3 decode successfully,
+ * wavebird_packet_decode() can try the 3-error patterns which match the failed
+ * codeword's syndrome, and accept the first one which matches the packet CRC.
+ * A codeword has ~8 such patterns on average, and each candidate costs one
+ * message pack and CRC calculation, so the budget bounds the extra time spent
+ * on a bad packet.
+ *
+ * Recovery is disabled by default.
+ *
+ * @param max_candidates maximum number of candidates to check per packet, or 0 to disable recovery
+ */
+void wavebird_packet_set_recovery_budget(uint16_t max_candidates);
+
+/**
+ * Enable or disable history-assisted repair of packets with a single uncorrectable codeword.
+ *
+ * Consecutive packets from a controller are highly correlated, the header
+ * never changes and many of the analog values rarely do. When repair is
+ * enabled, the decoded codewords of the last good packet of each controller
+ * and message type are remembered (up to WAVEBIRD_DECODER_HISTORY packets).
+ * When one codeword of a packet cannot be corrected, and CRC-guided recovery
+ * (see wavebird_packet_set_recovery_budget()) doesn't find a match, the same
+ * codeword from each remembered packet from that controller is substituted,
+ * and the first one which matches the packet CRC is accepted. If the header
+ * codeword itself failed, every remembered packet is tried.
+ *
+ * Repaired packets are reported with WB_PACKET_REPAIRED. Repair is disabled by
+ * default, and enabling or disabling it clears the history.
+ *
+ * @param enabled true to enable repair
+ */
+void wavebird_packet_set_history_repair(bool enabled);
+
 /**
  * Deinterleave the payload from a WaveBird packet into 4 BCH(31,21) codewords.
  *
@@ -127,14 +339,118 @@ void wavebird_packet_interleave(uint8_t *packet, const uint32_t *codewords);
  * @param packet the 19-byte packet from the radio
  * @param crc_fn function to calculate the CRC
  *
- * @return negative error code on failure, or the packet type on success
- * @retval WB_PACKET_INPUT_STATE if the packet is a valid "input state" packet
- * @retval WB_PACKET_ORIGIN if the packet is a valid "origin" packet
+ * @return negative error code on failure, 0 or a positive result on success
+ * @retval 0 if the packet decoded normally
+ * @retval WB_PACKET_RESCUED if the packet was recovered, see wavebird_packet_set_recovery_budget()
+ * @retval WB_PACKET_REPAIRED if the packet was repaired from history, see wavebird_packet_set_history_repair()
  * @retval -WB_PACKET_ERR_CRC_MISMATCH if CRC check failed
  * @retval -WB_PACKET_ERR_DECODE_FAILED if BCH decoding failed
  */
 int wavebird_packet_decode(uint8_t *message, const uint8_t *packet);
 
+/**
+ * Decode just the header of a WaveBird packet.
+ *
+ * Only the codeword holding the header is decoded, so packets from other
+ * controllers can be rejected for a fraction of the cost of a full decode.
+ * The packet CRC can't be checked without decoding the whole packet, so the
+ * header is unverified: packets which are accepted still need to be decoded
+ * with wavebird_packet_decode() or similar.
+ *
+ * This function does not use a decoder context, and is reentrant.
+ *
+ * @param header the 16-bit message header, see wavebird/message.h
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return 0 on success, or -WB_PACKET_ERR_DECODE_FAILED if the header codeword could not be decoded
+ */
+int wavebird_packet_decode_header(uint16_t *header, const uint8_t *packet);
+
+/**
+ * Decode just the header and buttons of a WaveBird packet.
+ *
+ * Like wavebird_packet_decode_header(), but also decodes the codeword holding
+ * the rest of the button state. The buttons are only meaningful for input
+ * state messages, and are unverified.
+ *
+ * @param header the 16-bit message header, see wavebird/message.h
+ * @param buttons the button state, see WB_BUTTONS_*
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return 0 on success, or -WB_PACKET_ERR_DECODE_FAILED if the codewords could not be decoded
+ */
+int wavebird_packet_decode_buttons(uint16_t *header, uint16_t *buttons, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet into an 84-bit message, and report decoding details.
+ *
+ * Works like wavebird_packet_decode(), but also fills in the syndrome and
+ * number of corrected bits for each codeword, which codeword failed to decode,
+ * and the expected and actual CRC. Every codeword is decoded even if an
+ * earlier one fails. The details are filled in whether decoding succeeds or
+ * not, and cost a few extra cycles only for packets with errors.
+ *
+ * @param message byte array to store the decoded message
+ * @param result the decoding details
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success, see wavebird_packet_decode()
+ */
+int wavebird_packet_decode_ex(uint8_t *message, wavebird_decode_result_t *result, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet straight into a controller state.
+ *
+ * Equivalent to wavebird_packet_decode() followed by unpacking the message
+ * with the wavebird_input_state_get_* or wavebird_origin_get_* functions, but
+ * the fields are unpacked directly from the decoded codewords, without packing
+ * the 84-bit message first.
+ *
+ * @param state the controller state to store the decoded packet in
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success, see wavebird_packet_decode()
+ */
+int wavebird_packet_decode_gc_state(wavebird_gc_state_t *state, const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet straight into a controller state, and report decoding details.
+ *
+ * See wavebird_packet_decode_gc_state() and wavebird_packet_decode_ex().
+ *
+ * @param state the controller state to store the decoded packet in
+ * @param result the decoding details
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return negative error code on failure, 0 or a positive result on success, see wavebird_packet_decode()
+ */
+int wavebird_packet_decode_gc_state_ex(wavebird_gc_state_t *state, wavebird_decode_result_t *result,
+                                       const uint8_t *packet);
+
+/**
+ * Decode a WaveBird packet using per-bit reliability information from the radio.
+ *
+ * Packets which decode normally are returned as-is. Otherwise soft-decision
+ * (Chase) decoding is used: for each codeword, the least reliable bits are
+ * flipped in every combination and decoded again, and the packet CRC is used
+ * to pick the most likely combination of candidates. The least reliable CRC
+ * bits are flipped in the same way. This can recover packets with more than 2
+ * bit errors in a codeword, or with errors in the CRC.
+ *
+ * Candidates which require flipping more than about 3 fully confident bits
+ * are rejected, to keep the chance of accepting a wrong packet low.
+ *
+ * @param message byte array to store the decoded message
+ * @param packet the 19-byte packet from the radio
+ * @param reliability confidence in each bit of the packet (0 = unknown, 255 = certain),
+ *                    in transmission order (MSB of the first byte first), WAVEBIRD_PACKET_BITS entries
+ *
+ * @return 0 or a positive result on success (see wavebird_packet_decode()), negative error code on failure
+ * @retval -WB_PACKET_ERR_CRC_MISMATCH if no candidate matched the CRC
+ * @retval -WB_PACKET_ERR_DECODE_FAILED if a codeword had no candidates
+ */
+int wavebird_packet_decode_soft(uint8_t *message, const uint8_t *packet, const uint8_t *reliability);
+
 /**
  * Encode a 84-bit message into a WaveBird packet.
  *
@@ -0,0 +1,69 @@
+/**
+ * Duplicate packet cache.
+ *
+ * Controllers broadcast an input state packet 250 times per second, and when
+ * nobody is touching the controller every one of them is identical. The cache
+ * remembers the last successfully decoded packet for each controller ID and
+ * message type, so identical packets can skip decoding entirely.
+ *
+ * Only byte-identical packets are matched, so a hit always returns exactly
+ * the message the decoder produced for that packet.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wavebird/packet.h"
+
+// Number of packets to remember, enough for an input state and origin packet from a couple of controllers
+#define WAVEBIRD_PACKET_CACHE_ENTRIES 4
+
+/**
+ * Cached packet, and the controller state it decoded to.
+ */
+struct wavebird_packet_cache_entry {
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  wavebird_gc_state_t state;
+  bool valid;
+};
+
+/**
+ * Duplicate packet cache, and its hit counters.
+ */
+typedef struct {
+  struct wavebird_packet_cache_entry entries[WAVEBIRD_PACKET_CACHE_ENTRIES];
+  uint8_t next_entry;
+  uint32_t hits;
+  uint32_t misses;
+} wavebird_packet_cache_t;
+
+/**
+ * Initialize an empty packet cache, and reset its counters.
+ *
+ * @param cache the packet cache
+ */
+void wavebird_packet_cache_init(wavebird_packet_cache_t *cache);
+
+/**
+ * Look up a packet in the cache.
+ *
+ * @param cache the packet cache
+ * @param state the controller state to store the cached state in, if found
+ * @param packet the 19-byte packet from the radio
+ *
+ * @return true if the packet was found, false if it needs to be decoded
+ */
+bool wavebird_packet_cache_lookup(wavebird_packet_cache_t *cache, wavebird_gc_state_t *state, const uint8_t *packet);
+
+/**
+ * Store a successfully decoded packet in the cache, replacing the previous
+ * packet with the same controller ID and message type.
+ *
+ * @param cache the packet cache
+ * @param packet the 19-byte packet from the radio
+ * @param state the controller state the packet decoded to, see wavebird_packet_decode_gc_state()
+ */
+void wavebird_packet_cache_store(wavebird_packet_cache_t *cache, const uint8_t *packet,
+                                 const wavebird_gc_state_t *state);
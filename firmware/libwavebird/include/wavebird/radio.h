@@ -34,6 +34,13 @@
  *   Once pairing is initiated, the receiver will scan all channels for activity,
  *   and qualify packets based on a user-defined qualification function. Once the
  *   qualification threshold is met, the channel is set.
+ *
+ *   Channels are scanned starting with the channel last paired to, then the
+ *   busiest channels, with quiet channels scanned less often. A channel is
+ *   qualified as soon as a nearby controller is heard on it, otherwise the
+ *   channels controllers were heard on are qualified strongest first after
+ *   each round of scanning, moving on as soon as a channel only sends packets
+ *   which don't qualify.
  */
 
 #pragma once
@@ -41,6 +48,28 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Frequency of channel index 0, and the spacing between channel indexes, in Hz
+#define WAVEBIRD_RADIO_BASE_FREQUENCY  2404800000
+#define WAVEBIRD_RADIO_CHANNEL_SPACING 2400000
+
+// FSK chip rate and frequency deviation, in Hz
+#define WAVEBIRD_RADIO_CHIP_RATE 1440000
+#define WAVEBIRD_RADIO_DEVIATION 580000
+
+// Number of WaveBird channels
+#define WAVEBIRD_RADIO_CHANNELS 16
+
+// Mapping from WaveBird channel number to channel index
+// The channel map is 0-indexed, WaveBird channels on the channel dial are 1-indexed
+#define WAVEBIRD_RADIO_CHANNEL_MAP {31, 29, 0, 2, 6, 4, 8, 10, 14, 12, 17, 19, 23, 21, 25, 27}
+
+// Size of the RX FIFO received packets wait in until wavebird_radio_process() is called, in bytes, a power of two
+// from 64 to 4096
+// Set with the WAVEBIRD_RADIO_RX_FIFO_BYTES CMake option
+#ifndef WAVEBIRD_RADIO_RX_FIFO_BYTES
+#define WAVEBIRD_RADIO_RX_FIFO_BYTES 512
+#endif
+
 // Radio error codes
 enum {
   WB_RADIO_ERR = 1,
@@ -48,6 +77,7 @@ enum {
   WB_RADIO_ERR_NO_PACKET,
   WB_RADIO_ERR_INVALID_PACKET_LENGTH,
   WB_RADIO_ERR_INVALID_CHANNEL,
+  WB_RADIO_ERR_RX_OVERFLOW,
 };
 
 // Pairing callback states
@@ -57,7 +87,7 @@ enum {
   WB_RADIO_PAIRING_TIMEOUT,
 };
 
-// Packet ready callback function
+// Packet ready callback function, the packet is only valid until it returns
 typedef void (*wavebird_radio_packet_fn_t)(const uint8_t *packet);
 
 // Radio error callback function
@@ -70,6 +100,33 @@ typedef bool (*wavebird_radio_qualify_fn_t)(const uint8_t *packet);
 typedef void (*wavebird_radio_pairing_started_fn_t)(void);
 typedef void (*wavebird_radio_pairing_finished_fn_t)(uint8_t status, uint8_t channel);
 
+/**
+ * Receive statistics.
+ *
+ * Packets are passed to the callbacks straight from the RX FIFO, only being
+ * copied out when they wrap around its end. Overflows mean the FIFO filled
+ * up because wavebird_radio_process() wasn't called often enough, use
+ * max_pending to see how close the main loop comes to falling behind.
+ */
+typedef struct {
+  uint32_t packets;         // Packets passed to the packet or qualification callback
+  uint32_t copied_packets;  // Packets copied out of the RX FIFO because they wrapped around its end
+  uint32_t dropped_packets; // Packets released unread, such as those from a channel which didn't qualify
+  uint32_t fifo_overflows;  // Packets lost because the RX FIFO was full
+  uint32_t rx_errors;       // Packets lost to frame errors or aborted
+  uint32_t error_overflows; // Errors not reported because too many happened between calls to wavebird_radio_process()
+  uint32_t max_pending;     // Most packets waiting in the RX FIFO at once
+} wavebird_radio_stats_t;
+
+/**
+ * Received packet details.
+ */
+typedef struct {
+  uint32_t timestamp; // Radio time the packet finished arriving over the air, in microseconds
+  int8_t rssi;        // Received signal strength, in dBm
+  uint8_t channel;    // Channel the packet was received on, 0-15
+} wavebird_radio_packet_info_t;
+
 /**
  * Initialize the radio.
  *
@@ -128,9 +185,37 @@ void wavebird_radio_start_pairing(void);
  */
 void wavebird_radio_stop_pairing(void);
 
+/**
+ * Get the receive statistics.
+ *
+ * @param stats filled with the statistics since the radio was initialized
+ */
+void wavebird_radio_get_stats(wavebird_radio_stats_t *stats);
+
+/**
+ * Get the details of the packet being passed to the packet or qualification callback.
+ *
+ * Packets are timestamped by the radio as they arrive, so comparing the
+ * timestamp with wavebird_radio_get_time() measures how long they waited to
+ * be processed.
+ *
+ * @return the packet's details, valid until the callback returns, or NULL outside the callbacks
+ */
+const wavebird_radio_packet_info_t *wavebird_radio_get_packet_info(void);
+
+/**
+ * Get the radio time, the clock packet timestamps are taken from.
+ *
+ * @return the radio time, in microseconds, wrapping every ~71 minutes
+ */
+uint32_t wavebird_radio_get_time(void);
+
 /**
  * Process radio events.
  *
  * This function should be called periodically to process radio events.
+ * Packets and errors are queued by the radio interrupt, so none are lost
+ * between calls. Queued packets are passed to the packet callback in the
+ * order they arrived, then queued errors to the error callback.
  */
 void wavebird_radio_process(void);
\ No newline at end of file
@@ -0,0 +1,144 @@
+/**
+ * Simulated WaveBird radio, for host builds.
+ *
+ * On the host, radio.h is implemented by the same radio_efr32.c as on the
+ * EFR32, built against a simulated subset of RAIL, so the channel setting,
+ * virtual pairing and packet handling logic is exactly what runs on the
+ * receiver. Time is virtual, and only moves when wavebird_radio_sim_advance()
+ * is called, so runs are deterministic and as fast as the host allows.
+ *
+ * What the radio hears is scripted as a timeline of events, sorted by time:
+ * - Packets: the sync word is detected at the event time, if the radio has
+ *   been listening on the channel for at least WAVEBIRD_RADIO_SIM_DETECT_US,
+ *   and the packet is received WAVEBIRD_RADIO_SIM_PACKET_US later, if the
+ *   radio is still listening on the channel. Only one packet is received at
+ *   a time, a sync word in the middle of another packet is missed.
+ * - Sync words: a sync word detected as for packets, followed by a frame
+ *   error where the packet would end, like a burst from a distant controller.
+ * - RX errors: an aborted packet, on the channel the radio is listening on.
+ *   Any packet being received is lost.
+ * - Calibrations: a calibration becomes necessary, whatever the radio is
+ *   doing, and either succeeds or fails.
+ *
+ * Received packets are stored back to back in a simulated RX FIFO, the one
+ * radio_efr32.c sets up, wrapping around its end, until they are released.
+ * Packets which arrive while it is full are dropped, as RAIL does.
+ *
+ * While the radio is listening, the RSSI is that of the strongest packet or
+ * sync word burst on the channel, from the start of its carrier until it
+ * ends, or WAVEBIRD_RADIO_SIM_NOISE_RSSI when the channel is quiet.
+ *
+ * Events are delivered to radio_efr32.c's RAIL event handler from inside
+ * wavebird_radio_sim_advance(), at their time on the virtual clock, as the
+ * radio interrupt would. Call wavebird_radio_process() between calls to
+ * model the main loop.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wavebird/packet.h"
+#include "wavebird/radio.h"
+
+// Time to send each bit, in nanoseconds
+#define WAVEBIRD_RADIO_SIM_BIT_NS (15 * 1000000000ull / WAVEBIRD_RADIO_CHIP_RATE)
+
+// Time from the end of a packet's sync word to the end of the packet, in microseconds
+#define WAVEBIRD_RADIO_SIM_PACKET_US ((uint32_t)(WAVEBIRD_PACKET_BITS * WAVEBIRD_RADIO_SIM_BIT_NS / 1000))
+
+// Time the radio must be listening on a channel before a sync word ends to detect it, the last byte of the preamble
+// and the sync word, in microseconds
+#define WAVEBIRD_RADIO_SIM_DETECT_US ((uint32_t)(24 * WAVEBIRD_RADIO_SIM_BIT_NS / 1000))
+
+// Time from the start of a transmission's carrier to the end of its sync word, in microseconds
+#define WAVEBIRD_RADIO_SIM_LEAD_US (100 + (uint32_t)(48 * WAVEBIRD_RADIO_SIM_BIT_NS / 1000))
+
+// RSSI of a quiet channel, in dBm
+#define WAVEBIRD_RADIO_SIM_NOISE_RSSI -100
+
+// Size of RAIL's own RX FIFO, used unless the application sets one up with RAILCb_SetupRxFifo(), in bytes
+#define WAVEBIRD_RADIO_SIM_FIFO_BYTES 512
+
+// Timeline event types
+enum {
+  WB_RADIO_SIM_PACKET,
+  WB_RADIO_SIM_SYNC_WORD,
+  WB_RADIO_SIM_RX_ERROR,
+  WB_RADIO_SIM_CALIBRATION,
+  WB_RADIO_SIM_CALIBRATION_ERROR,
+};
+
+/**
+ * Timeline event.
+ */
+typedef struct {
+  uint32_t time;                         // Time of the event, in microseconds, the end of the sync word for packets
+  uint8_t type;                          // See WB_RADIO_SIM_*
+  uint8_t channel;                       // 0-indexed WaveBird channel, ignored for calibrations
+  int8_t rssi;                           // Received signal strength, in dBm, for packets and sync words
+  uint8_t packet[WAVEBIRD_PACKET_BYTES]; // The 19-byte packet, for packets
+} wavebird_radio_sim_event_t;
+
+/**
+ * Simulation statistics.
+ */
+typedef struct {
+  uint32_t packets_received; // Packets received into the RX FIFO
+  uint32_t packets_missed;   // Packets sent while the radio was listening elsewhere or receiving another packet
+  uint32_t packets_aborted;  // Packets lost to an RX error, or by changing channel or idling partway through
+  uint32_t fifo_overflows;   // Packets dropped because the RX FIFO was full
+  uint32_t sync_words;       // Sync words detected, including those of packets
+  uint32_t rx_errors;        // Frame errors and aborted packets
+  uint32_t calibrations;     // Calibrations performed
+  uint32_t channel_changes;  // Times the radio started listening on a different channel
+} wavebird_radio_sim_stats_t;
+
+/**
+ * Reset the simulation.
+ *
+ * Clears the timeline, the RX FIFO and the statistics, idles the radio and
+ * sets the virtual clock to 0. Call before wavebird_radio_init().
+ */
+void wavebird_radio_sim_reset(void);
+
+/**
+ * Set the timeline of events the radio hears.
+ *
+ * Replaces any events which haven't happened yet.
+ *
+ * @param events the events, sorted by time, which must stay valid until the simulation is reset or the timeline is
+ *               replaced
+ * @param count number of events
+ */
+void wavebird_radio_sim_set_timeline(const wavebird_radio_sim_event_t *events, size_t count);
+
+/**
+ * Advance the virtual clock, delivering the events which happen in the meantime.
+ *
+ * @param us time to advance by, in microseconds
+ */
+void wavebird_radio_sim_advance(uint32_t us);
+
+/**
+ * Get the virtual time.
+ *
+ * @return the time since the simulation was reset, in microseconds
+ */
+uint32_t wavebird_radio_sim_get_time(void);
+
+/**
+ * Get the channel the radio is listening on.
+ *
+ * @return the 0-indexed WaveBird channel, or -1 if the radio is idle or on a channel index WaveBird doesn't use
+ */
+int wavebird_radio_sim_get_channel(void);
+
+/**
+ * Get the simulation statistics.
+ *
+ * @return the statistics since the simulation was reset
+ */
+const wavebird_radio_sim_stats_t *wavebird_radio_sim_get_stats(void);
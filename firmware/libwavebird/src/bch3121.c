@@ -2,9 +2,30 @@
 
 #include "wavebird/bch3121.h"
 
+#include "transpose.h"
+
 // Generator polynomial, g(x) = x^10 + x^9 + x^8 + x^6 + x^5 + x^3 + 1
 #define BCH3121_POLYNOMIAL  0b11101101001
 
+// Generator polynomial with one coefficient per nibble, for decoding 4 bit-sliced codewords at once
+#define BCH3121_POLYNOMIAL_X4 0x11101101001ull
+
+#if WAVEBIRD_BCH3121_ALGEBRAIC
+// Primitive polynomial for GF(2^5), p(x) = x^5 + x^2 + 1. The generator polynomial is the product of the minimal
+// polynomials of alpha and alpha^3 in this field.
+#define GF32_POLYNOMIAL 0b100101
+
+/**
+ * Codeword syndromes S1 and S3 contributed by each bit of the decoder syndrome,
+ * packed as S1 | S3 << 5.
+ *
+ * Decoding leaves r(x) = q(x)g(x) + x^21 s(x), and g(x) vanishes at alpha and
+ * alpha^3, so bit k contributes alpha^(k + 21) to S1 and alpha^(3k + 63) to S3.
+ */
+static const uint16_t bch3121_syndrome_basis[] = {
+    0x058, 0x215, 0x28F, 0x23E, 0x399, 0x377, 0x0CB, 0x2B6, 0x329, 0x2D2,
+};
+#else
 /**
  * LUT for error positions based on syndrome, encoded as follows:
  * - Bits 0-1:  Number of errors (0b01 = 1, 0b10 = 2, 0b00 = uncorrectable)
@@ -79,9 +100,73 @@ static const uint16_t bch3121_error_positions[] = {
     0x396, 0xF42, 0xD46, 0x000, 0x000, 0x000, 0x000, 0x912, 0x406, 0xE02, 0x000, 0x000, 0x000, 0x000, 0xF2E, 0xD26,
     0x000, 0x722, 0x000, 0x000, 0xDD2, 0x000, 0xE0A, 0x000, 0x000, 0x000, 0xE9A, 0x000, 0xD32, 0x512, 0x000, 0x000,
 };
+#endif
+
+#if WAVEBIRD_BCH3121_TABLES
+// Number of bits processed per table lookup, 3 lookups cover a 21-bit message
+#define BCH3121_TABLE_BITS  7
+#define BCH3121_TABLE_MASK  ((1 << BCH3121_TABLE_BITS) - 1)
+
+/**
+ * LUT for table-driven encoding, indexed by a 7-bit chunk of the message.
+ *
+ * Each entry is the partial codeword the bit-serial encoder would produce for
+ * that chunk, so a codeword is built from 3 lookups:
+ *   E[m & 0x7F] << 14 ^ E[(m >> 7) & 0x7F] << 7 ^ E[m >> 14]
+ */
+static const uint32_t bch3121_encode_table[] = {
+    0x00000, 0x1DA40, 0x0ED20, 0x13760, 0x07690, 0x1ACD0, 0x09BB0, 0x141F0,
+    0x03B48, 0x1E108, 0x0D668, 0x10C28, 0x04DD8, 0x19798, 0x0A0F8, 0x17AB8,
+    0x01DA4, 0x1C7E4, 0x0F084, 0x12AC4, 0x06B34, 0x1B174, 0x08614, 0x15C54,
+    0x026EC, 0x1FCAC, 0x0CBCC, 0x1118C, 0x0507C, 0x18A3C, 0x0BD5C, 0x1671C,
+    0x00ED2, 0x1D492, 0x0E3F2, 0x139B2, 0x07842, 0x1A202, 0x09562, 0x14F22,
+    0x0359A, 0x1EFDA, 0x0D8BA, 0x102FA, 0x0430A, 0x1994A, 0x0AE2A, 0x1746A,
+    0x01376, 0x1C936, 0x0FE56, 0x12416, 0x065E6, 0x1BFA6, 0x088C6, 0x15286,
+    0x0283E, 0x1F27E, 0x0C51E, 0x11F5E, 0x05EAE, 0x184EE, 0x0B38E, 0x169CE,
+    0x00769, 0x1DD29, 0x0EA49, 0x13009, 0x071F9, 0x1ABB9, 0x09CD9, 0x14699,
+    0x03C21, 0x1E661, 0x0D101, 0x10B41, 0x04AB1, 0x190F1, 0x0A791, 0x17DD1,
+    0x01ACD, 0x1C08D, 0x0F7ED, 0x12DAD, 0x06C5D, 0x1B61D, 0x0817D, 0x15B3D,
+    0x02185, 0x1FBC5, 0x0CCA5, 0x116E5, 0x05715, 0x18D55, 0x0BA35, 0x16075,
+    0x009BB, 0x1D3FB, 0x0E49B, 0x13EDB, 0x07F2B, 0x1A56B, 0x0920B, 0x1484B,
+    0x032F3, 0x1E8B3, 0x0DFD3, 0x10593, 0x04463, 0x19E23, 0x0A943, 0x17303,
+    0x0141F, 0x1CE5F, 0x0F93F, 0x1237F, 0x0628F, 0x1B8CF, 0x08FAF, 0x155EF,
+    0x02F57, 0x1F517, 0x0C277, 0x11837, 0x059C7, 0x18387, 0x0B4E7, 0x16EA7,
+};
+
+/**
+ * LUT for table-driven decoding, indexed by the low 7 bits of the running syndrome.
+ *
+ * Each entry holds the result of 7 bit-serial division steps:
+ * - Bits 0-6:  Decoded message bits, first step in bit 6
+ * - Bits 7-16: Value to XOR into the syndrome once it has been shifted right by 7
+ */
+static const uint32_t bch3121_decode_table[] = {
+    0x00000, 0x0D14A, 0x1A225, 0x1736F, 0x0F092, 0x021D8, 0x152B7, 0x183FD,
+    0x1E109, 0x13043, 0x0432C, 0x09266, 0x1119B, 0x1C0D1, 0x0B3BE, 0x062F4,
+    0x07684, 0x0A7CE, 0x1D4A1, 0x105EB, 0x08616, 0x0575C, 0x12433, 0x1F579,
+    0x1978D, 0x146C7, 0x035A8, 0x0E4E2, 0x1671F, 0x1B655, 0x0C53A, 0x01470,
+    0x0ED02, 0x03C48, 0x14F27, 0x19E6D, 0x01D90, 0x0CCDA, 0x1BFB5, 0x16EFF,
+    0x10C0B, 0x1DD41, 0x0AE2E, 0x07F64, 0x1FC99, 0x12DD3, 0x05EBC, 0x08FF6,
+    0x09B86, 0x04ACC, 0x139A3, 0x1E8E9, 0x06B14, 0x0BA5E, 0x1C931, 0x1187B,
+    0x17A8F, 0x1ABC5, 0x0D8AA, 0x009E0, 0x18A1D, 0x15B57, 0x02838, 0x0F972,
+    0x1DA01, 0x10B4B, 0x07824, 0x0A96E, 0x12A93, 0x1FBD9, 0x088B6, 0x059FC,
+    0x03B08, 0x0EA42, 0x1992D, 0x14867, 0x0CB9A, 0x01AD0, 0x169BF, 0x1B8F5,
+    0x1AC85, 0x17DCF, 0x00EA0, 0x0DFEA, 0x15C17, 0x18D5D, 0x0FE32, 0x02F78,
+    0x04D8C, 0x09CC6, 0x1EFA9, 0x13EE3, 0x0BD1E, 0x06C54, 0x11F3B, 0x1CE71,
+    0x13703, 0x1E649, 0x09526, 0x0446C, 0x1C791, 0x116DB, 0x065B4, 0x0B4FE,
+    0x0D60A, 0x00740, 0x1742F, 0x1A565, 0x02698, 0x0F7D2, 0x184BD, 0x155F7,
+    0x14187, 0x190CD, 0x0E3A2, 0x032E8, 0x1B115, 0x1605F, 0x01330, 0x0C27A,
+    0x0A08E, 0x071C4, 0x102AB, 0x1D3E1, 0x0501C, 0x08156, 0x1F239, 0x12373,
+};
+#endif
 
 uint32_t bch3121_encode(uint32_t message)
 {
+#if WAVEBIRD_BCH3121_TABLES
+  return bch3121_encode_table[message & BCH3121_TABLE_MASK] << (2 * BCH3121_TABLE_BITS) ^
+         bch3121_encode_table[(message >> BCH3121_TABLE_BITS) & BCH3121_TABLE_MASK] << BCH3121_TABLE_BITS ^
+         bch3121_encode_table[(message >> (2 * BCH3121_TABLE_BITS)) & BCH3121_TABLE_MASK];
+#else
   uint32_t codeword = 0;
   for (int i = 0; i < BCH3121_MESSAGE_LEN; i++) {
     codeword <<= 1;
@@ -93,6 +178,7 @@ uint32_t bch3121_encode(uint32_t message)
   }
 
   return codeword;
+#endif
 }
 
 uint32_t bch3121_decode(uint32_t *message, uint32_t codeword)
@@ -100,6 +186,15 @@ uint32_t bch3121_decode(uint32_t *message, uint32_t codeword)
   uint32_t syndrome = codeword;
   *message          = 0;
 
+#if WAVEBIRD_BCH3121_TABLES
+  // Run the division 7 steps at a time
+  for (int i = 0; i < BCH3121_MESSAGE_LEN; i += BCH3121_TABLE_BITS) {
+    uint32_t entry = bch3121_decode_table[syndrome & BCH3121_TABLE_MASK];
+
+    *message = (*message << BCH3121_TABLE_BITS) | (entry & BCH3121_TABLE_MASK);
+    syndrome = (syndrome >> BCH3121_TABLE_BITS) ^ (entry >> BCH3121_TABLE_BITS);
+  }
+#else
   for (int i = 0; i < BCH3121_MESSAGE_LEN; i++) {
     *message <<= 1;
 
@@ -110,18 +205,89 @@ uint32_t bch3121_decode(uint32_t *message, uint32_t codeword)
 
     syndrome >>= 1;
   }
+#endif
 
   return syndrome;
 }
 
-int bch3121_decode_and_correct(uint32_t *message, uint32_t codeword)
+#if WAVEBIRD_BCH3121_ALGEBRAIC
+// Multiply a GF(2^5) element by alpha
+static inline uint8_t gf32_mul_alpha(uint8_t a)
 {
-  // Decode the codeword, immediately return the message if it contains no errors
-  uint32_t syndrome = bch3121_decode(message, codeword);
-  if (!syndrome)
-    return 0;
+  return (a << 1) ^ (a >> 4) * GF32_POLYNOMIAL;
+}
 
-  // There is at least one error, look up the error pattern
+// Multiply a GF(2^5) element by alpha^-1, adding a multiple of p(x) to clear the low bit before shifting it out
+static inline uint8_t gf32_div_alpha(uint8_t a)
+{
+  return (a ^ (a & 1) * GF32_POLYNOMIAL) >> 1;
+}
+
+// Multiply a GF(2^5) element by alpha^-2, p(x) has no x term so both low bits can be cleared at once
+static inline uint8_t gf32_div_alpha2(uint8_t a)
+{
+  return (a ^ (a & 3) * GF32_POLYNOMIAL) >> 2;
+}
+
+// Multiply two GF(2^5) elements
+static uint8_t gf32_mul(uint8_t a, uint8_t b)
+{
+  uint8_t product = 0;
+  for (; b; b >>= 1) {
+    product ^= (b & 1) * a;
+    a = gf32_mul_alpha(a);
+  }
+
+  return product;
+}
+
+// Find the error pattern for a non-zero syndrome, returning the number of errors or a negative error code
+static int bch3121_locate_errors(uint32_t *error, uint32_t syndrome)
+{
+  // Map the decoder syndrome to the codeword syndromes S1 = r(alpha) and S3 = r(alpha^3)
+  uint16_t syndromes = 0;
+  for (int i = 0; i < BCH3121_CODEWORD_LEN - BCH3121_MESSAGE_LEN; i++)
+    syndromes ^= ((syndrome >> i) & 1) * bch3121_syndrome_basis[i];
+
+  uint8_t s1 = syndromes & 0x1F;
+  uint8_t s3 = syndromes >> 5;
+
+  // Both syndromes can't be zero for a non-zero syndrome polynomial, so S1 = 0 means 3 or more errors
+  if (!s1)
+    return -BCH3121_ERR_UNCORRECTABLE;
+
+  // Berlekamp-Massey, unrolled for t = 2, gives the error locator sigma(x) = 1 + S1 x + (d / S1) x^2, where the
+  // discrepancy d = S3 + S1^3 is zero for a single error. Scaling it by S1 keeps the same roots and avoids a division.
+  uint8_t s1_squared  = gf32_mul(s1, s1);
+  uint8_t discrepancy = s3 ^ gf32_mul(s1_squared, s1);
+  uint8_t sigma1      = s1_squared;
+  uint8_t sigma2      = discrepancy;
+  int num_errors      = discrepancy ? 2 : 1;
+
+  // Chien search, bit i is in error if sigma(alpha^-i) = 0. Stop once there are as many roots as the locator's degree.
+  int num_roots = 0;
+  *error        = 0;
+  for (int i = 0; i < BCH3121_CODEWORD_LEN && num_roots < num_errors; i++) {
+    if ((s1 ^ sigma1 ^ sigma2) == 0) {
+      *error |= 1 << i;
+      num_roots++;
+    }
+
+    sigma1 = gf32_div_alpha(sigma1);
+    sigma2 = gf32_div_alpha2(sigma2);
+  }
+
+  // The locator must have as many distinct roots as its degree, otherwise there are more errors than we can correct
+  if (num_roots != num_errors)
+    return -BCH3121_ERR_UNCORRECTABLE;
+
+  return num_errors;
+}
+#else
+// Find the error pattern for a non-zero syndrome, returning the number of errors or a negative error code
+static int bch3121_locate_errors(uint32_t *error, uint32_t syndrome)
+{
+  // Look up the error pattern
   uint16_t error_pattern = bch3121_error_positions[(uint16_t)syndrome];
 
   // Check for uncorrectable errors
@@ -131,19 +297,146 @@ int bch3121_decode_and_correct(uint32_t *message, uint32_t codeword)
   // Extract the number of errors
   uint8_t num_errors = error_pattern & 0x3;
 
-  // Correct the first error
-  codeword ^= (1 << ((error_pattern >> 2) & 0x1F));
+  // Set the first error
+  *error = (1 << ((error_pattern >> 2) & 0x1F));
 
-  // Correct the second error, if present
+  // Set the second error, if present
   if (num_errors == 2)
-    codeword ^= (1 << ((error_pattern >> 7) & 0x1F));
+    *error |= (1 << ((error_pattern >> 7) & 0x1F));
+
+  return num_errors;
+}
+#endif
+
+int bch3121_decode_and_correct(uint32_t *message, uint32_t codeword)
+{
+  // Decode the codeword, immediately return the message if it contains no errors
+  uint32_t syndrome = bch3121_decode(message, codeword);
+  if (!syndrome)
+    return 0;
+
+  // There is at least one error, look up the error pattern
+  uint32_t error;
+  int num_errors = bch3121_locate_errors(&error, syndrome);
+  if (num_errors < 0)
+    return num_errors;
 
   // Decode the codeword again, now that we've corrected the errors
-  bch3121_decode(message, codeword);
+  bch3121_decode(message, codeword ^ error);
 
   return num_errors;
 }
 
+// Run 3 division steps on 4 bit-sliced codewords, returning the quotient nibbles (first step in the top nibble)
+static inline uint32_t bch3121_divide_x4(uint64_t *window, uint64_t *next)
+{
+  // The polynomial has no x^1 or x^2 terms, so the next 3 quotient nibbles are just the next 3 window nibbles.
+  // Each nibble holds the same bit of all 4 codewords, so multiplying a nibble by the nibble-spread polynomial
+  // applies it to every codeword with that bit set.
+  uint32_t lanes = *window & 0xFFF;
+  *window ^= (lanes & 0x00F) * BCH3121_POLYNOMIAL_X4 ^ (lanes & 0x0F0) * BCH3121_POLYNOMIAL_X4 ^
+             (lanes & 0xF00) * BCH3121_POLYNOMIAL_X4;
+
+  // Shift out the processed nibbles, and shift in the next ones
+  *window = *window >> 12 | *next << 52;
+  *next >>= 12;
+
+  return (lanes & 0x00F) << 8 | (lanes & 0x0F0) | (lanes & 0xF00) >> 8;
+}
+
+uint8_t bch3121_decode_x4(uint32_t *messages, uint32_t *syndromes, const uint32_t *interleaved)
+{
+  // Sliding 16-nibble window over the interleaved codewords, and the nibbles still to be shifted in
+  uint64_t window = interleaved[0] | (uint64_t)interleaved[1] << 32;
+  uint64_t next   = interleaved[2] | (uint64_t)interleaved[3] << 32;
+
+  // Run the 21 division steps on all 4 lanes, collecting the bit-sliced quotient (decoded message)
+  uint64_t quotient_hi = 0;
+  uint64_t quotient_lo = 0;
+  for (int i = 0; i < 3; i++)
+    quotient_hi = quotient_hi << 12 | bch3121_divide_x4(&window, &next);
+  for (int i = 3; i < 7; i++)
+    quotient_lo = quotient_lo << 12 | bch3121_divide_x4(&window, &next);
+
+  // Untangle the per-lane messages and syndromes
+  quotient_hi = transpose_nibbles(quotient_hi);
+  quotient_lo = transpose_nibbles(quotient_lo);
+  window      = transpose_nibbles(window);
+
+  uint8_t error_lanes = 0;
+  for (int lane = 0; lane < 4; lane++) {
+    messages[lane]  = (quotient_hi >> (16 * lane) & 0x1FF) << 12 | (quotient_lo >> (16 * lane) & 0xFFF);
+    syndromes[lane] = (uint16_t)(window >> (16 * lane));
+
+    if (syndromes[lane])
+      error_lanes |= 1 << lane;
+  }
+
+  return error_lanes;
+}
+
+int bch3121_decode_and_correct_x4(uint32_t *messages, const uint32_t *interleaved)
+{
+  // Decode all lanes, immediately return the messages if they contain no errors
+  uint32_t syndromes[4];
+  uint8_t error_lanes = bch3121_decode_x4(messages, syndromes, interleaved);
+  if (!error_lanes)
+    return 0;
+
+  // Correct each lane with errors individually
+  int total_errors = 0;
+  for (int lane = 0; lane < 4; lane++) {
+    if (!(error_lanes & (1 << lane)))
+      continue;
+
+    // Look up the error pattern
+    uint32_t error;
+    int num_errors = bch3121_locate_errors(&error, syndromes[lane]);
+    if (num_errors < 0)
+      return num_errors;
+
+    // Decoding is linear, so the message correction is the decoded error pattern
+    uint32_t correction;
+    bch3121_decode(&correction, error);
+    messages[lane] ^= correction;
+
+    total_errors += num_errors;
+  }
+
+  return total_errors;
+}
+
+int bch3121_decode_and_correct_x4_detailed(uint32_t *messages, uint32_t *syndromes, int8_t *corrected,
+                                           const uint32_t *interleaved)
+{
+  uint8_t error_lanes = bch3121_decode_x4(messages, syndromes, interleaved);
+
+  int total_errors = 0;
+  int rc           = 0;
+  for (int lane = 0; lane < 4; lane++) {
+    corrected[lane] = 0;
+    if (!(error_lanes & (1 << lane)))
+      continue;
+
+    // Look up the error pattern, carrying on with the other lanes if it is uncorrectable
+    uint32_t error;
+    int num_errors  = bch3121_locate_errors(&error, syndromes[lane]);
+    corrected[lane] = num_errors;
+    if (num_errors < 0) {
+      rc = num_errors;
+      continue;
+    }
+
+    uint32_t correction;
+    bch3121_decode(&correction, error);
+    messages[lane] ^= correction;
+
+    total_errors += num_errors;
+  }
+
+  return rc < 0 ? rc : total_errors;
+}
+
 void bch3121_generate_syndrome_table(uint16_t *syndrome_table)
 {
   uint32_t syndrome, tmp;
@@ -0,0 +1,58 @@
+#include "wavebird/bitstream.h"
+
+#define SYNC_SEARCHING -1
+
+void wavebird_bitstream_init(wavebird_bitstream_t *bitstream, uint8_t max_sync_errors,
+                             wavebird_bitstream_packet_fn_t packet_fn, void *context)
+{
+  bitstream->packet_fn       = packet_fn;
+  bitstream->context         = context;
+  bitstream->window          = 0;
+  bitstream->sync_count      = 0;
+  bitstream->max_sync_errors = max_sync_errors;
+  bitstream->offset          = 0;
+  bitstream->packet_length   = SYNC_SEARCHING;
+}
+
+// Search the 8 alignments ending in the latest byte for the sync pattern, returns the first match or -1
+static inline int find_sync(uint64_t window, uint8_t max_errors)
+{
+  // Check the oldest alignment first, the pattern ends offset bits before the end of the window
+  for (int offset = 7; offset >= 0; offset--) {
+    uint32_t errors = (uint32_t)(window >> offset) ^ WAVEBIRD_BITSTREAM_SYNC_PATTERN;
+    if (__builtin_popcount(errors) <= max_errors)
+      return offset;
+  }
+
+  return -1;
+}
+
+void wavebird_bitstream_push(wavebird_bitstream_t *bitstream, const uint8_t *data, size_t length)
+{
+  uint64_t window = bitstream->window;
+
+  for (size_t i = 0; i < length; i++) {
+    window = window << 8 | data[i];
+
+    if (bitstream->packet_length == SYNC_SEARCHING) {
+      int offset = find_sync(window, bitstream->max_sync_errors);
+      if (offset < 0)
+        continue;
+
+      // The packet starts right after the pattern, the low offset bits of this byte are its first bits
+      bitstream->sync_count++;
+      bitstream->offset        = offset;
+      bitstream->packet_length = 0;
+      continue;
+    }
+
+    // Each pushed byte completes a packet byte, made up of the last offset bits of the previous byte and the rest
+    bitstream->packet[bitstream->packet_length++] = window >> bitstream->offset;
+    if (bitstream->packet_length == WAVEBIRD_PACKET_BYTES) {
+      bitstream->packet_length = SYNC_SEARCHING;
+      bitstream->packet_fn(bitstream->packet, bitstream->context);
+    }
+  }
+
+  bitstream->window = window;
+}
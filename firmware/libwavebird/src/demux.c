@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "wavebird/demux.h"
+
+// Packet quality lost for each corrected bit error
+#define QUALITY_PER_BIT_ERROR 32
+
+// Weight of each new packet in the link quality moving average, as a power of 2
+#define QUALITY_AVERAGE_SHIFT 3
+
+// Unlink a slot from the LRU list
+static void lru_remove(wavebird_demux_t *demux, uint8_t slot)
+{
+  wavebird_demux_controller_t *controller = &demux->controllers[slot];
+
+  if (controller->prev != WAVEBIRD_DEMUX_NONE)
+    demux->controllers[controller->prev].next = controller->next;
+  else
+    demux->most_recent = controller->next;
+
+  if (controller->next != WAVEBIRD_DEMUX_NONE)
+    demux->controllers[controller->next].prev = controller->prev;
+  else
+    demux->least_recent = controller->prev;
+}
+
+// Link a slot at the most recent end of the LRU list
+static void lru_push(wavebird_demux_t *demux, uint8_t slot)
+{
+  wavebird_demux_controller_t *controller = &demux->controllers[slot];
+
+  controller->prev = WAVEBIRD_DEMUX_NONE;
+  controller->next = demux->most_recent;
+  if (demux->most_recent != WAVEBIRD_DEMUX_NONE)
+    demux->controllers[demux->most_recent].prev = slot;
+  else
+    demux->least_recent = slot;
+
+  demux->most_recent = slot;
+}
+
+// Stop tracking the controller in a slot, moving the last slot into its place so the used slots stay contiguous
+static void remove_slot(wavebird_demux_t *demux, uint8_t slot)
+{
+  lru_remove(demux, slot);
+  demux->index[demux->controllers[slot].controller_id] = WAVEBIRD_DEMUX_NONE;
+
+  uint8_t last = --demux->count;
+  if (slot == last)
+    return;
+
+  // Relink the moved controller under its new slot
+  demux->controllers[slot]           = demux->controllers[last];
+  wavebird_demux_controller_t *moved = &demux->controllers[slot];
+  demux->index[moved->controller_id] = slot;
+
+  if (moved->prev != WAVEBIRD_DEMUX_NONE)
+    demux->controllers[moved->prev].next = slot;
+  else
+    demux->most_recent = slot;
+
+  if (moved->next != WAVEBIRD_DEMUX_NONE)
+    demux->controllers[moved->next].prev = slot;
+  else
+    demux->least_recent = slot;
+}
+
+void wavebird_demux_init(wavebird_demux_t *demux)
+{
+  memset(demux, 0, sizeof(*demux));
+  memset(demux->index, WAVEBIRD_DEMUX_NONE, sizeof(demux->index));
+  demux->most_recent  = WAVEBIRD_DEMUX_NONE;
+  demux->least_recent = WAVEBIRD_DEMUX_NONE;
+}
+
+wavebird_demux_controller_t *wavebird_demux_touch(wavebird_demux_t *demux, uint16_t controller_id, uint32_t now)
+{
+  controller_id &= WB_MESSAGE_HEADER_CONTROLLER_ID;
+
+  // Move a tracked controller to the front of the LRU list
+  uint8_t slot = demux->index[controller_id];
+  if (slot != WAVEBIRD_DEMUX_NONE) {
+    wavebird_demux_controller_t *controller = &demux->controllers[slot];
+    if (demux->most_recent != slot) {
+      lru_remove(demux, slot);
+      lru_push(demux, slot);
+    }
+
+    controller->packets++;
+    controller->last_seen = now;
+    return controller;
+  }
+
+  // Make room for a new controller by evicting the least recently seen one
+  if (demux->count == WAVEBIRD_DEMUX_CONTROLLERS) {
+    remove_slot(demux, demux->least_recent);
+    demux->evictions++;
+  }
+
+  slot                        = demux->count++;
+  demux->index[controller_id] = slot;
+
+  wavebird_demux_controller_t *controller = &demux->controllers[slot];
+  memset(controller, 0, sizeof(*controller));
+  controller->controller_id = controller_id;
+  controller->packets       = 1;
+  controller->first_seen    = now;
+  controller->last_seen     = now;
+  controller->link_quality  = UINT8_MAX;
+  lru_push(demux, slot);
+
+  return controller;
+}
+
+wavebird_demux_controller_t *wavebird_demux_update(wavebird_demux_t *demux, const wavebird_gc_state_t *state,
+                                                   const wavebird_decode_result_t *result, uint32_t now)
+{
+  wavebird_demux_controller_t *controller =
+      wavebird_demux_touch(demux, wavebird_gc_state_get_controller_id(state), now);
+
+  if (wavebird_gc_state_get_type(state) == WB_MESSAGE_TYPE_INPUT_STATE) {
+    controller->input     = *state;
+    controller->has_input = true;
+  } else {
+    controller->origin     = *state;
+    controller->has_origin = true;
+  }
+
+  // Score the packet by the bit errors it needed corrected, and fold it into the moving average
+  if (result) {
+    int quality = UINT8_MAX - result->corrected_bits * QUALITY_PER_BIT_ERROR;
+    if (quality < 0)
+      quality = 0;
+
+    controller->link_quality += (quality - controller->link_quality) >> QUALITY_AVERAGE_SHIFT;
+  }
+
+  return controller;
+}
+
+wavebird_demux_controller_t *wavebird_demux_find(wavebird_demux_t *demux, uint16_t controller_id)
+{
+  uint8_t slot = demux->index[controller_id & WB_MESSAGE_HEADER_CONTROLLER_ID];
+  return slot != WAVEBIRD_DEMUX_NONE ? &demux->controllers[slot] : NULL;
+}
+
+int wavebird_demux_expire(wavebird_demux_t *demux, uint32_t now, uint32_t timeout)
+{
+  // Stale controllers are all at the least recent end of the LRU list
+  int expired = 0;
+  while (demux->least_recent != WAVEBIRD_DEMUX_NONE &&
+         now - demux->controllers[demux->least_recent].last_seen > timeout) {
+    remove_slot(demux, demux->least_recent);
+    expired++;
+  }
+
+  return expired;
+}
+
+wavebird_demux_controller_t *wavebird_demux_select(wavebird_demux_t *demux, int policy)
+{
+  if (demux->count == 0)
+    return NULL;
+
+  if (policy == WB_DEMUX_SELECT_MOST_RECENT)
+    return &demux->controllers[demux->most_recent];
+
+  wavebird_demux_controller_t *best = &demux->controllers[0];
+  for (int i = 1; i < demux->count; i++) {
+    wavebird_demux_controller_t *controller = &demux->controllers[i];
+    if (policy == WB_DEMUX_SELECT_FIRST_SEEN ? (int32_t)(controller->first_seen - best->first_seen) < 0
+                                             : controller->link_quality > best->link_quality)
+      best = controller;
+  }
+
+  return best;
+}
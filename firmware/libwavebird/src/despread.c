@@ -0,0 +1,226 @@
+#include <string.h>
+
+#include "wavebird/despread.h"
+
+// Correlator block size, bit periods are correlated in whole blocks of samples so the compiler can vectorize them
+#define BLOCK 16
+
+_Static_assert(WAVEBIRD_DESPREADER_TAPS % BLOCK == 0, "taps must be whole correlator blocks");
+
+// Samples kept in the history, leaving room after the newest sample for the padding in the last block
+#define HISTORY_FILL (WAVEBIRD_DESPREADER_HISTORY - BLOCK)
+
+// Amplitude of each hard chip
+#define HARD_CHIP_AMPLITUDE 64
+
+// Hard chips expanded to samples per batch
+#define HARD_CHIP_BATCH 256
+
+// How much stronger than the current lock's average a correlation must be to become a candidate lock
+#define RELOCK_MARGIN 64
+
+// Bits the lock's strength is averaged over
+#define STRENGTH_AVERAGE_BITS 4
+
+// Consecutive bits the early or late sample must correlate best for before moving to it
+#define TIMING_CONFIRM_BITS 2
+
+void wavebird_despreader_init(wavebird_despreader_t *despreader, uint8_t samples_per_chip)
+{
+  if (samples_per_chip < 1)
+    samples_per_chip = 1;
+  if (samples_per_chip > WAVEBIRD_DESPREADER_MAX_OVERSAMPLE)
+    samples_per_chip = WAVEBIRD_DESPREADER_MAX_OVERSAMPLE;
+
+  despreader->samples_per_chip = samples_per_chip;
+  despreader->span             = WAVEBIRD_DSSS_CHIPS * samples_per_chip;
+  despreader->length           = (despreader->span + BLOCK - 1) / BLOCK * BLOCK;
+  despreader->fill             = 0;
+  despreader->magnitude        = 0;
+  despreader->lock_threshold   = 160;
+  despreader->unlock_threshold = 96;
+  despreader->locked           = false;
+  despreader->countdown        = 0;
+  despreader->candidate        = 0;
+  despreader->strength         = 0;
+  despreader->weak_bits        = 0;
+  despreader->timing_error     = 0;
+  despreader->locks            = 0;
+  despreader->adjustments      = 0;
+
+  // Spread the code over the samples of each chip, MSB first, and pad it to whole blocks
+  memset(despreader->taps, 0, sizeof(despreader->taps));
+  memset(despreader->history, 0, sizeof(despreader->history));
+  for (int i = 0; i < despreader->span; i++) {
+    int chip            = (WAVEBIRD_DSSS_CODE >> (WAVEBIRD_DSSS_CHIPS - 1 - i / samples_per_chip)) & 1;
+    despreader->taps[i] = chip ? 1 : -1;
+  }
+}
+
+/**
+ * Correlate the code with one bit period of samples.
+ *
+ * Written as a fixed-size multiply-accumulate loop over int8 samples with an
+ * int16 sum, so the compiler can vectorize each block into a few SSE or NEON
+ * instructions. The padding taps are 0, so the samples after the bit period
+ * don't contribute.
+ */
+static inline int32_t correlate(const int8_t *taps, const int8_t *samples, int length)
+{
+  int16_t correlation = 0;
+  for (int block = 0; block < length; block += BLOCK) {
+    for (int i = block; i < block + BLOCK; i++)
+      correlation += taps[i] * samples[i];
+  }
+
+  return correlation;
+}
+
+static inline int sample_magnitude(int8_t sample)
+{
+  return sample < 0 ? -sample : sample;
+}
+
+// Confidence in a correlation, its share of the total sample magnitude scaled to 0-255
+static inline uint8_t correlation_confidence(int32_t correlation, int32_t magnitude)
+{
+  int32_t strength = correlation < 0 ? -correlation : correlation;
+  return magnitude ? strength * 255 / magnitude : 0;
+}
+
+size_t wavebird_despreader_push(wavebird_despreader_t *despreader, uint8_t *bits, uint8_t *confidence,
+                                const int8_t *samples, size_t count)
+{
+  const int8_t *taps = despreader->taps;
+  const int span     = despreader->span;
+  const int length   = despreader->length;
+  int8_t *history    = despreader->history;
+  int fill           = despreader->fill;
+  int magnitude      = despreader->magnitude;
+  size_t produced    = 0;
+
+  for (size_t i = 0; i < count;) {
+    // Keep the last bit period and the early sample when the history fills up
+    if (fill == HISTORY_FILL) {
+      memmove(history, history + HISTORY_FILL - (span + 1), span + 1);
+      fill = span + 1;
+    }
+
+    // Copy in as many samples as fit before correlating any of them, correlating straight after storing each
+    // sample stalls the vector loads on store forwarding
+    size_t batch = count - i < (size_t)(HISTORY_FILL - fill) ? count - i : (size_t)(HISTORY_FILL - fill);
+    memcpy(history + fill, samples + i, batch);
+    i += batch;
+
+    for (int end = fill + batch; fill < end;) {
+      // Keep a running total of the sample magnitudes in the latest bit period
+      magnitude += sample_magnitude(history[fill++]);
+      if (fill > span)
+        magnitude -= sample_magnitude(history[fill - 1 - span]);
+
+      if (fill < span)
+        continue;
+
+      // Slide the correlator along a sample at a time until the code lines up, the latest bit period ends at the
+      // newest sample. Confidence is only worked out for correlations strong enough to lock on.
+      const int8_t *latest = history + fill - span;
+      int32_t late          = correlate(taps, latest, length);
+      int32_t strength      = late < 0 ? -late : late;
+      uint8_t late_strength = 0;
+      if (magnitude && strength * 255 >= despreader->lock_threshold * magnitude)
+        late_strength = correlation_confidence(late, magnitude);
+
+      bool relock = false;
+      if (despreader->candidate > 0 && --despreader->candidate == 0) {
+        // Move to a candidate lock if it correlates strongly again one bit period later
+        relock = late_strength >= despreader->lock_threshold;
+      } else if (late_strength >= despreader->lock_threshold && despreader->locked) {
+        // Keep searching once locked, so a false lock on noise doesn't hold on through the start of a transmission.
+        // Much stronger correlations become candidates, except the early, prompt and late bit periods of the current
+        // lock, which end on the last 3 samples of the countdown and are left to timing tracking.
+        if (despreader->countdown > 3 && late_strength >= despreader->strength + RELOCK_MARGIN)
+          despreader->candidate = span;
+      } else if (late_strength >= despreader->lock_threshold) {
+        relock = true;
+      }
+
+      if (relock) {
+        // Correlate this bit period as the prompt one once the late sample arrives
+        despreader->locked       = true;
+        despreader->countdown    = 1;
+        despreader->candidate    = 0;
+        despreader->strength     = late_strength;
+        despreader->weak_bits    = 0;
+        despreader->timing_error = 0;
+        despreader->locks++;
+        continue;
+      }
+
+      if (!despreader->locked || --despreader->countdown > 0)
+        continue;
+
+      // Correlate one sample early and on time, to go with the late one, sliding the magnitude back a sample at a time
+      int prompt_magnitude    = magnitude - sample_magnitude(latest[span - 1]) + sample_magnitude(latest[-1]);
+      int32_t prompt          = correlate(taps, latest - 1, length);
+      uint8_t prompt_strength = correlation_confidence(prompt, prompt_magnitude);
+      late_strength           = correlation_confidence(late, magnitude);
+
+      uint8_t early_strength = 0;
+      if (fill >= span + 2) {
+        int early_magnitude = prompt_magnitude - sample_magnitude(latest[span - 2]) + sample_magnitude(latest[-2]);
+        early_strength      = correlation_confidence(correlate(taps, latest - 2, length), early_magnitude);
+      }
+
+      // Only move once the same side has correlated best for a few bits in a row, so noise doesn't cause chip slips
+      if (early_strength > prompt_strength && early_strength > late_strength)
+        despreader->timing_error = despreader->timing_error < 0 ? despreader->timing_error - 1 : -1;
+      else if (late_strength > prompt_strength)
+        despreader->timing_error = despreader->timing_error > 0 ? despreader->timing_error + 1 : 1;
+      else
+        despreader->timing_error = 0;
+
+      despreader->countdown = span;
+      if (despreader->timing_error <= -TIMING_CONFIRM_BITS || despreader->timing_error >= TIMING_CONFIRM_BITS) {
+        despreader->countdown    = span + (despreader->timing_error < 0 ? -1 : 1);
+        despreader->timing_error = 0;
+        despreader->adjustments++;
+      }
+
+      bits[produced] = prompt > 0;
+      if (confidence)
+        confidence[produced] = prompt_strength;
+      produced++;
+
+      // Average the lock's strength over the last few bits, and drop lock after a run of weak bits
+      despreader->strength += (prompt_strength - despreader->strength) / STRENGTH_AVERAGE_BITS;
+      if (prompt_strength >= despreader->unlock_threshold)
+        despreader->weak_bits = 0;
+      else if (++despreader->weak_bits == WAVEBIRD_DESPREADER_LOCK_LOSS_BITS)
+        despreader->locked = false;
+    }
+  }
+
+  despreader->fill      = fill;
+  despreader->magnitude = magnitude;
+  return produced;
+}
+
+size_t wavebird_despreader_push_hard(wavebird_despreader_t *despreader, uint8_t *bits, uint8_t *confidence,
+                                     const uint8_t *chips, size_t count)
+{
+  int8_t samples[HARD_CHIP_BATCH];
+  size_t produced = 0;
+
+  for (size_t start = 0; start < count; start += HARD_CHIP_BATCH) {
+    size_t batch = count - start < HARD_CHIP_BATCH ? count - start : HARD_CHIP_BATCH;
+    for (size_t i = 0; i < batch; i++) {
+      size_t chip = start + i;
+      samples[i]  = (chips[chip / 8] >> (7 - chip % 8)) & 1 ? HARD_CHIP_AMPLITUDE : -HARD_CHIP_AMPLITUDE;
+    }
+
+    produced += wavebird_despreader_push(despreader, bits + produced, confidence ? confidence + produced : NULL,
+                                         samples, batch);
+  }
+
+  return produced;
+}
@@ -1,167 +1,814 @@
 #include <stddef.h>
+#include <string.h>
 
 #include "wavebird/bch3121.h"
 #include "wavebird/packet.h"
 
+#include "transpose.h"
+
 #define PACKET_DATA_BITS  124
 #define PACKET_DATA_START 28
 #define CODEWORD_COUNT    4
 #define CRC_FINAL_XOR     0xCE98
+#define MESSAGE_MASK      ((1 << BCH3121_MESSAGE_LEN) - 1)
+
+// The built-in packet CRC, NULL when it is calculated from the message table instead of wavebird_packet_crc_ccitt()
+#if WAVEBIRD_PACKET_CRC_TABLE
+#define BUILTIN_CRC_FN NULL
+#else
+#define BUILTIN_CRC_FN wavebird_packet_crc_ccitt
+#endif
+
+// Soft-decision decoding parameters
+#define SOFT_CHASE_BITS     4   // Least reliable bits to flip in each codeword
+#define SOFT_MAX_CANDIDATES 4   // Most likely messages to keep for each codeword
+#define SOFT_MAX_METRIC     768 // Reject packets needing more than ~3 confident bits flipped, to limit false accepts
+
+// Candidate message for a codeword during soft-decision decoding
+struct soft_candidate {
+  uint32_t message;
+  uint32_t metric;
+};
+
+// Decoder context used by the wavebird_packet_* functions
+static wavebird_decoder_t default_decoder = {
+    .crc_fn          = BUILTIN_CRC_FN,
+    .recovery_budget = 0,
+};
+
+// Load a big-endian 32-bit word from a byte array
+static inline uint32_t load_be32(const uint8_t *data)
+{
+  return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
 
-// Internal state to avoid repeated allocations
-static uint8_t crc_state[WAVEBIRD_MESSAGE_BYTES];
-static uint32_t codewords[CODEWORD_COUNT];
+// Store a 32-bit word into a byte array, big-endian
+static inline void store_be32(uint8_t *data, uint32_t value)
+{
+  data[0] = value >> 24;
+  data[1] = value >> 16;
+  data[2] = value >> 8;
+  data[3] = value;
+}
 
-// CRC function pointer to allow for hardware CRC calculation
-static uint16_t crc_ccitt(const uint8_t *data, size_t length);
-static wavebird_packet_crc_fn_t crc_fn = crc_ccitt;
+// Store an 88-bit value into an 11-byte big-endian array, as its high 24 bits and low 64 bits
+static inline void store_be88(uint8_t *data, uint32_t high, uint64_t low)
+{
+  data[0] = high >> 16;
+  data[1] = high >> 8;
+  data[2] = high;
+  store_be32(&data[3], low >> 32);
+  store_be32(&data[7], low);
+}
 
-// A "good enough" CRC-CCITT implementation for systems without hardware CRC
-static uint16_t crc_ccitt(const uint8_t *data, size_t length)
+// Load the 124-bit interleaved payload of a packet as 4 words, least significant word first
+static inline void load_interleaved(uint32_t *interleaved, const uint8_t *packet)
 {
-  uint16_t crc = 0x0000;
+  uint32_t w0 = load_be32(&packet[0]);
+  uint32_t w1 = load_be32(&packet[4]);
+  uint32_t w2 = load_be32(&packet[8]);
+  uint32_t w3 = load_be32(&packet[12]);
+
+  // Drop the CRC nibble at the end of the payload
+  interleaved[0] = w3 >> 4 | w2 << 28;
+  interleaved[1] = w2 >> 4 | w1 << 28;
+  interleaved[2] = w1 >> 4 | w0 << 28;
+  interleaved[3] = w0 >> 4;
+}
 
-  while (length--) {
-    crc ^= (uint16_t)(*data++) << 8;
+// Store the 124-bit interleaved payload into a packet, the inverse of load_interleaved()
+static inline void store_interleaved(uint8_t *packet, const uint32_t *interleaved)
+{
+  // Keep the CRC nibble at the end of the payload
+  store_be32(&packet[0], interleaved[3] << 4 | interleaved[2] >> 28);
+  store_be32(&packet[4], interleaved[2] << 4 | interleaved[1] >> 28);
+  store_be32(&packet[8], interleaved[1] << 4 | interleaved[0] >> 28);
+  store_be32(&packet[12], interleaved[0] << 4 | (packet[15] & 0x0F));
+}
 
-    // Process each bit in the byte
-    for (int i = 0; i < 8; i++) {
-      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
-    }
+// Pack 4 messages into the (transposed) CRC state, so bit N of message K ends up in bit N * 4 + K
+static void pack_crc_state(uint8_t *crc_state, const uint32_t *messages)
+{
+  store_be88(crc_state, transpose_lanes(pack_lanes(messages, 16)), transpose_lanes(pack_lanes(messages, 0)));
+}
+
+// Pack 4 decoded codewords into a message
+static void pack_message(uint8_t *message, const uint32_t *decoded)
+{
+  // The 21-bit messages are stored back to back, starting from the least significant end
+  uint64_t low  = decoded[0] | (uint64_t)decoded[1] << 21 | (uint64_t)decoded[2] << 42 | (uint64_t)decoded[3] << 63;
+  uint32_t high = decoded[3] >> 1;
+  store_be88(message, high, low);
+}
+
+// Unpack 4 decoded codewords straight into a controller state, without packing the message first
+static void unpack_gc_state(wavebird_gc_state_t *state, const uint32_t *decoded)
+{
+  // Bits 67-4 of the message, which hold the body of both input state and origin messages
+  uint64_t body =
+      decoded[0] >> 4 | (uint64_t)decoded[1] << 17 | (uint64_t)decoded[2] << 38 | (uint64_t)decoded[3] << 59;
+
+  uint16_t buttons;
+  uint64_t analog;
+  state->header = decoded[3] >> 5;
+  if (state->header & WB_MESSAGE_HEADER_ORIGIN) {
+    buttons = 0;
+    analog  = body >> 16;
+  } else {
+    buttons = body >> 52;
+    analog  = body >> 4;
   }
 
+  // Remap the buttons to the SI input state button bits
+  state->buttons[0] = (buttons >> 7) & 0x1F;
+  state->buttons[1] = buttons & 0x7F;
+
+  for (int i = 0; i < 6; i++)
+    state->analog[i] = analog >> (40 - 8 * i);
+}
+
+// Calculate the packet CRC from the decoder's current CRC state
+static inline uint16_t crc_state_crc(const wavebird_decoder_t *decoder)
+{
+  return decoder->crc_fn(decoder->crc_state, WAVEBIRD_MESSAGE_BYTES) ^ CRC_FINAL_XOR;
+}
+
+#if WAVEBIRD_PACKET_CRC_TABLE
+// CRC-CCITT of the CRC state for each value of each 4-bit message nibble. The CRC has a zero initial value so it is
+// linear, and the CRC of a whole message is the XOR of the entries for each of its nibbles. This skips transposing the
+// messages into the CRC state entirely.
+static const uint16_t message_crc_table[21][16] = {
+    {
+        0x0000, 0x1021, 0x1231, 0x0210, 0x3331, 0x2310, 0x2100, 0x3121,
+        0x0373, 0x1352, 0x1142, 0x0163, 0x3042, 0x2063, 0x2273, 0x3252,
+    },
+    {
+        0x0000, 0x3730, 0x4363, 0x7453, 0x76B4, 0x4184, 0x35D7, 0x02E7,
+        0x1BA7, 0x2C97, 0x58C4, 0x6FF4, 0x6D13, 0x5A23, 0x2E70, 0x1940,
+    },
+    {
+        0x0000, 0xAA51, 0x045A, 0xAE0B, 0x45A0, 0xEFF1, 0x41FA, 0xEBAB,
+        0x1A84, 0xB0D5, 0x1EDE, 0xB48F, 0x5F24, 0xF575, 0x5B7E, 0xF12F,
+    },
+    {
+        0x0000, 0xB861, 0x377B, 0x8F1A, 0x47D3, 0xFFB2, 0x70A8, 0xC8C9,
+        0x3DB4, 0x85D5, 0x0ACF, 0xB2AE, 0x7A67, 0xC206, 0x4D1C, 0xF57D,
+    },
+    {
+        0x0000, 0xEB23, 0x53FE, 0xB8DD, 0x6F45, 0x8466, 0x3CBB, 0xD798,
+        0x9496, 0x7FB5, 0xC768, 0x2C4B, 0xFBD3, 0x10F0, 0xA82D, 0x430E,
+    },
+    {
+        0x0000, 0xD849, 0x2042, 0xF80B, 0x2462, 0xFC2B, 0x0420, 0xDC69,
+        0x6662, 0xBE2B, 0x4620, 0x9E69, 0x4200, 0x9A49, 0x6242, 0xBA0B,
+    },
+    {
+        0x0000, 0x06E6, 0x6E60, 0x6886, 0x86C6, 0x8020, 0xE8A6, 0xEE40,
+        0xED68, 0xEB8E, 0x8308, 0x85EE, 0x6BAE, 0x6D48, 0x05CE, 0x0328,
+    },
+    {
+        0x0000, 0x374E, 0x4483, 0x73CD, 0x08B4, 0x3FFA, 0x4C37, 0x7B79,
+        0x8B40, 0xBC0E, 0xCFC3, 0xF88D, 0x83F4, 0xB4BA, 0xC777, 0xF039,
+    },
+    {
+        0x0000, 0x3508, 0x60E3, 0x55EB, 0x6EF6, 0x5BFE, 0x0E15, 0x3B1D,
+        0x8FA6, 0xBAAE, 0xEF45, 0xDA4D, 0xE150, 0xD458, 0x81B3, 0xB4BB,
+    },
+    {
+        0x0000, 0x7B68, 0xC667, 0xBD0F, 0xA7FC, 0xDC94, 0x619B, 0x1AF3,
+        0xDE8A, 0xA5E2, 0x18ED, 0x6385, 0x7976, 0x021E, 0xBF11, 0xC479,
+    },
+    {
+        0x0000, 0x390D, 0xA0B3, 0x99BE, 0x4084, 0x7989, 0xE037, 0xD93A,
+        0x48C4, 0x71C9, 0xE877, 0xD17A, 0x0840, 0x314D, 0xA8F3, 0x91FE,
+    },
+    {
+        0x0000, 0xCCC4, 0x0DCC, 0xC108, 0xDCC0, 0x1004, 0xD10C, 0x1DC8,
+        0x1DAD, 0xD169, 0x1061, 0xDCA5, 0xC16D, 0x0DA9, 0xCCA1, 0x0065,
+    },
+    {
+        0x0000, 0xCAF1, 0x6E9C, 0xA46D, 0x8906, 0x43F7, 0xE79A, 0x2D6B,
+        0x1168, 0xDB99, 0x7FF4, 0xB505, 0x986E, 0x529F, 0xF6F2, 0x3C03,
+    },
+    {
+        0x0000, 0x06A1, 0x6A10, 0x6CB1, 0xC1C6, 0xC767, 0xABD6, 0xAD77,
+        0xDDEC, 0xDB4D, 0xB7FC, 0xB15D, 0x1C2A, 0x1A8B, 0x763A, 0x709B,
+    },
+    {
+        0x0000, 0x0F6D, 0xF6D0, 0xF9BD, 0x9CEF, 0x9382, 0x6A3F, 0x6552,
+        0x5FD9, 0x50B4, 0xA909, 0xA664, 0xC336, 0xCC5B, 0x35E6, 0x3A8B,
+    },
+    {
+        0x0000, 0xAD35, 0x721A, 0xDF2F, 0x5147, 0xFC72, 0x235D, 0x8E68,
+        0x8108, 0x2C3D, 0xF312, 0x5E27, 0xD04F, 0x7D7A, 0xA255, 0x0F60,
+    },
+    {
+        0x0000, 0x9188, 0x89A9, 0x1821, 0x1B98, 0x8A10, 0x9231, 0x03B9,
+        0xA9A1, 0x3829, 0x2008, 0xB180, 0xB239, 0x23B1, 0x3B90, 0xAA18,
+    },
+    {
+        0x0000, 0x3B5A, 0x85C3, 0xBE99, 0xDD38, 0xE662, 0x58FB, 0x63A1,
+        0x022D, 0x3977, 0x87EE, 0xBCB4, 0xDF15, 0xE44F, 0x5AD6, 0x618C,
+    },
+    {
+        0x0000, 0x22D0, 0x0D42, 0x2F92, 0xD420, 0xF6F0, 0xD962, 0xFBB2,
+        0x93AD, 0xB17D, 0x9EEF, 0xBC3F, 0x478D, 0x655D, 0x4ACF, 0x681F,
+    },
+    {
+        0x0000, 0xABF9, 0x1EDA, 0xB523, 0xFD81, 0x5678, 0xE35B, 0x48A2,
+        0x29FF, 0x8206, 0x3725, 0x9CDC, 0xD47E, 0x7F87, 0xCAA4, 0x615D,
+    },
+    {
+        0x0000, 0xBFB2, 0x4A4B, 0xF5F9, 0xE434, 0x5B86, 0xAE7F, 0x11CD,
+        0xA28E, 0x1D3C, 0xE8C5, 0x5777, 0x46BA, 0xF908, 0x0CF1, 0xB343,
+    },
+};
+
+// Calculate the packet CRC of an 84-bit message, held as its high 20 bits and low 64 bits
+static inline uint16_t message_crc(uint64_t low, uint32_t high)
+{
+  uint16_t crc = CRC_FINAL_XOR;
+  for (int i = 0; i < 16; i++)
+    crc ^= message_crc_table[i][(low >> (4 * i)) & 0xF];
+  for (int i = 0; i < 5; i++)
+    crc ^= message_crc_table[16 + i][(high >> (4 * i)) & 0xF];
+
   return crc;
 }
+#endif
 
-// Set the Nth bit in a big-endian byte array
-static inline void set_bit(uint8_t *data, uint8_t length, uint8_t bit, uint8_t value)
+// Calculate the packet CRC of 4 messages
+static uint16_t packet_crc(wavebird_decoder_t *decoder, const uint32_t *messages)
 {
-  uint8_t byte_index = length - 1 - bit / 8;
-  uint8_t bit_mask   = 1 << (bit % 8);
+#if WAVEBIRD_PACKET_CRC_TABLE
+  // The built-in CRC can skip the CRC state
+  if (decoder->crc_fn == NULL) {
+    uint64_t low =
+        messages[0] | (uint64_t)messages[1] << 21 | (uint64_t)messages[2] << 42 | (uint64_t)messages[3] << 63;
+    return message_crc(low, messages[3] >> 1);
+  }
+#endif
 
-  if (value) {
-    data[byte_index] |= bit_mask;
-  } else {
-    data[byte_index] &= ~bit_mask;
+  pack_crc_state(decoder->crc_state, messages);
+  return crc_state_crc(decoder);
+}
+
+// Insert a candidate into a list sorted by metric, ignoring duplicates and candidates which don't fit
+static void insert_soft_candidate(struct soft_candidate *candidates, int *count, uint32_t message, uint32_t metric)
+{
+  // Ignore duplicate messages, they always have the same metric
+  for (int i = 0; i < *count; i++) {
+    if (candidates[i].message == message)
+      return;
+  }
+
+  // Find the insertion point, shifting worse candidates down
+  int i = *count < SOFT_MAX_CANDIDATES ? (*count)++ : SOFT_MAX_CANDIDATES;
+  while (i > 0 && candidates[i - 1].metric > metric) {
+    if (i < SOFT_MAX_CANDIDATES)
+      candidates[i] = candidates[i - 1];
+    i--;
+  }
+
+  if (i < SOFT_MAX_CANDIDATES) {
+    candidates[i].message = message;
+    candidates[i].metric  = metric;
   }
 }
 
-// Get the Nth bit from a big-endian byte array
-static inline uint8_t get_bit(const uint8_t *data, uint8_t length, uint8_t bit)
+// Find the positions of the least reliable bits, least reliable first
+static void find_weakest_bits(uint8_t *weakest, const uint8_t *reliability, uint8_t length)
 {
-  uint8_t byte_index = length - 1 - bit / 8;
-  uint8_t bit_mask   = 1 << (bit % 8);
+  int count = 0;
+  for (uint8_t bit = 0; bit < length; bit++) {
+    int i = count < SOFT_CHASE_BITS ? count++ : SOFT_CHASE_BITS;
+    while (i > 0 && reliability[weakest[i - 1]] > reliability[bit]) {
+      if (i < SOFT_CHASE_BITS)
+        weakest[i] = weakest[i - 1];
+      i--;
+    }
 
-  return (data[byte_index] & bit_mask) ? 1 : 0;
+    if (i < SOFT_CHASE_BITS)
+      weakest[i] = bit;
+  }
 }
 
-void wavebird_packet_set_crc_fn(wavebird_packet_crc_fn_t _crc_fn)
+// Find the most likely messages for a codeword (Chase-II), returns the number of candidates found
+static int find_soft_candidates(struct soft_candidate *candidates, uint32_t codeword, const uint8_t *reliability)
 {
-  crc_fn = _crc_fn;
+  // Find the least reliable bits in the codeword
+  uint8_t weakest[SOFT_CHASE_BITS];
+  find_weakest_bits(weakest, reliability, BCH3121_CODEWORD_LEN);
+
+  // Try every combination of flips of the least reliable bits
+  int count = 0;
+  for (uint32_t pattern = 0; pattern < (1 << SOFT_CHASE_BITS); pattern++) {
+    uint32_t test_codeword = codeword;
+    for (int i = 0; i < SOFT_CHASE_BITS; i++) {
+      if (pattern & (1 << i))
+        test_codeword ^= 1 << weakest[i];
+    }
+
+    // Attempt a regular hard-decision decode of the test codeword
+    uint32_t candidate;
+    if (bch3121_decode_and_correct(&candidate, test_codeword) < 0)
+      continue;
+
+    // Score the candidate by the reliability of the received bits it disagrees with
+    uint32_t errors = bch3121_encode(candidate) ^ codeword;
+    uint32_t metric = 0;
+    while (errors) {
+      metric += reliability[__builtin_ctz(errors)];
+      errors &= errors - 1;
+    }
+
+    insert_soft_candidate(candidates, &count, candidate, metric);
+  }
+
+  return count;
 }
 
-void wavebird_packet_deinterleave(uint32_t *codewords, const uint8_t *packet)
+// Decode each codeword of a packet separately, returns the one which failed, or -1 if more than one failed
+static int find_failed_codeword(uint32_t *received, uint32_t *decoded, const uint8_t *packet)
 {
-  // Step through each bit of the interleaved packet data
-  for (uint8_t i = 0; i < PACKET_DATA_BITS; i++) {
-    // Extract the bit from the packet
-    bool bit = get_bit(packet, WAVEBIRD_PACKET_BYTES, i + PACKET_DATA_START);
+  wavebird_packet_deinterleave(received, packet);
+
+  int failed = -1;
+  for (int i = 0; i < CODEWORD_COUNT; i++) {
+    if (bch3121_decode_and_correct(&decoded[i], received[i]) >= 0)
+      continue;
+
+    // Give up if more than one codeword failed, there are too many combinations to check
+    if (failed >= 0)
+      return -1;
+
+    failed = i;
+  }
 
-    // Set the bit in the appropriate codeword
-    if (bit) {
-      codewords[i % CODEWORD_COUNT] |= 1 << (i / CODEWORD_COUNT);
+  return failed;
+}
+
+// Recover a packet with a single uncorrectable codeword, by trying 3-error patterns until the CRC matches
+static int recover_packet(wavebird_decoder_t *decoder, uint32_t *decoded, const uint32_t *received, int failed,
+                          uint16_t expected_crc)
+{
+  // Flipping one bit of a 3-error pattern leaves a 2-error pattern, which regular error correction can fix.
+  // Without reliability information every 3-error pattern is equally likely, so try them in bit order.
+  uint16_t candidates = 0;
+  for (int bit = 0; bit < BCH3121_CODEWORD_LEN && candidates < decoder->recovery_budget; bit++) {
+    uint32_t flipped = received[failed] ^ (1 << bit);
+    if (bch3121_decode_and_correct(&decoded[failed], flipped) != 2)
+      continue;
+
+    // Each pattern is found once for each of its 3 bits, only check it for the lowest one
+    uint32_t errors = bch3121_encode(decoded[failed]) ^ received[failed];
+    if (__builtin_ctz(errors) != bit)
+      continue;
+
+    // Accept the first candidate which matches the CRC
+    candidates++;
+    if (packet_crc(decoder, decoded) == expected_crc)
+      return WB_PACKET_RESCUED;
+  }
+
+  return -WB_PACKET_ERR_DECODE_FAILED;
+}
+
+// Get the 16-bit message header from the last decoded codeword
+static inline uint16_t codeword_header(const uint32_t *decoded)
+{
+  return decoded[CODEWORD_COUNT - 1] >> 5;
+}
+
+// Repair a packet with a single uncorrectable codeword, by substituting the codeword from recent packets
+static int repair_packet(wavebird_decoder_t *decoder, uint32_t *decoded, int failed, uint16_t expected_crc)
+{
+  for (int i = 0; i < decoder->history_count; i++) {
+    const uint32_t *previous = decoder->history[i];
+
+    // Only use packets from the same controller, unless the header itself was lost
+    if (failed != CODEWORD_COUNT - 1 && codeword_header(previous) != codeword_header(decoded))
+      continue;
+
+    // Accept the first substitution which matches the CRC
+    decoded[failed] = previous[failed];
+    if (packet_crc(decoder, decoded) == expected_crc)
+      return WB_PACKET_REPAIRED;
+  }
+
+  return -WB_PACKET_ERR_DECODE_FAILED;
+}
+
+// Remember a successfully decoded packet, replacing the last one with the same controller ID and message type
+static void remember_packet(wavebird_decoder_t *decoder, const uint32_t *decoded)
+{
+  int entry = -1;
+  for (int i = 0; i < decoder->history_count; i++) {
+    if (codeword_header(decoder->history[i]) == codeword_header(decoded)) {
+      entry = i;
+      break;
+    }
+  }
+
+  // Otherwise fill the history, then replace the oldest entry
+  if (entry < 0) {
+    if (decoder->history_count < WAVEBIRD_DECODER_HISTORY) {
+      entry = decoder->history_count++;
     } else {
-      codewords[i % CODEWORD_COUNT] &= ~(1 << (i / CODEWORD_COUNT));
+      entry                 = decoder->history_next;
+      decoder->history_next = (decoder->history_next + 1) % WAVEBIRD_DECODER_HISTORY;
     }
   }
+
+  memcpy(decoder->history[entry], decoded, sizeof(decoder->history[entry]));
+}
+
+void wavebird_decoder_init(wavebird_decoder_t *decoder)
+{
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->crc_fn = BUILTIN_CRC_FN;
+}
+
+void wavebird_decoder_set_crc_fn(wavebird_decoder_t *decoder, wavebird_packet_crc_fn_t crc_fn)
+{
+  decoder->crc_fn = crc_fn ? crc_fn : BUILTIN_CRC_FN;
+}
+
+void wavebird_decoder_set_recovery_budget(wavebird_decoder_t *decoder, uint16_t max_candidates)
+{
+  decoder->recovery_budget = max_candidates;
+}
+
+void wavebird_decoder_set_history_repair(wavebird_decoder_t *decoder, bool enabled)
+{
+  decoder->history_repair = enabled;
+  decoder->history_count  = 0;
+  decoder->history_next   = 0;
+}
+
+void wavebird_packet_set_crc_fn(wavebird_packet_crc_fn_t crc_fn)
+{
+  wavebird_decoder_set_crc_fn(&default_decoder, crc_fn);
+}
+
+void wavebird_packet_set_recovery_budget(uint16_t max_candidates)
+{
+  wavebird_decoder_set_recovery_budget(&default_decoder, max_candidates);
+}
+
+void wavebird_packet_set_history_repair(bool enabled)
+{
+  wavebird_decoder_set_history_repair(&default_decoder, enabled);
+}
+
+void wavebird_packet_deinterleave(uint32_t *codewords, const uint8_t *packet)
+{
+  // Load the interleaved payload, nibble N holds bit N of each codeword
+  uint32_t interleaved[CODEWORD_COUNT];
+  load_interleaved(interleaved, packet);
+
+  // Transpose the low and high 16 bits of each codeword
+  uint64_t low  = transpose_nibbles(interleaved[0] | (uint64_t)interleaved[1] << 32);
+  uint64_t high = transpose_nibbles(interleaved[2] | (uint64_t)interleaved[3] << 32);
+
+  for (int i = 0; i < CODEWORD_COUNT; i++)
+    codewords[i] = (uint16_t)(low >> (16 * i)) | (uint32_t)(uint16_t)(high >> (16 * i)) << 16;
 }
 
 void wavebird_packet_interleave(uint8_t *packet, const uint32_t *codewords)
 {
-  // Step through each bit of each codeword
-  for (uint8_t i = 0; i < PACKET_DATA_BITS; i++) {
-    // Extract the bit from the codeword
-    bool bit = (codewords[i % CODEWORD_COUNT] >> (i / 4)) & 1;
+  // Transpose the low and high 16 bits of each codeword into nibbles
+  uint64_t low  = transpose_lanes(pack_lanes(codewords, 0));
+  uint64_t high = transpose_lanes(pack_lanes(codewords, 16));
 
-    // Set the bit in the packet
-    set_bit(packet, WAVEBIRD_PACKET_BYTES, i + PACKET_DATA_START, bit);
-  }
+  uint32_t interleaved[CODEWORD_COUNT] = {low, low >> 32, high, high >> 32};
+  store_interleaved(packet, interleaved);
 }
 
-int wavebird_packet_decode(uint8_t *message, const uint8_t *packet)
+// Decode the 4 codewords of a packet, recording the details of each codeword if requested
+// With the decode tables, deinterleaving and decoding each codeword is faster than bit-sliced decoding all 4 at once,
+// whichever way errors are located
+static int decode_codewords(uint32_t *decoded, wavebird_decode_result_t *result, const uint8_t *packet)
 {
-  // Deinterleave the input data into 4, 31-bit codewords
+#if WAVEBIRD_BCH3121_TABLES
+  uint32_t codewords[CODEWORD_COUNT];
   wavebird_packet_deinterleave(codewords, packet);
 
-  // Explicitly zero the first 4 bits of the message. We don't actually
-  // care about these, but we want the complete message to be consistent
-  // every time is is generated.
-  message[0] = 0x00;
+  if (!result) {
+    int total_errors = 0;
+    for (int i = 0; i < CODEWORD_COUNT; i++) {
+      int rc = bch3121_decode_and_correct(&decoded[i], codewords[i]);
+      if (rc < 0)
+        return rc;
+
+      total_errors += rc;
+    }
+
+    return total_errors;
+  }
 
-  // Decode each codeword, and pack them into the message
+  // Correct every codeword, even after one fails, so the result covers the whole packet
+  int rc = 0;
   for (int i = 0; i < CODEWORD_COUNT; i++) {
-    // Attempt to decode the codeword
-    uint32_t codeword;
-    if (bch3121_decode_and_correct(&codeword, codewords[i]) < 0)
-      return -WB_PACKET_ERR_DECODE_FAILED;
+    result->syndromes[i] = bch3121_decode(&decoded[i], codewords[i]);
+    result->corrected[i] = 0;
+    if (result->syndromes[i]) {
+      result->corrected[i] = bch3121_decode_and_correct(&decoded[i], codewords[i]);
+      if (result->corrected[i] < 0 && rc >= 0)
+        rc = result->corrected[i];
+    }
+  }
+#else
+  // Decode all 4 codewords in parallel, straight from the nibble-interleaved layout
+  uint32_t interleaved[CODEWORD_COUNT];
+  load_interleaved(interleaved, packet);
+
+  if (!result)
+    return bch3121_decode_and_correct_x4(decoded, interleaved);
+
+  int rc = bch3121_decode_and_correct_x4_detailed(decoded, result->syndromes, result->corrected, interleaved);
+#endif
+
+  result->failed_codeword = -1;
+  result->corrected_bits  = 0;
+  for (int i = CODEWORD_COUNT - 1; i >= 0; i--) {
+    if (result->corrected[i] < 0)
+      result->failed_codeword = i;
+    else
+      result->corrected_bits += result->corrected[i];
+  }
 
-    // Pack the decoded codeword into the message
-    for (int j = 0; j < BCH3121_MESSAGE_LEN; j++) {
-      // Extract bit from codeword
-      uint8_t bit = codeword & 1;
+  return rc < 0 ? rc : result->corrected_bits;
+}
 
-      // Set the bit in message
-      set_bit(message, WAVEBIRD_MESSAGE_BYTES, i * BCH3121_MESSAGE_LEN + j, bit);
+// Decode and CRC check the 4 codewords of a packet
+static int decode_packet(wavebird_decoder_t *decoder, uint32_t *decoded, wavebird_decode_result_t *result,
+                         const uint8_t *packet)
+{
+  // Extract the expected CRC from the packet
+  uint16_t expected_crc = wavebird_packet_get_crc(packet);
+  if (result) {
+    result->expected_crc = expected_crc;
+    result->actual_crc   = 0;
+  }
+
+  // Decode the 4 codewords
+  if (decode_codewords(decoded, result, packet) < 0) {
+    if (!decoder->recovery_budget && !decoder->history_repair)
+      return -WB_PACKET_ERR_DECODE_FAILED;
 
-      // Set the bit in the CRC state (transposed)
-      set_bit(crc_state, WAVEBIRD_MESSAGE_BYTES, j * CODEWORD_COUNT + i, bit);
+    // Only packets with a single uncorrectable codeword can be fixed
+    uint32_t received[CODEWORD_COUNT];
+    int failed = find_failed_codeword(received, decoded, packet);
+    if (failed < 0)
+      return -WB_PACKET_ERR_DECODE_FAILED;
 
-      // Shift the codeword right
-      codeword >>= 1;
+    int rc = -WB_PACKET_ERR_DECODE_FAILED;
+    if (decoder->recovery_budget)
+      rc = recover_packet(decoder, decoded, received, failed, expected_crc);
+    if (rc < 0 && decoder->history_repair)
+      rc = repair_packet(decoder, decoded, failed, expected_crc);
+    if (rc < 0)
+      return rc;
+
+    if (result) {
+      result->corrected[failed] = __builtin_popcount(bch3121_encode(decoded[failed]) ^ received[failed]);
+      result->actual_crc        = expected_crc;
+      result->corrected_bits += result->corrected[failed];
     }
+
+    if (decoder->history_repair)
+      remember_packet(decoder, decoded);
+
+    return rc;
   }
 
-  // Extract the expected CRC from the packet, and calculate the actual CRC
-  uint16_t expected_crc = wavebird_packet_get_crc(packet);
-  uint16_t actual_crc   = crc_fn(crc_state, WAVEBIRD_MESSAGE_BYTES) ^ CRC_FINAL_XOR;
+  // Calculate the actual CRC
+  uint16_t actual_crc = packet_crc(decoder, decoded);
+  if (result)
+    result->actual_crc = actual_crc;
 
   // Return error code if CRCs do not match
   if (expected_crc != actual_crc)
     return -WB_PACKET_ERR_CRC_MISMATCH;
 
+  if (decoder->history_repair)
+    remember_packet(decoder, decoded);
+
   return 0;
 }
 
-void wavebird_packet_encode(uint8_t *packet, const uint8_t *message)
+int wavebird_packet_decode_header(uint16_t *header, const uint8_t *packet)
+{
+  uint32_t codewords[CODEWORD_COUNT];
+  wavebird_packet_deinterleave(codewords, packet);
+
+  // The header is in the top 16 bits of the last codeword, so only that one needs decoding
+  uint32_t decoded;
+  if (bch3121_decode_and_correct(&decoded, codewords[CODEWORD_COUNT - 1]) < 0)
+    return -WB_PACKET_ERR_DECODE_FAILED;
+
+  *header = decoded >> 5;
+
+  return 0;
+}
+
+int wavebird_packet_decode_buttons(uint16_t *header, uint16_t *buttons, const uint8_t *packet)
+{
+  uint32_t codewords[CODEWORD_COUNT];
+  wavebird_packet_deinterleave(codewords, packet);
+
+  // The buttons follow the header, in the low 5 bits of the last codeword and the top 7 bits of the one before
+  uint32_t decoded[2];
+  if (bch3121_decode_and_correct(&decoded[0], codewords[CODEWORD_COUNT - 2]) < 0 ||
+      bch3121_decode_and_correct(&decoded[1], codewords[CODEWORD_COUNT - 1]) < 0)
+    return -WB_PACKET_ERR_DECODE_FAILED;
+
+  *header  = decoded[1] >> 5;
+  *buttons = (decoded[1] & 0x1F) << 7 | decoded[0] >> 14;
+
+  return 0;
+}
+
+int wavebird_decoder_decode(wavebird_decoder_t *decoder, uint8_t *message, const uint8_t *packet)
+{
+  return wavebird_decoder_decode_ex(decoder, message, NULL, packet);
+}
+
+int wavebird_decoder_decode_ex(wavebird_decoder_t *decoder, uint8_t *message, wavebird_decode_result_t *result,
+                               const uint8_t *packet)
+{
+  uint32_t decoded[CODEWORD_COUNT];
+  int rc = decode_packet(decoder, decoded, result, packet);
+  if (rc < 0)
+    return rc;
+
+  // Pack the decoded codewords into the message
+  pack_message(message, decoded);
+
+  return rc;
+}
+
+int wavebird_decoder_decode_gc_state(wavebird_decoder_t *decoder, wavebird_gc_state_t *state, const uint8_t *packet)
+{
+  return wavebird_decoder_decode_gc_state_ex(decoder, state, NULL, packet);
+}
+
+int wavebird_decoder_decode_gc_state_ex(wavebird_decoder_t *decoder, wavebird_gc_state_t *state,
+                                        wavebird_decode_result_t *result, const uint8_t *packet)
 {
-  // Construct and encode the codewords
+  uint32_t decoded[CODEWORD_COUNT];
+  int rc = decode_packet(decoder, decoded, result, packet);
+  if (rc < 0)
+    return rc;
+
+  // Unpack the decoded codewords into the controller state
+  unpack_gc_state(state, decoded);
+
+  return rc;
+}
+
+int wavebird_decoder_decode_soft(wavebird_decoder_t *decoder, uint8_t *message, const uint8_t *packet,
+                                 const uint8_t *reliability)
+{
+  // Most packets are fine, try a regular hard-decision decode first
+  int rc = wavebird_decoder_decode(decoder, message, packet);
+  if (rc >= 0)
+    return rc;
+
+  // Deinterleave the input data into 4, 31-bit codewords
+  uint32_t received[CODEWORD_COUNT] = {0};
+  wavebird_packet_deinterleave(received, packet);
+
+  // Find the most likely messages for each codeword
+  struct soft_candidate candidates[CODEWORD_COUNT][SOFT_MAX_CANDIDATES];
+  int counts[CODEWORD_COUNT];
   for (int i = 0; i < CODEWORD_COUNT; i++) {
-    for (int j = 0; j < BCH3121_MESSAGE_LEN; j++) {
-      // Extract the bit from the message
-      uint8_t bit = get_bit(message, WAVEBIRD_MESSAGE_BYTES, i * BCH3121_MESSAGE_LEN + j);
-
-      // Set the bit in the codeword
-      if (bit) {
-        codewords[i] |= (1 << j);
-      } else {
-        codewords[i] &= ~(1 << j);
+    // Gather the reliability of each bit in this codeword
+    uint8_t codeword_reliability[BCH3121_CODEWORD_LEN];
+    for (int j = 0; j < BCH3121_CODEWORD_LEN; j++)
+      codeword_reliability[j] = reliability[PACKET_DATA_BITS - 1 - (j * CODEWORD_COUNT + i)];
+
+    counts[i] = find_soft_candidates(candidates[i], received[i], codeword_reliability);
+    if (counts[i] == 0)
+      return -WB_PACKET_ERR_DECODE_FAILED;
+  }
+
+  // The CRC itself may also be corrupted, so consider flipping its least reliable bits too
+  uint8_t crc_reliability[16];
+  for (int j = 0; j < 16; j++)
+    crc_reliability[j] = reliability[PACKET_DATA_BITS + 15 - j];
+
+  uint8_t weakest[SOFT_CHASE_BITS];
+  find_weakest_bits(weakest, crc_reliability, 16);
+
+  struct soft_candidate crc_candidates[1 << SOFT_CHASE_BITS];
+  for (uint32_t pattern = 0; pattern < (1 << SOFT_CHASE_BITS); pattern++) {
+    crc_candidates[pattern].message = wavebird_packet_get_crc(packet);
+    crc_candidates[pattern].metric  = 0;
+    for (int i = 0; i < SOFT_CHASE_BITS; i++) {
+      if (pattern & (1 << i)) {
+        crc_candidates[pattern].message ^= 1 << weakest[i];
+        crc_candidates[pattern].metric += crc_reliability[weakest[i]];
       }
+    }
+  }
+
+  // Search every combination of candidates for the most likely one with a matching CRC
+  uint32_t best_metric = SOFT_MAX_METRIC + 1;
+  uint32_t decoded[CODEWORD_COUNT], best[CODEWORD_COUNT];
+  uint8_t index[CODEWORD_COUNT] = {0};
+  while (index[CODEWORD_COUNT - 1] < counts[CODEWORD_COUNT - 1]) {
+    uint32_t metric = 0;
+    for (int i = 0; i < CODEWORD_COUNT; i++) {
+      decoded[i] = candidates[i][index[i]].message;
+      metric += candidates[i][index[i]].metric;
+    }
+
+    // Check the combination's CRC, if it's more likely than the best so far
+    if (metric < best_metric) {
+      uint16_t crc = packet_crc(decoder, decoded);
 
-      // Set the bit in the CRC state (transposed)
-      set_bit(crc_state, WAVEBIRD_MESSAGE_BYTES, j * CODEWORD_COUNT + i, bit);
+      for (int i = 0; i < (1 << SOFT_CHASE_BITS); i++) {
+        if (crc == crc_candidates[i].message && metric + crc_candidates[i].metric < best_metric) {
+          best_metric = metric + crc_candidates[i].metric;
+          memcpy(best, decoded, sizeof(best));
+        }
+      }
     }
 
-    // Encode into a BCH(31,21) codeword
-    codewords[i] = bch3121_encode(codewords[i]);
+    // Move to the next combination
+    for (int i = 0; i < CODEWORD_COUNT; i++) {
+      if (++index[i] < counts[i] || i == CODEWORD_COUNT - 1)
+        break;
+      index[i] = 0;
+    }
   }
 
+  // Return error code if no combination matched the CRC
+  if (best_metric > SOFT_MAX_METRIC)
+    return -WB_PACKET_ERR_CRC_MISMATCH;
+
+  pack_message(message, best);
+
+  return 0;
+}
+
+void wavebird_decoder_encode(wavebird_decoder_t *decoder, uint8_t *packet, const uint8_t *message)
+{
+  // Split the message into 4, 21-bit messages
+  uint64_t low  = (uint64_t)load_be32(&message[3]) << 32 | load_be32(&message[7]);
+  uint32_t high = message[0] << 16 | message[1] << 8 | message[2];
+
+  uint32_t messages[CODEWORD_COUNT] = {
+      low & MESSAGE_MASK,
+      (low >> 21) & MESSAGE_MASK,
+      (low >> 42) & MESSAGE_MASK,
+      (low >> 63 | high << 1) & MESSAGE_MASK,
+  };
+
+  // Encode into BCH(31,21) codewords
+  uint32_t codewords[CODEWORD_COUNT];
+  for (int i = 0; i < CODEWORD_COUNT; i++)
+    codewords[i] = bch3121_encode(messages[i]);
+
   // Interleave the codewords
   wavebird_packet_interleave(packet, codewords);
 
   // Calculate and set the CRC
-  uint16_t crc = crc_fn(crc_state, WAVEBIRD_MESSAGE_BYTES) ^ CRC_FINAL_XOR;
-  wavebird_packet_set_crc(packet, crc);
+  wavebird_packet_set_crc(packet, packet_crc(decoder, messages));
 
   // Set the footer
   wavebird_packet_set_footer(packet, 0x000);
-}
\ No newline at end of file
+}
+
+int wavebird_packet_decode(uint8_t *message, const uint8_t *packet)
+{
+  return wavebird_decoder_decode(&default_decoder, message, packet);
+}
+
+int wavebird_packet_decode_ex(uint8_t *message, wavebird_decode_result_t *result, const uint8_t *packet)
+{
+  return wavebird_decoder_decode_ex(&default_decoder, message, result, packet);
+}
+
+int wavebird_packet_decode_gc_state(wavebird_gc_state_t *state, const uint8_t *packet)
+{
+  return wavebird_decoder_decode_gc_state(&default_decoder, state, packet);
+}
+
+int wavebird_packet_decode_gc_state_ex(wavebird_gc_state_t *state, wavebird_decode_result_t *result,
+                                       const uint8_t *packet)
+{
+  return wavebird_decoder_decode_gc_state_ex(&default_decoder, state, result, packet);
+}
+
+int wavebird_packet_decode_soft(uint8_t *message, const uint8_t *packet, const uint8_t *reliability)
+{
+  return wavebird_decoder_decode_soft(&default_decoder, message, packet, reliability);
+}
+
+void wavebird_packet_encode(uint8_t *packet, const uint8_t *message)
+{
+  wavebird_decoder_encode(&default_decoder, packet, message);
+}
@@ -0,0 +1,48 @@
+#include <string.h>
+
+#include "wavebird/packet_cache.h"
+
+void wavebird_packet_cache_init(wavebird_packet_cache_t *cache)
+{
+  memset(cache, 0, sizeof(*cache));
+}
+
+bool wavebird_packet_cache_lookup(wavebird_packet_cache_t *cache, wavebird_gc_state_t *state, const uint8_t *packet)
+{
+  for (int i = 0; i < WAVEBIRD_PACKET_CACHE_ENTRIES; i++) {
+    struct wavebird_packet_cache_entry *entry = &cache->entries[i];
+
+    // Check the first byte before comparing the whole packet, most mismatches differ early on
+    if (entry->valid && entry->packet[0] == packet[0] && memcmp(entry->packet, packet, WAVEBIRD_PACKET_BYTES) == 0) {
+      *state = entry->state;
+      cache->hits++;
+      return true;
+    }
+  }
+
+  cache->misses++;
+  return false;
+}
+
+void wavebird_packet_cache_store(wavebird_packet_cache_t *cache, const uint8_t *packet,
+                                 const wavebird_gc_state_t *state)
+{
+  // Replace the entry for the same controller and message type, if there is one
+  struct wavebird_packet_cache_entry *entry = NULL;
+  for (int i = 0; i < WAVEBIRD_PACKET_CACHE_ENTRIES; i++) {
+    if (cache->entries[i].valid && cache->entries[i].state.header == state->header) {
+      entry = &cache->entries[i];
+      break;
+    }
+  }
+
+  // Otherwise replace the oldest entry
+  if (!entry) {
+    entry             = &cache->entries[cache->next_entry];
+    cache->next_entry = (cache->next_entry + 1) % WAVEBIRD_PACKET_CACHE_ENTRIES;
+  }
+
+  memcpy(entry->packet, packet, WAVEBIRD_PACKET_BYTES);
+  entry->state = *state;
+  entry->valid = true;
+}
@@ -2,6 +2,9 @@
  * WaveBird radio implementation for EFR32 radios.
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
 #include "rail.h"
 #include "rail_config.h"
 
@@ -16,17 +19,53 @@ enum {
   WB_RADIO_RX_ACTIVE,
 };
 
-// Mapping from WaveBird channel number to channel index
-// Assumes a starting frequency of 2404.80 Mhz, with channel spacing of 2.4 Mhz
-// The channel map is 0-indexed, WaveBird channels on the channel dial are 1-indexed
-static const uint8_t WAVEBIRD_CHANNEL_MAP[] = {
-    31, 29, 0, 2, 6, 4, 8, 10, 14, 12, 17, 19, 23, 21, 25, 27,
-};
+// Mapping from WaveBird channel number to channel index, see radio.h
+// Assumes the radio config's starting frequency and channel spacing match WAVEBIRD_RADIO_BASE_FREQUENCY and
+// WAVEBIRD_RADIO_CHANNEL_SPACING
+static const uint8_t WAVEBIRD_CHANNEL_MAP[WAVEBIRD_RADIO_CHANNELS] = WAVEBIRD_RADIO_CHANNEL_MAP;
 
 // Interrupt status flags
-static volatile bool packet_held        = false;
 static volatile bool sync_word_detected = false;
-static volatile int error_code          = 0;
+static volatile int16_t sync_word_rssi  = 0;
+
+// Receive counters updated by the interrupt handler
+static volatile uint32_t fifo_overflows  = 0;
+static volatile uint32_t rx_errors       = 0;
+static volatile uint32_t error_overflows = 0;
+
+// Queue of packets held in the RX FIFO, in arrival order, big enough for every packet the FIFO can hold
+// Sizes are powers of two, so the queue indexes can wrap freely
+#define FIFO_PACKETS (WAVEBIRD_RADIO_RX_FIFO_BYTES / WAVEBIRD_PACKET_BYTES)
+#if FIFO_PACKETS <= 16
+#define PACKET_QUEUE_SIZE 16
+#elif FIFO_PACKETS <= 32
+#define PACKET_QUEUE_SIZE 32
+#elif FIFO_PACKETS <= 64
+#define PACKET_QUEUE_SIZE 64
+#elif FIFO_PACKETS <= 128
+#define PACKET_QUEUE_SIZE 128
+#else
+#define PACKET_QUEUE_SIZE 256
+#endif
+
+static struct queued_packet {
+  RAIL_RxPacketHandle_t handle;
+  wavebird_radio_packet_info_t info;
+} packet_queue[PACKET_QUEUE_SIZE];
+
+// Queue of errors, for reporting every error rather than just the latest
+#define ERROR_QUEUE_SIZE 8
+static int error_queue[ERROR_QUEUE_SIZE];
+
+// Queue indexes, the interrupt handler only moves the heads and the main loop only moves the tails, so the queues
+// need no locking
+static atomic_uint_least16_t packet_head = 0;
+static atomic_uint_least16_t packet_tail = 0;
+static atomic_uint_least16_t error_head  = 0;
+static atomic_uint_least16_t error_tail  = 0;
+
+// Packet being passed to the callbacks
+static const struct queued_packet *current_packet = NULL;
 
 // Current radio state
 static uint8_t radio_state     = WB_RADIO_IDLE;
@@ -38,14 +77,26 @@ static wavebird_radio_error_fn_t error_callback                       = NULL;
 static wavebird_radio_pairing_started_fn_t pairing_started_callback   = NULL;
 static wavebird_radio_pairing_finished_fn_t pairing_finished_callback = NULL;
 
-// RAIL handle and RX buffer
+// Receive statistics updated by the main loop
+static wavebird_radio_stats_t stats;
+
+// RAIL handle, RX FIFO, and a buffer for packets which wrap around the end of the FIFO
 static RAIL_Handle_t rail_handle;
+static __ALIGNED(RAIL_FIFO_ALIGNMENT) uint8_t rx_fifo[WAVEBIRD_RADIO_RX_FIFO_BYTES];
+_Static_assert(sizeof(rx_fifo) >= 64 && sizeof(rx_fifo) <= 4096 && (sizeof(rx_fifo) & (sizeof(rx_fifo) - 1)) == 0,
+               "RAIL RX FIFO size must be a power of two from 64 to 4096 bytes");
 static __ALIGNED(RAIL_FIFO_ALIGNMENT) uint8_t packet_buffer[WAVEBIRD_PACKET_BYTES];
 
 // Pairing timeouts
 #define PAIRING_TIMEOUT         30000000  // Timeout entire pairing process after 30 seconds
-#define PAIRING_DETECT_TIMEOUT  10000     // Listen for sync words for 10ms on each channel
-#define PAIRING_QUALIFY_TIMEOUT 200000    // Hold on the channel for 200ms to qualify activity
+#define PAIRING_DETECT_TIMEOUT  5000      // Listen for sync words for 5ms on each channel, longer than a packet period
+#define PAIRING_QUALIFY_TIMEOUT 200000    // Hold on a channel for up to 200ms to qualify activity
+#define PAIRING_QUALIFY_IDLE    20000     // Stop qualifying a channel after 20ms without a packet
+
+// Pairing channel ranking
+#define PAIRING_NEAR_RSSI    -50  // Qualify a channel as soon as a sync word this strong is heard, in dBm
+#define PAIRING_ACTIVE_RSSI  -90  // Rank a channel as active when its RSSI peaks above this, in dBm
+#define PAIRING_QUIET_ROUNDS 2    // Only scan quiet channels every other round
 
 // Pairing configuration
 static wavebird_radio_qualify_fn_t qualify_fn = NULL;
@@ -53,14 +104,73 @@ static uint8_t qualify_threshold              = 5;
 
 // Pairing state
 static struct pairing_state {
-  bool first_scan;
   uint8_t channel;
+  uint8_t last_channel;
   uint32_t timeout;
   uint32_t detect_timeout;
   uint32_t qualify_timeout;
+  uint32_t last_packet;
   uint8_t qualified_packets;
+  uint8_t rejected_packets;
+  uint8_t round;
+  uint8_t scan_order[WAVEBIRD_RADIO_CHANNELS];
+  uint8_t scan_count;
+  uint8_t scan_index;
+  uint8_t candidates[WAVEBIRD_RADIO_CHANNELS];
+  uint8_t candidate_count;
+  uint8_t candidate_index;
+  bool ranked;
 } pairing_state;
 
+// Activity seen on each channel while pairing, kept between pairing attempts to scan busy channels first
+static struct channel_activity {
+  uint8_t score;  // Rises when the channel is busy and decays when it is quiet
+  int16_t rssi;   // Peak RSSI the last time the channel was scanned, in quarter dBm
+  bool sync_word; // A sync word was heard the last time the channel was scanned
+  bool qualified; // The channel has been qualified this round
+} channel_activity[WAVEBIRD_RADIO_CHANNELS];
+
+// Queue an error for the main loop to report, from the interrupt handler
+static void queue_error(int error)
+{
+  uint_least16_t head = atomic_load_explicit(&error_head, memory_order_relaxed);
+  uint_least16_t tail = atomic_load_explicit(&error_tail, memory_order_acquire);
+  if ((uint16_t)(head - tail) == ERROR_QUEUE_SIZE) {
+    error_overflows++;
+    return;
+  }
+
+  error_queue[head % ERROR_QUEUE_SIZE] = error;
+  atomic_store_explicit(&error_head, (uint16_t)(head + 1), memory_order_release);
+}
+
+// Queue a held packet for the main loop, with when it arrived, how strong it was and the channel it was heard on,
+// from the interrupt handler
+static void queue_packet(RAIL_Handle_t handle, RAIL_RxPacketHandle_t rx_handle)
+{
+  uint_least16_t head = atomic_load_explicit(&packet_head, memory_order_relaxed);
+  uint_least16_t tail = atomic_load_explicit(&packet_tail, memory_order_acquire);
+  if ((uint16_t)(head - tail) == PACKET_QUEUE_SIZE) {
+    // The queue holds every packet the FIFO can, so this shouldn't happen, but never leave a packet held untracked
+    RAIL_ReleaseRxPacket(handle, rx_handle);
+    fifo_overflows++;
+    queue_error(-WB_RADIO_ERR_RX_OVERFLOW);
+    return;
+  }
+
+  // Timestamp the end of the packet, when it finished arriving over the air
+  RAIL_RxPacketDetails_t details = {0};
+  RAIL_GetRxPacketDetailsAlt(handle, rx_handle, &details);
+  RAIL_GetRxTimePacketEndAlt(handle, &details);
+
+  struct queued_packet *entry = &packet_queue[head % PACKET_QUEUE_SIZE];
+  entry->handle               = rx_handle;
+  entry->info.timestamp       = details.timeReceived.packetTime;
+  entry->info.rssi            = details.rssi;
+  entry->info.channel         = radio_state == WB_RADIO_RX_ACTIVE ? current_channel : pairing_state.channel;
+  atomic_store_explicit(&packet_head, (uint16_t)(head + 1), memory_order_release);
+}
+
 // Interrupt handler for RAIL events
 static void handle_rail_event(RAIL_Handle_t handle, RAIL_Events_t events)
 {
@@ -69,12 +179,18 @@ static void handle_rail_event(RAIL_Handle_t handle, RAIL_Events_t events)
     if (events & RAIL_EVENT_RX_PACKET_RECEIVED) {
       // When in active RX mode, or qualifying a channel for pairing, hold the packet
       if (radio_state == WB_RADIO_RX_PAIRING_QUALIFYING || radio_state == WB_RADIO_RX_ACTIVE) {
-        RAIL_HoldRxPacket(handle);
-        packet_held = true;
+        RAIL_RxPacketHandle_t rx_handle = RAIL_HoldRxPacket(handle);
+        if (rx_handle != RAIL_RX_PACKET_HANDLE_INVALID)
+          queue_packet(handle, rx_handle);
       }
+    } else if (events & RAIL_EVENT_RX_FIFO_OVERFLOW) {
+      // The FIFO is full of packets the main loop hasn't processed yet, so the packet was lost
+      fifo_overflows++;
+      queue_error(-WB_RADIO_ERR_RX_OVERFLOW);
     } else {
       // RX completed without a packet, this is an error
-      error_code = -WB_RADIO_ERR_NO_PACKET;
+      rx_errors++;
+      queue_error(-WB_RADIO_ERR_NO_PACKET);
     }
   }
 
@@ -83,38 +199,247 @@ static void handle_rail_event(RAIL_Handle_t handle, RAIL_Events_t events)
     RAIL_Status_t status = RAIL_Calibrate(handle, NULL, RAIL_CAL_ALL_PENDING);
     if (status != RAIL_STATUS_NO_ERROR) {
       // Calibration error
-      error_code = -WB_RADIO_ERR_CALIBRATION;
+      queue_error(-WB_RADIO_ERR_CALIBRATION);
     }
   }
 
-  // Check for sync words during channel scanning
+  // Check for sync words during channel scanning, and how strong they are
   if (radio_state == WB_RADIO_RX_PAIRING_SCANNING && events & RAIL_EVENT_RX_SYNC1_DETECT) {
+    sync_word_rssi     = RAIL_GetRssi(handle, false);
     sync_word_detected = true;
   }
 }
 
-// Copy the oldest pending packet from the radio buffer to the application buffer
-static bool get_oldest_pending_packet(uint8_t *buffer, RAIL_Handle_t rail_handle)
+// Use the application's RX FIFO instead of RAIL's default, called by RAIL_Init()
+RAIL_Status_t RAILCb_SetupRxFifo(RAIL_Handle_t railHandle)
 {
+  uint16_t size        = sizeof(rx_fifo);
+  RAIL_Status_t status = RAIL_SetRxFifo(railHandle, rx_fifo, &size);
+  if (status == RAIL_STATUS_NO_ERROR && size != sizeof(rx_fifo))
+    return RAIL_STATUS_INVALID_PARAMETER;
+
+  return status;
+}
+
+// Release the oldest queued packet, freeing its space in the RX FIFO
+static void release_packet(void)
+{
+  uint_least16_t tail = atomic_load_explicit(&packet_tail, memory_order_relaxed);
+  RAIL_ReleaseRxPacket(rail_handle, packet_queue[tail % PACKET_QUEUE_SIZE].handle);
+  atomic_store_explicit(&packet_tail, (uint16_t)(tail + 1), memory_order_release);
+
+  current_packet = NULL;
+}
+
+// Get the oldest queued packet, in place in the RX FIFO, or copied to the packet buffer if it wraps around the end
+// Returns false when there are no packets, otherwise the packet must be released once it has been processed
+static bool get_oldest_pending_packet(const uint8_t **packet)
+{
+  const struct queued_packet *entry;
   RAIL_RxPacketInfo_t packet_info;
-  RAIL_RxPacketHandle_t rx_handle;
 
-  // Get the oldest complete packet (if any)
-  rx_handle = RAIL_GetRxPacketInfo(rail_handle, RAIL_RX_PACKET_HANDLE_OLDEST_COMPLETE, &packet_info);
-  if (rx_handle == RAIL_RX_PACKET_HANDLE_INVALID)
-    return false;
+  while (true) {
+    uint_least16_t tail = atomic_load_explicit(&packet_tail, memory_order_relaxed);
+    uint_least16_t head = atomic_load_explicit(&packet_head, memory_order_acquire);
+    if (head == tail)
+      return false;
+
+    // Track the most packets ever waiting, including this one
+    uint16_t pending = head - tail;
+    if (pending > stats.max_pending)
+      stats.max_pending = pending;
+
+    // Skip packets which are no longer in the FIFO
+    entry = &packet_queue[tail % PACKET_QUEUE_SIZE];
+    if (RAIL_GetRxPacketInfo(rail_handle, entry->handle, &packet_info) != RAIL_RX_PACKET_HANDLE_INVALID)
+      break;
 
-  // Copy the packet from the radio buffer to the application buffer
-  RAIL_CopyRxPacket(buffer, &packet_info);
-  RAIL_ReleaseRxPacket(rail_handle, rx_handle);
+    release_packet();
+    stats.dropped_packets++;
+  }
+
+  // Packets which wrap around the end of the FIFO are copied out, so the callbacks always get them in one piece
+  if (packet_info.lastPortionData == NULL) {
+    *packet = packet_info.firstPortionData;
+  } else {
+    RAIL_CopyRxPacket(packet_buffer, &packet_info);
+    *packet = packet_buffer;
+    stats.copied_packets++;
+  }
 
+  current_packet = entry;
+  stats.packets++;
   return true;
 }
 
+// Release any packets still queued, such as those from a channel which didn't qualify
+static void release_pending_packets(void)
+{
+  while (atomic_load_explicit(&packet_tail, memory_order_relaxed) !=
+         atomic_load_explicit(&packet_head, memory_order_acquire)) {
+    release_packet();
+    stats.dropped_packets++;
+  }
+}
+
+// Report queued errors to the error handler
+static void report_errors(void)
+{
+  uint_least16_t tail = atomic_load_explicit(&error_tail, memory_order_relaxed);
+  while (tail != atomic_load_explicit(&error_head, memory_order_acquire)) {
+    int error = error_queue[tail % ERROR_QUEUE_SIZE];
+    atomic_store_explicit(&error_tail, (uint16_t)(tail + 1), memory_order_release);
+    tail++;
+
+    if (error_callback != NULL)
+      error_callback(error);
+  }
+}
+
+// Reset the radio channel and finish pairing
+static void finish_pairing(uint8_t status, uint8_t channel)
+{
+  wavebird_radio_set_channel(channel);
+
+  if (pairing_finished_callback)
+    pairing_finished_callback(status, channel);
+}
+
+// Start a round of scanning, busiest channels first, with the channel last paired to first on the first round
+static void start_scan_round(void)
+{
+  pairing_state.scan_count = 0;
+  if (pairing_state.round == 0)
+    pairing_state.scan_order[pairing_state.scan_count++] = pairing_state.last_channel;
+
+  uint8_t first = pairing_state.scan_count;
+  for (uint8_t channel = 0; channel < WAVEBIRD_RADIO_CHANNELS; channel++) {
+    channel_activity[channel].qualified = false;
+
+    // Skip quiet channels on most rounds, they are less likely to have the controller on them
+    if (pairing_state.round == 0 && channel == pairing_state.last_channel)
+      continue;
+    if (channel_activity[channel].score == 0 && pairing_state.round % PAIRING_QUIET_ROUNDS != 0)
+      continue;
+
+    // Insert in order of activity, keeping channels with the same activity in channel order
+    uint8_t i = pairing_state.scan_count++;
+    for (; i > first && channel_activity[pairing_state.scan_order[i - 1]].score < channel_activity[channel].score; i--)
+      pairing_state.scan_order[i] = pairing_state.scan_order[i - 1];
+    pairing_state.scan_order[i] = channel;
+  }
+
+  pairing_state.round++;
+  pairing_state.scan_index      = 0;
+  pairing_state.candidate_count = 0;
+  pairing_state.candidate_index = 0;
+  pairing_state.ranked          = false;
+}
+
+// Rank the channels a sync word was heard on this round, strongest first
+static void rank_candidates(void)
+{
+  for (uint8_t s = 0; s < pairing_state.scan_count; s++) {
+    uint8_t channel = pairing_state.scan_order[s];
+    if (!channel_activity[channel].sync_word || channel_activity[channel].qualified)
+      continue;
+
+    uint8_t i = pairing_state.candidate_count++;
+    for (; i > 0 && channel_activity[pairing_state.candidates[i - 1]].rssi < channel_activity[channel].rssi; i--)
+      pairing_state.candidates[i] = pairing_state.candidates[i - 1];
+    pairing_state.candidates[i] = channel;
+  }
+
+  pairing_state.ranked = true;
+}
+
+// Update a channel's activity once it has been scanned
+static void finish_scan(uint8_t channel)
+{
+  struct channel_activity *activity = &channel_activity[channel];
+
+  if (activity->sync_word) {
+    activity->score = activity->score > 255 - 64 ? 255 : activity->score + 64;
+  } else if (activity->rssi >= PAIRING_ACTIVE_RSSI * 4) {
+    activity->score = activity->score > 255 - 16 ? 255 : activity->score + 16;
+  } else {
+    activity->score /= 2;
+  }
+}
+
+// Listen for sync words on a channel
+static void start_scan(uint8_t channel)
+{
+  channel_activity[channel].sync_word = false;
+  channel_activity[channel].rssi      = RAIL_RSSI_INVALID;
+
+  pairing_state.channel        = channel;
+  pairing_state.detect_timeout = RAIL_GetTime() + PAIRING_DETECT_TIMEOUT;
+  RAIL_StartRx(rail_handle, WAVEBIRD_CHANNEL_MAP[channel], NULL);
+
+  sync_word_detected = false;
+  radio_state        = WB_RADIO_RX_PAIRING_SCANNING;
+}
+
+// Hold on a channel to qualify its activity
+static void start_qualifying(uint8_t channel)
+{
+  channel_activity[channel].qualified = true;
+
+  pairing_state.channel           = channel;
+  pairing_state.qualify_timeout   = RAIL_GetTime() + PAIRING_QUALIFY_TIMEOUT;
+  pairing_state.last_packet       = RAIL_GetTime();
+  pairing_state.qualified_packets = 0;
+  pairing_state.rejected_packets  = 0;
+  RAIL_StartRx(rail_handle, WAVEBIRD_CHANNEL_MAP[channel], NULL);
+
+  release_pending_packets();
+  radio_state = WB_RADIO_RX_PAIRING_QUALIFYING;
+}
+
+// Move on to the next channel to scan this round, then qualify the channels sync words were heard on, then start the
+// next round
+static void pairing_next(void)
+{
+  while (true) {
+    if (pairing_state.scan_index < pairing_state.scan_count) {
+      start_scan(pairing_state.scan_order[pairing_state.scan_index++]);
+      return;
+    }
+
+    if (!pairing_state.ranked)
+      rank_candidates();
+
+    while (pairing_state.candidate_index < pairing_state.candidate_count) {
+      uint8_t channel = pairing_state.candidates[pairing_state.candidate_index++];
+      if (!channel_activity[channel].qualified) {
+        start_qualifying(channel);
+        return;
+      }
+    }
+
+    start_scan_round();
+  }
+}
+
 int wavebird_radio_init(wavebird_radio_packet_fn_t packet_fn, wavebird_radio_error_fn_t error_fn)
 {
   RAIL_Status_t status = RAIL_STATUS_NO_ERROR;
 
+  // Forget any channel activity, and reset the statistics
+  memset(channel_activity, 0, sizeof(channel_activity));
+  memset(&stats, 0, sizeof(stats));
+  fifo_overflows  = 0;
+  rx_errors       = 0;
+  error_overflows = 0;
+
+  // Empty the queues, RAIL_Init() frees any packets left in the FIFO
+  atomic_store(&packet_head, 0);
+  atomic_store(&packet_tail, 0);
+  atomic_store(&error_head, 0);
+  atomic_store(&error_tail, 0);
+  current_packet = NULL;
+
   // Set the callback functions
   packet_callback = packet_fn;
   error_callback  = error_fn;
@@ -199,13 +524,13 @@ void wavebird_radio_start_pairing(void)
   RAIL_Idle(rail_handle, RAIL_IDLE, true);
 
   // Reset the pairing state
-  pairing_state.timeout           = RAIL_GetTime() + PAIRING_TIMEOUT;
-  pairing_state.first_scan        = true;
-  pairing_state.channel           = 0;
-  pairing_state.qualified_packets = 0;
+  pairing_state.timeout      = RAIL_GetTime() + PAIRING_TIMEOUT;
+  pairing_state.last_channel = current_channel;
+  pairing_state.round        = 0;
 
   // Start the channel scanning process
-  radio_state = WB_RADIO_RX_PAIRING_SCANNING;
+  start_scan_round();
+  pairing_next();
 
   // Fire the pairing started callback
   if (pairing_started_callback)
@@ -214,12 +539,26 @@ void wavebird_radio_start_pairing(void)
 
 void wavebird_radio_stop_pairing(void)
 {
-  // Reset the channel
-  wavebird_radio_set_channel(current_channel);
+  // Reset the channel, and fire the pairing finished callback
+  finish_pairing(WB_RADIO_PAIRING_CANCELLED, current_channel);
+}
 
-  // Fire the pairing finished callback
-  if (pairing_finished_callback)
-    pairing_finished_callback(WB_RADIO_PAIRING_CANCELLED, current_channel);
+void wavebird_radio_get_stats(wavebird_radio_stats_t *_stats)
+{
+  *_stats                 = stats;
+  _stats->fifo_overflows  = fifo_overflows;
+  _stats->rx_errors       = rx_errors;
+  _stats->error_overflows = error_overflows;
+}
+
+const wavebird_radio_packet_info_t *wavebird_radio_get_packet_info(void)
+{
+  return current_packet != NULL ? &current_packet->info : NULL;
+}
+
+uint32_t wavebird_radio_get_time(void)
+{
+  return RAIL_GetTime();
 }
 
 void wavebird_radio_process(void)
@@ -230,93 +569,97 @@ void wavebird_radio_process(void)
       break;
 
     // Loop through channels, listening for sync words
-    case WB_RADIO_RX_PAIRING_SCANNING:
-      // Check for activity on the current channel
-      if (sync_word_detected) {
-        sync_word_detected            = false;
-        pairing_state.qualify_timeout = RAIL_GetTime() + PAIRING_QUALIFY_TIMEOUT;
-
-        radio_state = WB_RADIO_RX_PAIRING_QUALIFYING;
-      }
-
+    case WB_RADIO_RX_PAIRING_SCANNING: {
       // Check if the pairing timeout has expired
       if (RAIL_GetTime() > pairing_state.timeout) {
-        // Reset the channel to the original channel
-        wavebird_radio_set_channel(current_channel);
-
-        // Fire the pairing callback
-        if (pairing_finished_callback)
-          pairing_finished_callback(WB_RADIO_PAIRING_TIMEOUT, current_channel);
-
+        finish_pairing(WB_RADIO_PAIRING_TIMEOUT, current_channel);
         break;
       }
 
-      // If this is the first scan, or the detect timeout has expired, move to the next channel
-      if (pairing_state.first_scan || RAIL_GetTime() > pairing_state.detect_timeout) {
-        if (pairing_state.first_scan) {
-          pairing_state.first_scan = false;
-        } else {
-          pairing_state.channel = (pairing_state.channel + 1) % 16;
+      // Track the channel's peak RSSI, to rank it against the other channels
+      struct channel_activity *activity = &channel_activity[pairing_state.channel];
+      int16_t rssi                      = RAIL_GetRssi(rail_handle, false);
+      if (rssi != RAIL_RSSI_INVALID && rssi > activity->rssi)
+        activity->rssi = rssi;
+
+      // Check for activity on the current channel, qualifying it straight away if the controller is close by, or it's
+      // the channel last paired to on the first round
+      if (sync_word_detected) {
+        sync_word_detected  = false;
+        activity->sync_word = true;
+
+        bool last_channel = pairing_state.round == 1 && pairing_state.channel == pairing_state.last_channel;
+        if (sync_word_rssi >= PAIRING_NEAR_RSSI * 4 || last_channel) {
+          finish_scan(pairing_state.channel);
+          start_qualifying(pairing_state.channel);
+          break;
         }
+      }
 
-        pairing_state.detect_timeout = RAIL_GetTime() + PAIRING_DETECT_TIMEOUT;
-        RAIL_StartRx(rail_handle, WAVEBIRD_CHANNEL_MAP[pairing_state.channel], NULL);
+      // If the detect timeout has expired, move to the next channel
+      if (RAIL_GetTime() > pairing_state.detect_timeout) {
+        finish_scan(pairing_state.channel);
+        pairing_next();
       }
 
       break;
+    }
 
     // Hold on the channel for a short time to qualify pairing activity
     case WB_RADIO_RX_PAIRING_QUALIFYING:
+      // Check if the pairing timeout has expired
+      if (RAIL_GetTime() > pairing_state.timeout) {
+        finish_pairing(WB_RADIO_PAIRING_TIMEOUT, current_channel);
+        break;
+      }
+
       // Check for packets on the current channel
-      if (packet_held) {
-        while (get_oldest_pending_packet(packet_buffer, rail_handle)) {
-          // Check if the packet qualifies for pairing
-          if (!qualify_fn || qualify_fn(packet_buffer))
-            pairing_state.qualified_packets++;
-
-          // If we have received enough qualifying packets, finish pairing
-          if (pairing_state.qualified_packets >= qualify_threshold) {
-            // Set the new channel
-            wavebird_radio_set_channel(pairing_state.channel);
-
-            // Fire the pairing callback
-            if (pairing_finished_callback)
-              pairing_finished_callback(WB_RADIO_PAIRING_SUCCESS, pairing_state.channel);
-
-            break;
-          }
+      const uint8_t *packet;
+      while (get_oldest_pending_packet(&packet)) {
+        pairing_state.last_packet = RAIL_GetTime();
+
+        // Check if the packet qualifies for pairing
+        if (!qualify_fn || qualify_fn(packet)) {
+          pairing_state.qualified_packets++;
+        } else {
+          pairing_state.rejected_packets++;
         }
+        release_packet();
 
-        packet_held = false;
+        // If we have received enough qualifying packets, finish pairing
+        if (pairing_state.qualified_packets >= qualify_threshold) {
+          channel_activity[pairing_state.channel].score = 255;
+          finish_pairing(WB_RADIO_PAIRING_SUCCESS, pairing_state.channel);
+          break;
+        }
       }
 
-      // If the qualify timeout has expired, move back to scanning
-      if ((RAIL_GetTime() > pairing_state.qualify_timeout)) {
-        pairing_state.qualified_packets = 0;
+      if (radio_state != WB_RADIO_RX_PAIRING_QUALIFYING)
+        break;
 
-        radio_state = WB_RADIO_RX_PAIRING_SCANNING;
+      // Move on once the channel has only sent packets which don't qualify, has gone quiet, or the qualify timeout has
+      // expired
+      if ((pairing_state.rejected_packets >= qualify_threshold && pairing_state.qualified_packets == 0) ||
+          RAIL_GetTime() - pairing_state.last_packet > PAIRING_QUALIFY_IDLE ||
+          RAIL_GetTime() > pairing_state.qualify_timeout) {
+        release_pending_packets();
+        pairing_next();
       }
       break;
 
     // Listen for packets on the selected/paired channel
-    case WB_RADIO_RX_ACTIVE:
-      // Process received packets, if any
-      if (packet_held) {
-        while (get_oldest_pending_packet(packet_buffer, rail_handle)) {
-          // Pass the packet to the packet handler
-          if (packet_callback != NULL)
-            packet_callback(packet_buffer);
-        }
-
-        // Clear the interrupt flag
-        packet_held = false;
-      } else if (error_code < 0) {
-        // Handle errors from the interrupt handler
-        if (error_callback != NULL)
-          error_callback(error_code);
-
-        // Clear the interrupt flag
-        error_code = 0;
+    case WB_RADIO_RX_ACTIVE: {
+      // Pass received packets to the packet handler, then free their space in the FIFO
+      const uint8_t *packet;
+      while (get_oldest_pending_packet(&packet)) {
+        if (packet_callback != NULL)
+          packet_callback(packet);
+        release_packet();
       }
+      break;
+    }
   }
-}
\ No newline at end of file
+
+  // Report errors from the interrupt handler
+  report_errors();
+}
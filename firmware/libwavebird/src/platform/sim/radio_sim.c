@@ -0,0 +1,483 @@
+/**
+ * Simulated RAIL radio, for running radio_efr32.c on the host.
+ */
+
+#include "rail.h"
+#include "rail_config.h"
+
+#include "wavebird/radio_sim.h"
+
+// Smallest and largest RX FIFO RAIL_SetRxFifo() accepts, in bytes
+#define MIN_FIFO_BYTES 64
+#define MAX_FIFO_BYTES 4096
+
+// Most packets the largest RX FIFO can hold at once
+#define MAX_FIFO_PACKETS (MAX_FIFO_BYTES / WAVEBIRD_PACKET_BYTES)
+
+// Packet in the RX FIFO
+struct fifo_packet {
+  uint16_t offset;   // Offset of the first byte in the FIFO
+  uint32_t sync_end; // Time the end of the sync word was received
+  int8_t rssi;       // Received signal strength, in dBm
+  uint16_t channel;  // RAIL channel index the packet was received on
+  bool held;         // Held by the event handler, so not released when it returns
+  bool released;     // Released, and freed once every older packet has been
+};
+
+// Channel configuration, covering the 32 channel indexes from WAVEBIRD_RADIO_BASE_FREQUENCY
+static const RAIL_ChannelConfigEntry_t channel_entries[] = {
+    {NULL, WAVEBIRD_RADIO_BASE_FREQUENCY, WAVEBIRD_RADIO_CHANNEL_SPACING, 0, 0, 31},
+};
+static const RAIL_ChannelConfig_t channel_config = {NULL, NULL, channel_entries, 1, 0};
+const RAIL_ChannelConfig_t *channelConfigs[]     = {&channel_config};
+
+// RAIL's own RX FIFO
+static __ALIGNED(RAIL_FIFO_ALIGNMENT) uint8_t default_fifo[WAVEBIRD_RADIO_SIM_FIFO_BYTES];
+
+// Simulation state
+static struct {
+  uint32_t now;
+
+  // RAIL configuration
+  void (*events_callback)(RAIL_Handle_t handle, RAIL_Events_t events);
+  RAIL_Events_t events;
+  const RAIL_ChannelConfig_t *channels;
+  RAIL_Status_t calibration_status;
+
+  // Radio state
+  bool receiving;
+  uint16_t rail_channel;
+  uint32_t listen_start;                      // Time the radio started listening on the channel
+  const wavebird_radio_sim_event_t *incoming; // Packet or sync word being received, or NULL
+  uint32_t incoming_end;                      // Time the packet being received ends
+
+  // Timeline
+  const wavebird_radio_sim_event_t *timeline;
+  size_t timeline_count;
+  size_t timeline_next;
+
+  // RX FIFO, RAIL's own unless the application sets one up, packets are stored back to back in arrival order and
+  // freed from the oldest
+  uint8_t *fifo;
+  uint16_t fifo_bytes;
+  uint16_t write_offset; // Offset the next packet is stored at
+  struct fifo_packet packets[MAX_FIFO_PACKETS];
+  uint8_t first_packet;
+  uint8_t packet_count;
+  struct fifo_packet *delivering; // Packet being passed to the event handler, which may hold it
+
+  wavebird_radio_sim_stats_t stats;
+} sim;
+
+// Deliver events to the RAIL event handler, if they are enabled
+static void fire_events(RAIL_Events_t events)
+{
+  events &= sim.events;
+  if (events && sim.events_callback)
+    sim.events_callback(&sim, events);
+}
+
+// Get the RAIL channel index of a WaveBird channel
+static uint16_t rail_channel(uint8_t channel)
+{
+  static const uint8_t channel_map[WAVEBIRD_RADIO_CHANNELS] = WAVEBIRD_RADIO_CHANNEL_MAP;
+  return channel_map[channel % WAVEBIRD_RADIO_CHANNELS];
+}
+
+// Check if the radio is listening on a WaveBird channel
+static bool listening_on(uint8_t channel)
+{
+  return sim.receiving && sim.rail_channel == rail_channel(channel);
+}
+
+// Get the stronger of an RSSI and an event's, if the event is a transmission on the air on the channel listened to
+static int transmission_rssi(const wavebird_radio_sim_event_t *event, int rssi)
+{
+  if (event->type != WB_RADIO_SIM_PACKET && event->type != WB_RADIO_SIM_SYNC_WORD)
+    return rssi;
+
+  if (!listening_on(event->channel) || event->time > sim.now + WAVEBIRD_RADIO_SIM_LEAD_US ||
+      sim.now > event->time + WAVEBIRD_RADIO_SIM_PACKET_US)
+    return rssi;
+
+  return event->rssi > rssi ? event->rssi : rssi;
+}
+
+// Stop receiving the current packet, if any
+static void abort_incoming(void)
+{
+  if (sim.incoming && sim.incoming->type == WB_RADIO_SIM_PACKET)
+    sim.stats.packets_aborted++;
+
+  sim.incoming = NULL;
+}
+
+// Free released packets from the front of the FIFO
+static void free_released_packets(void)
+{
+  while (sim.packet_count > 0 && sim.packets[sim.first_packet].released) {
+    sim.first_packet = (sim.first_packet + 1) % MAX_FIFO_PACKETS;
+    sim.packet_count--;
+  }
+}
+
+// Store a packet in the FIFO, wrapping around the end, and pass it to the event handler
+static void receive_packet(const wavebird_radio_sim_event_t *event)
+{
+  if ((sim.packet_count + 1) * WAVEBIRD_PACKET_BYTES > sim.fifo_bytes) {
+    sim.stats.fifo_overflows++;
+    fire_events(RAIL_EVENT_RX_FIFO_OVERFLOW);
+    return;
+  }
+
+  // Packets are stored back to back, carrying on around the FIFO even once it has emptied, as RAIL's does
+  uint16_t offset  = sim.write_offset;
+  sim.write_offset = (offset + WAVEBIRD_PACKET_BYTES) % sim.fifo_bytes;
+  for (int i = 0; i < WAVEBIRD_PACKET_BYTES; i++)
+    sim.fifo[(offset + i) % sim.fifo_bytes] = event->packet[i];
+
+  struct fifo_packet *slot = &sim.packets[(sim.first_packet + sim.packet_count) % MAX_FIFO_PACKETS];
+  *slot                    = (struct fifo_packet){
+      .offset   = offset,
+      .sync_end = event->time,
+      .rssi     = event->rssi,
+      .channel  = sim.rail_channel,
+  };
+  sim.packet_count++;
+  sim.stats.packets_received++;
+
+  // Packets which aren't held by the event handler are released when it returns
+  sim.delivering = slot;
+  fire_events(RAIL_EVENT_RX_PACKET_RECEIVED);
+  sim.delivering = NULL;
+
+  if (!slot->held) {
+    slot->released = true;
+    free_released_packets();
+  }
+}
+
+// Finish receiving the current packet or sync word
+static void complete_incoming(void)
+{
+  const wavebird_radio_sim_event_t *event = sim.incoming;
+  sim.incoming                            = NULL;
+
+  if (event->type == WB_RADIO_SIM_PACKET) {
+    receive_packet(event);
+  } else {
+    sim.stats.rx_errors++;
+    fire_events(RAIL_EVENT_RX_FRAME_ERROR);
+  }
+}
+
+// Handle the next event on the timeline
+static void handle_timeline_event(const wavebird_radio_sim_event_t *event)
+{
+  switch (event->type) {
+    case WB_RADIO_SIM_PACKET:
+    case WB_RADIO_SIM_SYNC_WORD:
+      // The sync word is only detected if the radio heard all of it, and isn't receiving another packet
+      if (listening_on(event->channel) && sim.now - sim.listen_start >= WAVEBIRD_RADIO_SIM_DETECT_US &&
+          !sim.incoming) {
+        sim.incoming     = event;
+        sim.incoming_end = sim.now + WAVEBIRD_RADIO_SIM_PACKET_US;
+        sim.stats.sync_words++;
+        fire_events(RAIL_EVENT_RX_SYNC1_DETECT);
+      } else if (event->type == WB_RADIO_SIM_PACKET) {
+        sim.stats.packets_missed++;
+      }
+      break;
+
+    case WB_RADIO_SIM_RX_ERROR:
+      if (listening_on(event->channel)) {
+        abort_incoming();
+        sim.stats.rx_errors++;
+        fire_events(RAIL_EVENT_RX_PACKET_ABORTED);
+      }
+      break;
+
+    case WB_RADIO_SIM_CALIBRATION:
+    case WB_RADIO_SIM_CALIBRATION_ERROR:
+      sim.calibration_status =
+          event->type == WB_RADIO_SIM_CALIBRATION ? RAIL_STATUS_NO_ERROR : RAIL_STATUS_INVALID_STATE;
+      fire_events(RAIL_EVENT_CAL_NEEDED);
+      break;
+  }
+}
+
+void wavebird_radio_sim_reset(void)
+{
+  memset(&sim, 0, sizeof(sim));
+  sim.fifo       = default_fifo;
+  sim.fifo_bytes = sizeof(default_fifo);
+}
+
+void wavebird_radio_sim_set_timeline(const wavebird_radio_sim_event_t *events, size_t count)
+{
+  sim.timeline       = events;
+  sim.timeline_count = count;
+  sim.timeline_next  = 0;
+}
+
+void wavebird_radio_sim_advance(uint32_t us)
+{
+  uint32_t end = sim.now + us;
+
+  while (true) {
+    // Find the next thing to happen, finishing a packet before any event at the same time
+    const wavebird_radio_sim_event_t *event = NULL;
+    if (sim.timeline_next < sim.timeline_count)
+      event = &sim.timeline[sim.timeline_next];
+
+    if (sim.incoming && (!event || sim.incoming_end <= event->time)) {
+      if (sim.incoming_end > end)
+        break;
+
+      sim.now = sim.incoming_end;
+      complete_incoming();
+    } else if (event && event->time <= end) {
+      if (event->time > sim.now)
+        sim.now = event->time;
+
+      sim.timeline_next++;
+      handle_timeline_event(event);
+    } else {
+      break;
+    }
+  }
+
+  sim.now = end;
+}
+
+uint32_t wavebird_radio_sim_get_time(void)
+{
+  return sim.now;
+}
+
+int wavebird_radio_sim_get_channel(void)
+{
+  for (int channel = 0; channel < WAVEBIRD_RADIO_CHANNELS; channel++) {
+    if (listening_on(channel))
+      return channel;
+  }
+
+  return -1;
+}
+
+const wavebird_radio_sim_stats_t *wavebird_radio_sim_get_stats(void)
+{
+  return &sim.stats;
+}
+
+RAIL_Handle_t RAIL_Init(RAIL_Config_t *railCfg, RAIL_InitCompleteCallbackPtr_t cb)
+{
+  sim.events_callback = railCfg->eventsCallback;
+  if (RAILCb_SetupRxFifo(&sim) != RAIL_STATUS_NO_ERROR)
+    return NULL;
+
+  if (cb)
+    cb(&sim);
+
+  return &sim;
+}
+
+RAIL_Status_t RAIL_ConfigData(RAIL_Handle_t railHandle, const RAIL_DataConfig_t *dataConfig)
+{
+  // Only packet mode is simulated
+  return dataConfig->rxMethod == PACKET_MODE ? RAIL_STATUS_NO_ERROR : RAIL_STATUS_INVALID_PARAMETER;
+}
+
+uint16_t RAIL_ConfigChannels(RAIL_Handle_t railHandle, const RAIL_ChannelConfig_t *config,
+                             RAIL_RadioConfigChangedCallback_t cb)
+{
+  sim.channels = config;
+  return config->configs[0].channelNumberStart;
+}
+
+RAIL_Status_t RAIL_ConfigCal(RAIL_Handle_t railHandle, RAIL_CalMask_t calEnable)
+{
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_Status_t RAIL_Calibrate(RAIL_Handle_t railHandle, RAIL_CalValues_t *calValues, RAIL_CalMask_t calForce)
+{
+  sim.stats.calibrations++;
+  return sim.calibration_status;
+}
+
+RAIL_Status_t RAIL_ConfigEvents(RAIL_Handle_t railHandle, RAIL_Events_t mask, RAIL_Events_t events)
+{
+  sim.events = (sim.events & ~mask) | (events & mask);
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_Status_t RAIL_SetRxTransitions(RAIL_Handle_t railHandle, const RAIL_StateTransitions_t *transitions)
+{
+  // The radio always stays in RX after a packet
+  return transitions->success == RAIL_RF_STATE_RX && transitions->error == RAIL_RF_STATE_RX
+             ? RAIL_STATUS_NO_ERROR
+             : RAIL_STATUS_INVALID_PARAMETER;
+}
+
+RAIL_Status_t RAIL_StartRx(RAIL_Handle_t railHandle, uint16_t channel, const RAIL_SchedulerInfo_t *schedulerInfo)
+{
+  const RAIL_ChannelConfigEntry_t *entry = sim.channels ? &sim.channels->configs[0] : NULL;
+  if (!entry || channel < entry->channelNumberStart || channel > entry->channelNumberEnd)
+    return RAIL_STATUS_INVALID_PARAMETER;
+
+  // Restarting RX on the same channel doesn't interrupt it
+  if (sim.receiving && sim.rail_channel == channel)
+    return RAIL_STATUS_NO_ERROR;
+
+  abort_incoming();
+  sim.receiving    = true;
+  sim.rail_channel = channel;
+  sim.listen_start = sim.now;
+  sim.stats.channel_changes++;
+
+  return RAIL_STATUS_NO_ERROR;
+}
+
+void RAIL_Idle(RAIL_Handle_t railHandle, RAIL_IdleMode_t mode, bool wait)
+{
+  abort_incoming();
+  sim.receiving = false;
+}
+
+RAIL_Time_t RAIL_GetTime(void)
+{
+  return sim.now;
+}
+
+int16_t RAIL_GetRssi(RAIL_Handle_t railHandle, bool wait)
+{
+  if (!sim.receiving)
+    return RAIL_RSSI_INVALID;
+
+  // Look back to the oldest transmission which could still be on the air, and ahead to those which have started
+  size_t first = sim.timeline_next;
+  while (first > 0 && sim.timeline[first - 1].time + WAVEBIRD_RADIO_SIM_PACKET_US >= sim.now)
+    first--;
+
+  int rssi = WAVEBIRD_RADIO_SIM_NOISE_RSSI;
+  for (size_t i = first; i < sim.timeline_count && sim.timeline[i].time <= sim.now + WAVEBIRD_RADIO_SIM_LEAD_US; i++)
+    rssi = transmission_rssi(&sim.timeline[i], rssi);
+
+  // In quarter dBm
+  return rssi * 4;
+}
+
+// Keep RAIL's own RX FIFO, unless the application overrides this
+__attribute__((weak)) RAIL_Status_t RAILCb_SetupRxFifo(RAIL_Handle_t railHandle)
+{
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_Status_t RAIL_SetRxFifo(RAIL_Handle_t railHandle, uint8_t *addr, uint16_t *size)
+{
+  if (addr == NULL || (uintptr_t)addr % RAIL_FIFO_ALIGNMENT != 0 || *size < MIN_FIFO_BYTES || *size > MAX_FIFO_BYTES)
+    return RAIL_STATUS_INVALID_PARAMETER;
+
+  // The FIFO can only be moved while it's empty
+  if (sim.packet_count > 0)
+    return RAIL_STATUS_INVALID_STATE;
+
+  // Only power-of-two sizes are supported, other sizes are rounded down and the size used is passed back
+  while (*size & (*size - 1))
+    *size &= *size - 1;
+
+  sim.fifo         = addr;
+  sim.fifo_bytes   = *size;
+  sim.write_offset = 0;
+
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_RxPacketHandle_t RAIL_HoldRxPacket(RAIL_Handle_t railHandle)
+{
+  if (!sim.delivering)
+    return RAIL_RX_PACKET_HANDLE_INVALID;
+
+  sim.delivering->held = true;
+  return sim.delivering;
+}
+
+RAIL_RxPacketHandle_t RAIL_GetRxPacketInfo(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle,
+                                           RAIL_RxPacketInfo_t *pPacketInfo)
+{
+  // Find the packet, every packet in the FIFO is complete
+  struct fifo_packet *packet = NULL;
+  for (int i = 0; i < sim.packet_count; i++) {
+    struct fifo_packet *candidate = &sim.packets[(sim.first_packet + i) % MAX_FIFO_PACKETS];
+    if (candidate->released)
+      continue;
+
+    if (packetHandle == RAIL_RX_PACKET_HANDLE_NEWEST || packetHandle == candidate) {
+      packet = candidate;
+    } else if (packetHandle == RAIL_RX_PACKET_HANDLE_OLDEST ||
+               packetHandle == RAIL_RX_PACKET_HANDLE_OLDEST_COMPLETE) {
+      packet = candidate;
+      break;
+    }
+  }
+
+  if (!packet)
+    return RAIL_RX_PACKET_HANDLE_INVALID;
+
+  // Split the packet at the end of the FIFO
+  uint16_t first_bytes = sim.fifo_bytes - packet->offset;
+
+  pPacketInfo->packetStatus      = RAIL_RX_PACKET_READY_SUCCESS;
+  pPacketInfo->packetBytes       = WAVEBIRD_PACKET_BYTES;
+  pPacketInfo->firstPortionData  = &sim.fifo[packet->offset];
+  pPacketInfo->firstPortionBytes = first_bytes < WAVEBIRD_PACKET_BYTES ? first_bytes : WAVEBIRD_PACKET_BYTES;
+  pPacketInfo->lastPortionData   = first_bytes < WAVEBIRD_PACKET_BYTES ? sim.fifo : NULL;
+
+  return packet;
+}
+
+RAIL_Status_t RAIL_GetRxPacketDetailsAlt(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle,
+                                         RAIL_RxPacketDetails_t *pPacketDetails)
+{
+  RAIL_RxPacketInfo_t packet_info;
+  const struct fifo_packet *packet = RAIL_GetRxPacketInfo(railHandle, packetHandle, &packet_info);
+  if (!packet)
+    return RAIL_STATUS_INVALID_PARAMETER;
+
+  // Timestamps are taken at the end of the sync word, until converted
+  *pPacketDetails = (RAIL_RxPacketDetails_t){
+      .timeReceived = {.packetTime = packet->sync_end, .timePosition = RAIL_PACKET_TIME_AT_SYNC_END},
+      .crcPassed    = true,
+      .rssi         = packet->rssi,
+      .channel      = packet->channel,
+  };
+
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_Status_t RAIL_GetRxTimePacketEndAlt(RAIL_Handle_t railHandle, RAIL_RxPacketDetails_t *pPacketDetails)
+{
+  RAIL_PacketTimeStamp_t *time = &pPacketDetails->timeReceived;
+  if (time->timePosition != RAIL_PACKET_TIME_AT_SYNC_END)
+    return RAIL_STATUS_INVALID_PARAMETER;
+
+  time->packetTime += WAVEBIRD_RADIO_SIM_PACKET_US;
+  time->timePosition = RAIL_PACKET_TIME_AT_PACKET_END;
+
+  return RAIL_STATUS_NO_ERROR;
+}
+
+RAIL_Status_t RAIL_ReleaseRxPacket(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle)
+{
+  for (int i = 0; i < sim.packet_count; i++) {
+    struct fifo_packet *packet = &sim.packets[(sim.first_packet + i) % MAX_FIFO_PACKETS];
+    if (packet == packetHandle && !packet->released) {
+      packet->released = true;
+      free_released_packets();
+      return RAIL_STATUS_NO_ERROR;
+    }
+  }
+
+  return RAIL_STATUS_INVALID_PARAMETER;
+}
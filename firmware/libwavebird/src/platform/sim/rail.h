@@ -0,0 +1,213 @@
+/**
+ * Simulated subset of the Silicon Labs RAIL API, for host builds.
+ *
+ * Declares just enough of RAIL for radio_efr32.c to build and run on the
+ * host, with the same names and semantics as the Gecko SDK. The radio itself
+ * is simulated by radio_sim.c, see wavebird/radio_sim.h.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef __ALIGNED
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#endif
+
+// Alignment required for RX FIFO buffers
+#define RAIL_FIFO_ALIGNMENT sizeof(uint32_t)
+
+typedef void *RAIL_Handle_t;
+typedef uint32_t RAIL_Time_t;
+typedef uint64_t RAIL_Events_t;
+typedef uint32_t RAIL_CalMask_t;
+typedef uint32_t RAIL_CalValues_t;
+typedef void RAIL_SchedulerInfo_t;
+typedef void (*RAIL_InitCompleteCallbackPtr_t)(RAIL_Handle_t handle);
+typedef void (*RAIL_RadioConfigChangedCallback_t)(RAIL_Handle_t handle, const void *entry);
+
+// Status codes
+typedef enum {
+  RAIL_STATUS_NO_ERROR,
+  RAIL_STATUS_INVALID_PARAMETER,
+  RAIL_STATUS_INVALID_STATE,
+  RAIL_STATUS_INVALID_CALL,
+} RAIL_Status_t;
+
+// Events
+#define RAIL_EVENT_RX_SYNC1_DETECT        (1ULL << 0)
+#define RAIL_EVENT_RX_PACKET_RECEIVED     (1ULL << 1)
+#define RAIL_EVENT_RX_PACKET_ABORTED      (1ULL << 2)
+#define RAIL_EVENT_RX_FRAME_ERROR         (1ULL << 3)
+#define RAIL_EVENT_RX_FIFO_OVERFLOW       (1ULL << 4)
+#define RAIL_EVENT_RX_ADDRESS_FILTERED    (1ULL << 5)
+#define RAIL_EVENT_RX_SCHEDULED_RX_MISSED (1ULL << 6)
+#define RAIL_EVENT_CAL_NEEDED             (1ULL << 7)
+#define RAIL_EVENTS_ALL                   0xFFFFFFFFFFFFFFFFULL
+
+// Every event which ends a packet's reception
+#define RAIL_EVENTS_RX_COMPLETION                                                                                      \
+  (RAIL_EVENT_RX_PACKET_RECEIVED | RAIL_EVENT_RX_PACKET_ABORTED | RAIL_EVENT_RX_FRAME_ERROR |                          \
+   RAIL_EVENT_RX_FIFO_OVERFLOW | RAIL_EVENT_RX_ADDRESS_FILTERED | RAIL_EVENT_RX_SCHEDULED_RX_MISSED)
+
+// Calibrations
+#define RAIL_CAL_ALL         0xFFFFFFFFUL
+#define RAIL_CAL_ALL_PENDING 0x00000000UL
+
+// Radio states
+typedef enum {
+  RAIL_RF_STATE_IDLE,
+  RAIL_RF_STATE_RX,
+  RAIL_RF_STATE_TX,
+} RAIL_RadioState_t;
+
+// Idle modes
+typedef enum {
+  RAIL_IDLE,
+  RAIL_IDLE_ABORT,
+  RAIL_IDLE_FORCE_SHUTDOWN,
+  RAIL_IDLE_FORCE_SHUTDOWN_CLEAR_FLAGS,
+} RAIL_IdleMode_t;
+
+// Data sources and methods
+typedef enum { TX_PACKET_DATA } RAIL_TxDataSource_t;
+typedef enum { RX_PACKET_DATA } RAIL_RxDataSource_t;
+typedef enum { PACKET_MODE, FIFO_MODE } RAIL_DataMethod_t;
+
+typedef struct {
+  RAIL_TxDataSource_t txSource;
+  RAIL_RxDataSource_t rxSource;
+  RAIL_DataMethod_t txMethod;
+  RAIL_DataMethod_t rxMethod;
+} RAIL_DataConfig_t;
+
+typedef struct {
+  void (*eventsCallback)(RAIL_Handle_t handle, RAIL_Events_t events);
+  void *protocol;
+  void *scheduler;
+} RAIL_Config_t;
+
+typedef struct {
+  RAIL_RadioState_t success;
+  RAIL_RadioState_t error;
+} RAIL_StateTransitions_t;
+
+// Channel configuration, one entry per range of channels
+typedef struct {
+  const void *phyConfigDeltaAdd;
+  uint32_t baseFrequency;
+  uint32_t channelSpacing;
+  uint16_t physicalChannelOffset;
+  uint16_t channelNumberStart;
+  uint16_t channelNumberEnd;
+} RAIL_ChannelConfigEntry_t;
+
+typedef struct {
+  const uint32_t *phyConfigBase;
+  const uint32_t *phyConfigDeltaSubtract;
+  const RAIL_ChannelConfigEntry_t *configs;
+  uint32_t length;
+  uint32_t signature;
+} RAIL_ChannelConfig_t;
+
+// Returned by RAIL_GetRssi() when the radio isn't receiving
+#define RAIL_RSSI_INVALID ((int16_t)(-128 * 4))
+
+// Received packets
+typedef void *RAIL_RxPacketHandle_t;
+
+#define RAIL_RX_PACKET_HANDLE_INVALID         ((RAIL_RxPacketHandle_t)NULL)
+#define RAIL_RX_PACKET_HANDLE_OLDEST          ((RAIL_RxPacketHandle_t)1)
+#define RAIL_RX_PACKET_HANDLE_NEWEST          ((RAIL_RxPacketHandle_t)2)
+#define RAIL_RX_PACKET_HANDLE_OLDEST_COMPLETE ((RAIL_RxPacketHandle_t)3)
+
+typedef enum {
+  RAIL_RX_PACKET_NONE,
+  RAIL_RX_PACKET_ABORT_FORMAT,
+  RAIL_RX_PACKET_ABORT_FILTERED,
+  RAIL_RX_PACKET_ABORT_ABORTED,
+  RAIL_RX_PACKET_ABORT_OVERFLOW,
+  RAIL_RX_PACKET_ABORT_CRC_ERROR,
+  RAIL_RX_PACKET_READY_CRC_ERROR,
+  RAIL_RX_PACKET_READY_SUCCESS,
+  RAIL_RX_PACKET_RECEIVING,
+} RAIL_RxPacketStatus_t;
+
+// Where a packet is in the RX FIFO, split in two portions if it wraps around the end
+typedef struct {
+  RAIL_RxPacketStatus_t packetStatus;
+  uint16_t packetBytes;
+  uint16_t firstPortionBytes;
+  uint8_t *firstPortionData;
+  uint8_t *lastPortionData;
+} RAIL_RxPacketInfo_t;
+
+// Where in a packet a timestamp is taken
+typedef enum {
+  RAIL_PACKET_TIME_INVALID,
+  RAIL_PACKET_TIME_DEFAULT,
+  RAIL_PACKET_TIME_AT_PREAMBLE_START,
+  RAIL_PACKET_TIME_AT_PREAMBLE_START_USED_TOTAL,
+  RAIL_PACKET_TIME_AT_SYNC_END,
+  RAIL_PACKET_TIME_AT_SYNC_END_USED_TOTAL,
+  RAIL_PACKET_TIME_AT_PACKET_END,
+  RAIL_PACKET_TIME_AT_PACKET_END_USED_TOTAL,
+} RAIL_PacketTimePosition_t;
+
+typedef struct {
+  RAIL_Time_t packetTime;
+  uint16_t totalPacketBytes;
+  RAIL_PacketTimePosition_t timePosition;
+  uint32_t packetDurationUs;
+} RAIL_PacketTimeStamp_t;
+
+// Details of a received packet
+typedef struct {
+  RAIL_PacketTimeStamp_t timeReceived;
+  bool crcPassed;
+  bool isAck;
+  int8_t rssi;
+  uint8_t lqi;
+  uint8_t syncWordId;
+  uint8_t subPhyId;
+  uint8_t antennaId;
+  uint8_t channelHoppingChannelIndex;
+  uint16_t channel;
+} RAIL_RxPacketDetails_t;
+
+RAIL_Handle_t RAIL_Init(RAIL_Config_t *railCfg, RAIL_InitCompleteCallbackPtr_t cb);
+RAIL_Status_t RAIL_ConfigData(RAIL_Handle_t railHandle, const RAIL_DataConfig_t *dataConfig);
+uint16_t RAIL_ConfigChannels(RAIL_Handle_t railHandle, const RAIL_ChannelConfig_t *config,
+                             RAIL_RadioConfigChangedCallback_t cb);
+RAIL_Status_t RAIL_ConfigCal(RAIL_Handle_t railHandle, RAIL_CalMask_t calEnable);
+RAIL_Status_t RAIL_Calibrate(RAIL_Handle_t railHandle, RAIL_CalValues_t *calValues, RAIL_CalMask_t calForce);
+RAIL_Status_t RAIL_ConfigEvents(RAIL_Handle_t railHandle, RAIL_Events_t mask, RAIL_Events_t events);
+RAIL_Status_t RAIL_SetRxTransitions(RAIL_Handle_t railHandle, const RAIL_StateTransitions_t *transitions);
+RAIL_Status_t RAIL_StartRx(RAIL_Handle_t railHandle, uint16_t channel, const RAIL_SchedulerInfo_t *schedulerInfo);
+void RAIL_Idle(RAIL_Handle_t railHandle, RAIL_IdleMode_t mode, bool wait);
+RAIL_Time_t RAIL_GetTime(void);
+int16_t RAIL_GetRssi(RAIL_Handle_t railHandle, bool wait);
+RAIL_Status_t RAIL_SetRxFifo(RAIL_Handle_t railHandle, uint8_t *addr, uint16_t *size);
+RAIL_RxPacketHandle_t RAIL_HoldRxPacket(RAIL_Handle_t railHandle);
+RAIL_RxPacketHandle_t RAIL_GetRxPacketInfo(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle,
+                                           RAIL_RxPacketInfo_t *pPacketInfo);
+RAIL_Status_t RAIL_GetRxPacketDetailsAlt(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle,
+                                         RAIL_RxPacketDetails_t *pPacketDetails);
+RAIL_Status_t RAIL_GetRxTimePacketEndAlt(RAIL_Handle_t railHandle, RAIL_RxPacketDetails_t *pPacketDetails);
+RAIL_Status_t RAIL_ReleaseRxPacket(RAIL_Handle_t railHandle, RAIL_RxPacketHandle_t packetHandle);
+
+// Called by RAIL_Init() for the application to set up its own RX FIFO with RAIL_SetRxFifo()
+RAIL_Status_t RAILCb_SetupRxFifo(RAIL_Handle_t railHandle);
+
+// Copy a packet out of the RX FIFO, joining the portions either side of the wrap around
+static inline void RAIL_CopyRxPacket(uint8_t *pDest, const RAIL_RxPacketInfo_t *pPacketInfo)
+{
+  memcpy(pDest, pPacketInfo->firstPortionData, pPacketInfo->firstPortionBytes);
+  if (pPacketInfo->lastPortionData != NULL) {
+    memcpy(pDest + pPacketInfo->firstPortionBytes, pPacketInfo->lastPortionData,
+           pPacketInfo->packetBytes - pPacketInfo->firstPortionBytes);
+  }
+}
@@ -0,0 +1,11 @@
+/**
+ * Simulated radio configuration, in place of the rail_config.h generated from
+ * a .radioconf file.
+ */
+
+#pragma once
+
+#include "rail.h"
+
+// One channel configuration, covering the 32 channel indexes from WAVEBIRD_RADIO_BASE_FREQUENCY
+extern const RAIL_ChannelConfig_t *channelConfigs[];
@@ -0,0 +1,44 @@
+/**
+ * Bit-matrix transposes for converting between 4 bit-sliced words and 4
+ * separate words, as used by WaveBird's nibble interleaving.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Swap the bits selected by mask with the bits delta positions above them
+static inline uint64_t delta_swap(uint64_t x, uint64_t mask, int delta)
+{
+  uint64_t t = ((x >> delta) ^ x) & mask;
+  return x ^ t ^ (t << delta);
+}
+
+// Transpose 16 nibbles into 4 16-bit lanes, so bit N of nibble K ends up in bit K of lane N
+static inline uint64_t transpose_nibbles(uint64_t x)
+{
+  x = delta_swap(x, 0x0A0A0A0A0A0A0A0Aull, 3);
+  x = delta_swap(x, 0x00CC00CC00CC00CCull, 6);
+  x = delta_swap(x, 0x0000F0F00000F0F0ull, 12);
+  x = delta_swap(x, 0x00000000FF00FF00ull, 24);
+
+  return x;
+}
+
+// Transpose 4 16-bit lanes into 16 nibbles, the inverse of transpose_nibbles()
+static inline uint64_t transpose_lanes(uint64_t x)
+{
+  x = delta_swap(x, 0x00000000FF00FF00ull, 24);
+  x = delta_swap(x, 0x0000F0F00000F0F0ull, 12);
+  x = delta_swap(x, 0x00CC00CC00CC00CCull, 6);
+  x = delta_swap(x, 0x0A0A0A0A0A0A0A0Aull, 3);
+
+  return x;
+}
+
+// Pack 16 bits from each of 4 words into the 4 lanes of a 64-bit word, starting at bit shift of each word
+static inline uint64_t pack_lanes(const uint32_t *words, int shift)
+{
+  return (uint64_t)(uint16_t)(words[0] >> shift) | (uint64_t)(uint16_t)(words[1] >> shift) << 16 |
+         (uint64_t)(uint16_t)(words[2] >> shift) << 32 | (uint64_t)(uint16_t)(words[3] >> shift) << 48;
+}
@@ -0,0 +1,116 @@
+/**
+ * Minimal micro-benchmark helpers.
+ *
+ * On the host, benchmarks are timed with the monotonic clock and the CPU
+ * timestamp counter. Define BENCH_CYCLE_COUNTER as an expression reading a
+ * 32-bit cycle counter (e.g. DWT->CYCCNT on the Cortex-M33) and BENCH_CPU_HZ
+ * as the CPU frequency for cycle-accurate mode, where times are derived from
+ * cycle counts instead. Runs must then be shorter than 2^32 cycles.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(BENCH_CYCLE_COUNTER) && !defined(BENCH_CPU_HZ)
+#error "BENCH_CPU_HZ must be defined for cycle-accurate mode"
+#elif !defined(BENCH_CYCLE_COUNTER) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+// Prevent the compiler from optimizing away a computed value
+#define BENCH_KEEP(value) __asm__ volatile("" : : "r"(value) : "memory")
+
+// Result output formats, see bench_set_format()
+enum {
+  BENCH_FORMAT_TEXT,
+  BENCH_FORMAT_CSV,
+  BENCH_FORMAT_JSON,
+};
+
+/**
+ * Benchmark measurement.
+ */
+struct bench {
+  const char *name;
+  uint64_t iterations;
+  uint64_t start_ns;
+  uint64_t start_cycles;
+  uint64_t elapsed_ns;
+  uint64_t elapsed_cycles;
+};
+
+// Monotonic time in nanoseconds, or 0 in cycle-accurate mode
+static inline uint64_t bench_time_ns(void)
+{
+#if defined(BENCH_CYCLE_COUNTER)
+  return 0;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// CPU cycle (timestamp) counter, or 0 if not available on this host
+static inline uint64_t bench_cycles(void)
+{
+#if defined(BENCH_CYCLE_COUNTER)
+  return (uint32_t)(BENCH_CYCLE_COUNTER);
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static inline void bench_start(struct bench *bench, const char *name, uint64_t iterations)
+{
+  bench->name         = name;
+  bench->iterations   = iterations;
+  bench->start_ns     = bench_time_ns();
+  bench->start_cycles = bench_cycles();
+}
+
+static inline void bench_stop(struct bench *bench)
+{
+#if defined(BENCH_CYCLE_COUNTER)
+  bench->elapsed_cycles = (uint32_t)(bench_cycles() - bench->start_cycles);
+  bench->elapsed_ns     = bench->elapsed_cycles * 1000000000ull / BENCH_CPU_HZ;
+#else
+  bench->elapsed_cycles = bench_cycles() - bench->start_cycles;
+  bench->elapsed_ns     = bench_time_ns() - bench->start_ns;
+#endif
+}
+
+/**
+ * Set the format bench_report() prints results in.
+ *
+ * Call before the first benchmark, CSV and JSON output start with a header.
+ *
+ * @param format the output format, see BENCH_FORMAT_*
+ */
+void bench_set_format(int format);
+
+/**
+ * Print the results of a benchmark run.
+ *
+ * @param bench the completed benchmark
+ */
+void bench_report(const struct bench *bench);
+
+/**
+ * Finish the results, closing the JSON array if needed.
+ */
+void bench_finish(void);
+
+/**
+ * Print supplementary output, such as configuration or decode rate tables.
+ *
+ * Printed to stdout in text mode, and to stderr otherwise so machine-readable
+ * results stay parseable.
+ *
+ * @param format printf format string
+ */
+void bench_log(const char *format, ...) __attribute__((format(printf, 1, 2)));
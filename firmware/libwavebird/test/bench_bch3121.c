@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "wavebird/bch3121.h"
+
+#include "bench.h"
+#include "reference.h"
+
+#define SAMPLE_COUNT 4096
+#define ROUNDS       1000
+
+static uint32_t messages[SAMPLE_COUNT];
+static uint32_t codewords[SAMPLE_COUNT];
+static uint32_t corrupted[SAMPLE_COUNT];
+static uint32_t single_error[SAMPLE_COUNT];
+static uint32_t uncorrectable[SAMPLE_COUNT];
+
+// The same samples, bit-sliced in groups of 4 for the parallel decoder
+static uint32_t codewords_x4[SAMPLE_COUNT];
+static uint32_t corrupted_x4[SAMPLE_COUNT];
+
+static void generate_samples()
+{
+  uint32_t seed = 0x57500001;
+
+  for (int i = 0; i < SAMPLE_COUNT; i++) {
+    messages[i]  = reference_random_u32(&seed) & ((1 << BCH3121_MESSAGE_LEN) - 1);
+    codewords[i] = reference_bch3121_encode(messages[i]);
+
+    // Two bit errors per codeword, the worst correctable case
+    int first    = reference_random_u32(&seed) % BCH3121_CODEWORD_LEN;
+    int second   = (first + 1 + reference_random_u32(&seed) % (BCH3121_CODEWORD_LEN - 1)) % BCH3121_CODEWORD_LEN;
+    corrupted[i] = codewords[i] ^ (1 << first) ^ (1 << second);
+
+    // One bit error, the common case on a good link
+    single_error[i] = codewords[i] ^ (1 << first);
+
+    // Three bit errors, more than can be corrected (some will be miscorrected, as on a real link)
+    int third;
+    do {
+      third = reference_random_u32(&seed) % BCH3121_CODEWORD_LEN;
+    } while (third == first || third == second);
+    uncorrectable[i] = corrupted[i] ^ (1 << third);
+  }
+
+  for (int i = 0; i < SAMPLE_COUNT; i += 4) {
+    reference_interleave_x4(&codewords_x4[i], &codewords[i]);
+    reference_interleave_x4(&corrupted_x4[i], &corrupted[i]);
+  }
+}
+
+static void bench_encode()
+{
+  struct bench bench;
+
+  bench_start(&bench, "bch3121_encode (reference)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(reference_bch3121_encode(messages[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_encode", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_encode(messages[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode()
+{
+  struct bench bench;
+  uint32_t message;
+
+  bench_start(&bench, "bch3121_decode (reference)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(reference_bch3121_decode(&message, codewords[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_decode(&message, codewords[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_and_correct()
+{
+  struct bench bench;
+  uint32_t message;
+
+  bench_start(&bench, "bch3121_decode_and_correct (0 errors)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_decode_and_correct(&message, codewords[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode_and_correct (1 error)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_decode_and_correct(&message, single_error[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode_and_correct (2 errors)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_decode_and_correct(&message, corrupted[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode_and_correct (3 errors)", SAMPLE_COUNT * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i++)
+      BENCH_KEEP(bch3121_decode_and_correct(&message, uncorrectable[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_x4()
+{
+  struct bench bench;
+  uint32_t messages[4];
+
+  bench_start(&bench, "4x bch3121_decode_and_correct (0 errors)", SAMPLE_COUNT / 4 * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i += 4) {
+      for (int lane = 0; lane < 4; lane++)
+        BENCH_KEEP(bch3121_decode_and_correct(&messages[lane], codewords[i + lane]));
+    }
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode_and_correct_x4 (0 errors)", SAMPLE_COUNT / 4 * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i += 4)
+      BENCH_KEEP(bch3121_decode_and_correct_x4(messages, &codewords_x4[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "4x bch3121_decode_and_correct (2 errors)", SAMPLE_COUNT / 4 * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i += 4) {
+      for (int lane = 0; lane < 4; lane++)
+        BENCH_KEEP(bch3121_decode_and_correct(&messages[lane], corrupted[i + lane]));
+    }
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "bch3121_decode_and_correct_x4 (2 errors)", SAMPLE_COUNT / 4 * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLE_COUNT; i += 4)
+      BENCH_KEEP(bch3121_decode_and_correct_x4(messages, &corrupted_x4[i]));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+void bench_bch3121(void)
+{
+  generate_samples();
+
+#if WAVEBIRD_BCH3121_ALGEBRAIC
+  bench_log("BCH(31,21) error location: algebraic (Berlekamp-Massey + Chien search)\n");
+#else
+  bench_log("BCH(31,21) error location: syndrome table\n");
+#endif
+
+  bench_encode();
+  bench_decode();
+  bench_decode_and_correct();
+  bench_decode_x4();
+}
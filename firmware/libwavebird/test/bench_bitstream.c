@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wavebird/bitstream.h"
+
+#include "bench.h"
+#include "fixtures.h"
+#include "reference.h"
+
+#define STREAM_BYTES (1 << 20)
+#define FRAME_PERIOD 48 // Bytes between the start of each frame, 4ms at 96kbit/s
+#define ROUNDS       20
+
+static uint8_t stream[STREAM_BYTES];
+
+// Write a byte into the stream at any bit offset
+static void write_byte(size_t bit, uint8_t value)
+{
+  size_t i  = bit / 8;
+  int shift = bit % 8;
+
+  stream[i] = (stream[i] & ~(0xFF >> shift)) | value >> shift;
+  if (shift)
+    stream[i + 1] = (stream[i + 1] & (0xFF >> shift)) | (uint8_t)(value << (8 - shift));
+}
+
+// Fill the stream with a frame every 4ms, at drifting bit offsets, with noise in between
+static int generate_stream()
+{
+  uint32_t seed = 0x57500012;
+  for (size_t i = 0; i < STREAM_BYTES; i++)
+    stream[i] = reference_random_u32(&seed);
+
+  static const uint8_t preamble[] = {0xFA, 0xAA, 0xAA, 0xAA, 0x12, 0x34};
+
+  int frames = 0;
+  for (size_t start = 0; start + FRAME_PERIOD < STREAM_BYTES; start += FRAME_PERIOD, frames++) {
+    size_t bit = start * 8 + frames % 8;
+    for (size_t i = 0; i < sizeof(preamble); i++, bit += 8)
+      write_byte(bit, preamble[i]);
+    for (size_t i = 0; i < WAVEBIRD_PACKET_BYTES; i++, bit += 8)
+      write_byte(bit, packet_input_state_resting[i]);
+  }
+
+  return frames;
+}
+
+static void count_packet(const uint8_t *packet, void *context)
+{
+  (*(int *)context)++;
+}
+
+static void bench_bitstream_push(uint8_t max_sync_errors, int frames)
+{
+  struct bench bench;
+  char name[64];
+  snprintf(name, sizeof(name), "wavebird_bitstream_push (%u sync errors)", max_sync_errors);
+
+  int packets = 0;
+  wavebird_bitstream_t bitstream;
+  wavebird_bitstream_init(&bitstream, max_sync_errors, count_packet, &packets);
+
+  bench_start(&bench, name, (uint64_t)STREAM_BYTES * ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    wavebird_bitstream_push(&bitstream, stream, STREAM_BYTES);
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_log("%-40s %12.1f Mbit/s, %d of %d packets found\n", "",
+            8000.0 * STREAM_BYTES * ROUNDS / bench.elapsed_ns, packets / ROUNDS, frames);
+}
+
+void bench_bitstream(void)
+{
+  int frames = generate_stream();
+
+  bench_bitstream_push(0, frames);
+  bench_bitstream_push(2, frames);
+}
@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wavebird/bitstream.h"
+#include "wavebird/despread.h"
+
+#include "bench.h"
+#include "channel.h"
+#include "fixtures.h"
+
+#define CHIP_RATE     1440000
+#define PERIOD_CHIPS  (CHIP_RATE / 250) // Chips between the start of each frame, 4ms
+#define FRAMES        250               // One second of traffic
+#define FRAME_BITS    200
+#define MAX_SAMPLES   (FRAMES * PERIOD_CHIPS * WAVEBIRD_DESPREADER_MAX_OVERSAMPLE)
+#define PUSH_SAMPLES  4096
+
+static int8_t samples[MAX_SAMPLES];
+static uint8_t bits[WAVEBIRD_DESPREADER_MAX_BITS(PUSH_SAMPLES)];
+static uint8_t confidence[WAVEBIRD_DESPREADER_MAX_BITS(PUSH_SAMPLES)];
+
+// Fill the stream with a noisy frame every 4ms, spread from an encoded packet, with noise in between
+static size_t generate_samples(int samples_per_chip)
+{
+  static const uint8_t header[] = {0xFA, 0xAA, 0xAA, 0xAA, 0x12, 0x34};
+  uint8_t frame[FRAME_BITS / 8];
+  memcpy(frame, header, sizeof(header));
+  wavebird_packet_encode(frame + sizeof(header), message_input_state_resting);
+
+  struct channel channel = {.seed = 0x57500020, .noise = 0.6f};
+  size_t count           = 0;
+  for (int f = 0; f < FRAMES; f++) {
+    count += channel_spread(&channel, samples + count, frame, FRAME_BITS, samples_per_chip);
+
+    size_t gap = (PERIOD_CHIPS - FRAME_BITS * WAVEBIRD_DSSS_CHIPS) * samples_per_chip;
+    for (size_t i = 0; i < gap; i++)
+      samples[count++] = channel_sample(&channel, 0.0f);
+  }
+
+  return count;
+}
+
+static void count_packet(const uint8_t *packet, void *context)
+{
+  (*(int *)context)++;
+}
+
+static void bench_despreader_push(int samples_per_chip)
+{
+  struct bench bench;
+  char name[64];
+  snprintf(name, sizeof(name), "wavebird_despreader_push (%d samples/chip)", samples_per_chip);
+
+  size_t count = generate_samples(samples_per_chip);
+
+  wavebird_despreader_t despreader;
+  wavebird_despreader_init(&despreader, samples_per_chip);
+
+  // Time despreading on its own
+  bench_start(&bench, name, count);
+  for (size_t i = 0; i < count; i += PUSH_SAMPLES) {
+    size_t chunk = count - i < PUSH_SAMPLES ? count - i : PUSH_SAMPLES;
+    BENCH_KEEP(wavebird_despreader_push(&despreader, bits, confidence, samples + i, chunk));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  // Despread the stream again, untimed, and check the bits it produced
+  int packets = 0;
+  wavebird_bitstream_t bitstream;
+  wavebird_bitstream_init(&bitstream, 0, count_packet, &packets);
+  wavebird_despreader_init(&despreader, samples_per_chip);
+
+  size_t produced = 0;
+  uint8_t byte    = 0;
+  for (size_t i = 0; i < count; i += PUSH_SAMPLES) {
+    size_t chunk = count - i < PUSH_SAMPLES ? count - i : PUSH_SAMPLES;
+    size_t n     = wavebird_despreader_push(&despreader, bits, confidence, samples + i, chunk);
+
+    for (size_t b = 0; b < n; b++) {
+      byte = byte << 1 | bits[b];
+      if (++produced % 8 == 0)
+        wavebird_bitstream_push(&bitstream, &byte, 1);
+    }
+  }
+
+  bench_log("%-40s %12.1fx real time, %d of %d packets found\n", "", 1e9 / bench.elapsed_ns, packets, FRAMES);
+}
+
+void bench_despread(void)
+{
+  bench_despreader_push(1);
+  bench_despreader_push(4);
+}
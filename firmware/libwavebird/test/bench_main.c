@@ -0,0 +1,93 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+extern void bench_bch3121();
+extern void bench_bitstream();
+extern void bench_despread();
+extern void bench_packet();
+extern void bench_radio();
+
+static int output_format = BENCH_FORMAT_TEXT;
+static bool first_result = true;
+
+void bench_set_format(int format)
+{
+  output_format = format;
+
+  if (format == BENCH_FORMAT_CSV)
+    printf("name,iterations,ns_per_op,ops_per_sec,cycles_per_op\n");
+  else if (format == BENCH_FORMAT_JSON)
+    printf("[");
+}
+
+void bench_report(const struct bench *bench)
+{
+  double ns_per_op     = (double)bench->elapsed_ns / bench->iterations;
+  double cycles_per_op = (double)bench->elapsed_cycles / bench->iterations;
+  double ops_per_sec   = bench->elapsed_ns ? bench->iterations * 1e9 / bench->elapsed_ns : 0;
+
+  switch (output_format) {
+    case BENCH_FORMAT_CSV:
+      printf("\"%s\",%llu,%.3f,%.0f,%.3f\n", bench->name, (unsigned long long)bench->iterations, ns_per_op, ops_per_sec,
+             cycles_per_op);
+      break;
+
+    case BENCH_FORMAT_JSON:
+      printf("%s\n  {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, "
+             "\"cycles_per_op\": %.3f}",
+             first_result ? "" : ",", bench->name, (unsigned long long)bench->iterations, ns_per_op, ops_per_sec,
+             cycles_per_op);
+      break;
+
+    default:
+      printf("%-40s %12llu ops %10.2f ns/op %10.2f Mops/s %10.2f cycles/op\n", bench->name,
+             (unsigned long long)bench->iterations, ns_per_op, ops_per_sec * 1e-6, cycles_per_op);
+      break;
+  }
+
+  first_result = false;
+}
+
+void bench_finish(void)
+{
+  if (output_format == BENCH_FORMAT_JSON)
+    printf("\n]\n");
+}
+
+void bench_log(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  vfprintf(output_format == BENCH_FORMAT_TEXT ? stdout : stderr, format, args);
+  va_end(args);
+}
+
+int main(int argc, char **argv)
+{
+  // Select the output format, "--format text|csv|json"
+  int format = BENCH_FORMAT_TEXT;
+  if (argc == 3 && strcmp(argv[1], "--format") == 0 && strcmp(argv[2], "csv") == 0) {
+    format = BENCH_FORMAT_CSV;
+  } else if (argc == 3 && strcmp(argv[1], "--format") == 0 && strcmp(argv[2], "json") == 0) {
+    format = BENCH_FORMAT_JSON;
+  } else if (argc != 1 && !(argc == 3 && strcmp(argv[1], "--format") == 0 && strcmp(argv[2], "text") == 0)) {
+    fprintf(stderr, "Usage: %s [--format text|csv|json]\n", argv[0]);
+    return 1;
+  }
+
+  bench_set_format(format);
+
+  bench_bch3121();
+  bench_bitstream();
+  bench_despread();
+  bench_packet();
+  bench_radio();
+
+  bench_finish();
+
+  return 0;
+}
@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "wavebird/message.h"
+#include "wavebird/packet.h"
+#include "wavebird/packet_cache.h"
+
+#include "bench.h"
+#include "channel.h"
+#include "fixtures.h"
+#include "reference.h"
+
+#define ROUNDS 100000
+
+static void bench_crc_ccitt()
+{
+  struct bench bench;
+  static uint8_t data[1024];
+
+  uint32_t seed = 0x5750000C;
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = reference_random_u32(&seed);
+
+#if WAVEBIRD_CRC_CCITT_BITWISE
+  bench_log("CRC-CCITT implementation: bitwise\n");
+#elif WAVEBIRD_CRC_CCITT_NIBBLE
+  bench_log("CRC-CCITT implementation: nibble table\n");
+#elif WAVEBIRD_CRC_CCITT_SLICE4
+  bench_log("CRC-CCITT implementation: slicing-by-4\n");
+#else
+  bench_log("CRC-CCITT implementation: byte table\n");
+#endif
+
+#if WAVEBIRD_PACKET_CRC_TABLE
+  bench_log("Packet CRC: message table\n");
+#else
+  bench_log("Packet CRC: CRC-CCITT implementation\n");
+#endif
+
+  // A packet's CRC covers the 11-byte message
+  bench_start(&bench, "crc_ccitt (reference, 11 bytes)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(reference_crc_ccitt(&data[r % 16], WAVEBIRD_MESSAGE_BYTES));
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_crc_ccitt (11 bytes)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_crc_ccitt(&data[r % 16], WAVEBIRD_MESSAGE_BYTES));
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_crc_ccitt (1KB)", ROUNDS / 100);
+  for (int r = 0; r < ROUNDS / 100; r++)
+    BENCH_KEEP(wavebird_packet_crc_ccitt(data, sizeof(data)));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_interleave()
+{
+  struct bench bench;
+  uint32_t codewords[4] = {0};
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+
+  bench_start(&bench, "wavebird_packet_deinterleave (reference)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    reference_packet_deinterleave(codewords, packet);
+    BENCH_KEEP(codewords);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_deinterleave", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    wavebird_packet_deinterleave(codewords, packet);
+    BENCH_KEEP(codewords);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_interleave (reference)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    reference_packet_interleave(packet, codewords);
+    BENCH_KEEP(packet);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_interleave", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    wavebird_packet_interleave(packet, codewords);
+    BENCH_KEEP(packet);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_pack_message()
+{
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t crc_state[WAVEBIRD_MESSAGE_BYTES];
+  uint32_t decoded[4] = {0x000AB1, 0x100088, 0x1F8882, 0x001A14};
+
+  // The library's packing is internal to decoding and encoding, see wavebird_packet_decode/encode for its cost
+  bench_start(&bench, "message packing (reference)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    reference_packet_pack_message(message, crc_state, decoded);
+    BENCH_KEEP(message);
+    BENCH_KEEP(crc_state);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_encode()
+{
+  struct bench bench;
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+
+  bench_start(&bench, "wavebird_packet_encode", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    wavebird_packet_encode(packet, message_input_state_resting);
+    BENCH_KEEP(packet);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  // A custom CRC function can't use the message CRC table, and needs the transposed CRC state
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_crc_fn(&decoder, reference_crc_ccitt);
+
+  bench_start(&bench, "wavebird_decoder_encode (custom CRC)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    wavebird_decoder_encode(&decoder, packet, message_input_state_resting);
+    BENCH_KEEP(packet);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode()
+{
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+
+  bench_start(&bench, "wavebird_packet_decode", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_decode(message, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_ex()
+{
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  wavebird_decode_result_t result;
+
+  bench_start(&bench, "wavebird_packet_decode_ex", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_decode_ex(message, &result, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_header()
+{
+  struct bench bench;
+  uint16_t header, buttons;
+
+  bench_start(&bench, "wavebird_packet_decode_header", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_decode_header(&header, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "wavebird_packet_decode_buttons", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_decode_buttons(&header, &buttons, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_pinned_stream()
+{
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t packets[4][WAVEBIRD_PACKET_BYTES];
+
+  // Packets from 4 controllers on the same channel, only the first one is pinned
+  for (int i = 0; i < 4; i++) {
+    memcpy(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES);
+    message[2] ^= i << 4;
+    wavebird_packet_encode(packets[i], message);
+  }
+
+  uint16_t pinned_id = wavebird_message_get_controller_id(message_input_state_resting);
+
+  bench_start(&bench, "pinned stream, 4 IDs (full decode)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    const uint8_t *packet = packets[r % 4];
+    if (wavebird_packet_decode(message, packet) == 0)
+      BENCH_KEEP(wavebird_message_get_controller_id(message) == pinned_id);
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  bench_start(&bench, "pinned stream, 4 IDs (header first)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++) {
+    const uint8_t *packet = packets[r % 4];
+    uint16_t header;
+    if (wavebird_packet_decode_header(&header, packet) == 0 && (header & WB_MESSAGE_HEADER_CONTROLLER_ID) != pinned_id)
+      continue;
+
+    BENCH_KEEP(wavebird_packet_decode(message, packet));
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_gc_state()
+{
+  struct bench bench;
+  wavebird_gc_state_t state;
+
+  bench_start(&bench, "wavebird_packet_decode_gc_state", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_decode_gc_state(&state, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_packet_cache()
+{
+  struct bench bench;
+  wavebird_packet_cache_t cache;
+  wavebird_gc_state_t state;
+
+  wavebird_packet_cache_init(&cache);
+  wavebird_packet_decode_gc_state(&state, packet_origin);
+  wavebird_packet_cache_store(&cache, packet_origin, &state);
+  wavebird_packet_decode_gc_state(&state, packet_input_state_resting);
+  wavebird_packet_cache_store(&cache, packet_input_state_resting, &state);
+
+  bench_start(&bench, "wavebird_packet_cache_lookup (hit)", ROUNDS);
+  for (int r = 0; r < ROUNDS; r++)
+    BENCH_KEEP(wavebird_packet_cache_lookup(&cache, &state, packet_input_state_resting));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_soft()
+{
+  struct channel channel = {.seed = 0x57500004, .noise = 0.55f};
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+
+  // Find a packet which only soft-decision decoding can recover
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+  do {
+    channel_transmit(&channel, packet, reliability, packet_input_state_resting);
+  } while (wavebird_packet_decode(message, packet) == 0 ||
+           wavebird_packet_decode_soft(message, packet, reliability) != 0);
+
+  bench_start(&bench, "wavebird_packet_decode_soft (recovered)", ROUNDS / 10);
+  for (int r = 0; r < ROUNDS / 10; r++)
+    BENCH_KEEP(wavebird_packet_decode_soft(message, packet, reliability));
+  bench_stop(&bench);
+  bench_report(&bench);
+}
+
+static void bench_decode_recovery()
+{
+  struct channel channel = {.seed = 0x57500006, .noise = 0.45f};
+  struct bench bench;
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+
+  // Find a packet which can only be decoded with recovery
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+  wavebird_packet_set_recovery_budget(64);
+  do {
+    channel_transmit(&channel, packet, reliability, packet_input_state_resting);
+  } while (wavebird_packet_decode(message, packet) != WB_PACKET_RESCUED);
+
+  bench_start(&bench, "wavebird_packet_decode (rescued)", ROUNDS / 10);
+  for (int r = 0; r < ROUNDS / 10; r++)
+    BENCH_KEEP(wavebird_packet_decode(message, packet));
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  wavebird_packet_set_recovery_budget(0);
+}
+
+// Report how many packets per thousand CRC-guided recovery rescues, for a few budgets
+static void report_recovery_gain()
+{
+  static const float noise_levels[] = {0.35f, 0.40f, 0.45f, 0.50f};
+  static const uint16_t budgets[]   = {4, 8, 16, 64};
+  const int packets                 = 10000;
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+
+  bench_log("\nCRC-guided recovery, packets per thousand (AWGN + 8-bit bursts):\n");
+  bench_log("%8s %10s %10s %10s %10s %10s %10s\n", "noise", "decoded", "budget 4", "budget 8", "budget 16",
+            "budget 64", "wrong");
+
+  for (size_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+    struct channel channel = {
+        .seed        = 0x57500007,
+        .noise       = noise_levels[n],
+        .burst_rate  = 0.002f,
+        .burst_noise = 1.5f,
+        .burst_bits  = 8,
+    };
+
+    int decoded = 0, wrong = 0;
+    int rescued[sizeof(budgets) / sizeof(budgets[0])] = {0};
+    for (int i = 0; i < packets; i++) {
+      channel_transmit(&channel, packet, reliability, packet_input_state_resting);
+
+      for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+        wavebird_packet_set_recovery_budget(budgets[b]);
+
+        int rc = wavebird_packet_decode(message, packet);
+        if (rc < 0)
+          continue;
+
+        if (memcmp(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES) != 0) {
+          wrong++;
+        } else if (rc == WB_PACKET_RESCUED) {
+          rescued[b]++;
+        } else if (b == 0) {
+          decoded++;
+        }
+      }
+    }
+
+    bench_log("%8.2f %10.1f %+10.1f %+10.1f %+10.1f %+10.1f %10.1f\n", noise_levels[n],
+              1000.0 * decoded / packets, 1000.0 * rescued[0] / packets, 1000.0 * rescued[1] / packets,
+              1000.0 * rescued[2] / packets, 1000.0 * rescued[3] / packets, 1000.0 * wrong / packets);
+  }
+
+  wavebird_packet_set_recovery_budget(0);
+}
+
+// Report how many packets per thousand each decoder recovers over a noisy channel
+static void report_soft_gain()
+{
+  static const float noise_levels[] = {0.35f, 0.40f, 0.45f, 0.50f, 0.55f, 0.60f};
+  const int packets                 = 10000;
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+
+  bench_log("\nSoft-decision gain, packets recovered per thousand (AWGN + 8-bit bursts):\n");
+  bench_log("%8s %10s %10s %10s %10s %10s\n", "noise", "bit errors", "hard", "soft", "gain", "wrong");
+
+  for (size_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+    struct channel channel = {
+        .seed        = 0x57500005,
+        .noise       = noise_levels[n],
+        .burst_rate  = 0.002f,
+        .burst_noise = 1.5f,
+        .burst_bits  = 8,
+    };
+
+    int bit_errors = 0, hard = 0, soft = 0, wrong = 0;
+    for (int i = 0; i < packets; i++) {
+      bit_errors += channel_transmit(&channel, packet, reliability, packet_input_state_resting);
+
+      if (wavebird_packet_decode(message, packet) == 0 &&
+          memcmp(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES) == 0)
+        hard++;
+
+      if (wavebird_packet_decode_soft(message, packet, reliability) == 0) {
+        if (memcmp(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES) == 0) {
+          soft++;
+        } else {
+          wrong++;
+        }
+      }
+    }
+
+    bench_log("%8.2f %10.2f %10.1f %10.1f %+10.1f %10.1f\n", noise_levels[n], (double)bit_errors / packets,
+              1000.0 * hard / packets, 1000.0 * soft / packets, 1000.0 * (soft - hard) / packets,
+              1000.0 * wrong / packets);
+  }
+}
+
+static void report_history_gain()
+{
+  static const float noise_levels[] = {0.35f, 0.40f, 0.45f, 0.50f};
+  const int packets                 = 10000;
+
+  uint8_t sent[WAVEBIRD_PACKET_BYTES];
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t decoded[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+
+  bench_log("\nHistory-assisted repair, packets per thousand (AWGN + 8-bit bursts, moving C-stick):\n");
+  bench_log("%8s %10s %10s %10s %10s\n", "noise", "decoded", "rescued", "repaired", "wrong");
+
+  for (size_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+    struct channel channel = {
+        .seed        = 0x57500009,
+        .noise       = noise_levels[n],
+        .burst_rate  = 0.002f,
+        .burst_noise = 1.5f,
+        .burst_bits  = 8,
+    };
+
+    wavebird_decoder_t decoder;
+    wavebird_decoder_init(&decoder);
+    wavebird_decoder_set_recovery_budget(&decoder, 8);
+    wavebird_decoder_set_history_repair(&decoder, true);
+
+    uint32_t seed = 0x5750000D;
+    int counts[3] = {0}, wrong = 0;
+    memcpy(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES);
+    for (int i = 0; i < packets; i++) {
+      // Slowly move the C-stick, so some packets change
+      if (reference_random_u32(&seed) % 8 == 0)
+        message[7]++;
+
+      wavebird_packet_encode(sent, message);
+      channel_transmit(&channel, packet, reliability, sent);
+
+      int rc = wavebird_decoder_decode(&decoder, decoded, packet);
+      if (rc < 0)
+        continue;
+
+      if (memcmp(decoded, message, WAVEBIRD_MESSAGE_BYTES) != 0)
+        wrong++;
+      else
+        counts[rc]++;
+    }
+
+    bench_log("%8.2f %10.1f %+10.1f %+10.1f %10.1f\n", noise_levels[n], 1000.0 * counts[0] / packets,
+              1000.0 * counts[WB_PACKET_RESCUED] / packets, 1000.0 * counts[WB_PACKET_REPAIRED] / packets,
+              1000.0 * wrong / packets);
+  }
+}
+
+void bench_packet(void)
+{
+  bench_crc_ccitt();
+  bench_interleave();
+  bench_pack_message();
+  bench_encode();
+  bench_decode();
+  bench_decode_ex();
+  bench_decode_gc_state();
+  bench_decode_header();
+  bench_pinned_stream();
+  bench_packet_cache();
+  bench_decode_soft();
+  bench_decode_recovery();
+  report_soft_gain();
+  report_recovery_gain();
+  report_history_gain();
+}
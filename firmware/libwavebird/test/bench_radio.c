@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wavebird/radio.h"
+#include "wavebird/radio_sim.h"
+
+#include "bench.h"
+#include "reference.h"
+
+#define TRIALS           200
+#define PACKET_PERIOD_US 4000
+#define DURATION_US      5000000 // Longest simulated pairing
+#define POLL_US          250     // Main loop period
+#define MAX_CONTROLLERS  WAVEBIRD_RADIO_CHANNELS
+#define MAX_EVENTS       (MAX_CONTROLLERS * (DURATION_US / PACKET_PERIOD_US))
+
+// Tag in the first byte of packets from the controller being paired
+#define PAIRING_TAG 0xA0
+
+static wavebird_radio_sim_event_t timeline[MAX_EVENTS];
+static bool paired;
+
+static bool qualify_packet(const uint8_t *packet)
+{
+  return packet[0] == PAIRING_TAG;
+}
+
+static void handle_packet(const uint8_t *packet)
+{
+}
+
+static void handle_error(int error)
+{
+}
+
+static void handle_pairing_finished(uint8_t status, uint8_t channel)
+{
+  paired = status == WB_RADIO_PAIRING_SUCCESS;
+}
+
+static int compare_times(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// A controller in the room, on its own channel
+struct controller {
+  uint8_t channel;
+  uint16_t phase;
+  int8_t rssi;
+  uint8_t tag;
+};
+
+// Build a room with the controller being paired and neighbors' controllers, each on a different channel, with the
+// controller being paired either next to the receiver or as far away as the neighbors'
+static size_t build_timeline(uint32_t *seed, int neighbors, bool near, uint8_t *paired_channel)
+{
+  struct controller controllers[MAX_CONTROLLERS];
+  uint8_t channels[WAVEBIRD_RADIO_CHANNELS];
+  for (int i = 0; i < WAVEBIRD_RADIO_CHANNELS; i++)
+    channels[i] = i;
+
+  for (int i = 0; i <= neighbors; i++) {
+    int pick       = i + reference_random_u32(seed) % (WAVEBIRD_RADIO_CHANNELS - i);
+    uint8_t swap   = channels[i];
+    channels[i]    = channels[pick];
+    channels[pick] = swap;
+
+    controllers[i].channel = channels[i];
+    controllers[i].phase   = reference_random_u32(seed) % PACKET_PERIOD_US;
+    controllers[i].rssi    = i == 0 && near ? -35 - reference_random_u32(seed) % 15
+                                            : -55 - reference_random_u32(seed) % 30;
+    controllers[i].tag     = i == 0 ? PAIRING_TAG : 0;
+  }
+  *paired_channel = controllers[0].channel;
+
+  // Sort the controllers by phase, so each period's packets are in time order
+  for (int i = 1; i <= neighbors; i++) {
+    for (int j = i; j > 0 && controllers[j].phase < controllers[j - 1].phase; j--) {
+      struct controller swap = controllers[j];
+      controllers[j]         = controllers[j - 1];
+      controllers[j - 1]     = swap;
+    }
+  }
+
+  size_t count = 0;
+  for (uint32_t period = 0; period < DURATION_US; period += PACKET_PERIOD_US) {
+    for (int i = 0; i <= neighbors; i++) {
+      wavebird_radio_sim_event_t *event = &timeline[count++];
+      event->time                       = period + controllers[i].phase;
+      event->type                       = WB_RADIO_SIM_PACKET;
+      event->channel                    = controllers[i].channel;
+      event->rssi                       = controllers[i].rssi;
+      event->packet[0]                  = controllers[i].tag;
+    }
+  }
+
+  return count;
+}
+
+// Time virtual pairing, with the controller being paired holding the pairing buttons from the start, and the channel
+// last paired to being the right one half of the time
+static void bench_pairing(int neighbors, bool near)
+{
+  struct bench bench;
+  char name[64];
+  snprintf(name, sizeof(name), "virtual pairing (%s, %d neighbors)", near ? "near" : "far", neighbors);
+
+  uint32_t seed = 0x57500023;
+  uint32_t times[TRIALS];
+  int failures = 0;
+
+  bench_start(&bench, name, TRIALS);
+  for (int trial = 0; trial < TRIALS; trial++) {
+    uint8_t channel;
+    size_t count = build_timeline(&seed, neighbors, near, &channel);
+
+    wavebird_radio_sim_reset();
+    wavebird_radio_sim_set_timeline(timeline, count);
+    wavebird_radio_init(handle_packet, handle_error);
+    wavebird_radio_configure_qualification(qualify_packet, 5);
+    wavebird_radio_set_pairing_finished_callback(handle_pairing_finished);
+    wavebird_radio_set_channel(reference_random_u32(&seed) % 2 ? channel
+                                                               : reference_random_u32(&seed) % WAVEBIRD_RADIO_CHANNELS);
+
+    paired = false;
+    wavebird_radio_start_pairing();
+    while (!paired && wavebird_radio_sim_get_time() < DURATION_US) {
+      wavebird_radio_sim_advance(POLL_US);
+      wavebird_radio_process();
+    }
+
+    if (!paired || wavebird_radio_get_channel() != channel)
+      failures++;
+
+    times[trial] = wavebird_radio_sim_get_time();
+  }
+  bench_stop(&bench);
+  bench_report(&bench);
+
+  qsort(times, TRIALS, sizeof(times[0]), compare_times);
+  bench_log("%-40s %12.1f ms median, %.1f ms p99, %d of %d failed\n", "", times[TRIALS / 2] * 1e-3,
+            times[TRIALS * 99 / 100] * 1e-3, failures, TRIALS);
+}
+
+void bench_radio(void)
+{
+  for (int near = 1; near >= 0; near--) {
+    bench_pairing(0, near);
+    bench_pairing(3, near);
+    bench_pairing(7, near);
+    bench_pairing(11, near);
+  }
+}
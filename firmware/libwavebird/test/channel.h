@@ -0,0 +1,126 @@
+/**
+ * Synthetic radio channel model for testing soft-decision decoding.
+ *
+ * Each packet bit is sent as +1/-1, and Gaussian noise is added. Bursts of
+ * stronger noise can be added to model interference from other 2.4GHz traffic.
+ * The receiver makes a hard decision on each bit, and reports the magnitude of
+ * the received value as the bit's reliability.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "wavebird/despread.h"
+#include "wavebird/packet.h"
+
+/**
+ * Channel model configuration and state.
+ */
+struct channel {
+  uint32_t seed;       // PRNG state, must be non-zero
+  float noise;         // Standard deviation of the background noise
+  float burst_rate;    // Probability of a burst starting on each bit
+  float burst_noise;   // Standard deviation of the noise during a burst
+  uint8_t burst_bits;  // Length of each burst
+};
+
+// Uniformly distributed random number in [0, 1)
+static inline float channel_uniform(struct channel *channel)
+{
+  channel->seed ^= channel->seed << 13;
+  channel->seed ^= channel->seed >> 17;
+  channel->seed ^= channel->seed << 5;
+  return (channel->seed >> 8) * (1.0f / (1 << 24));
+}
+
+// Approximately normally distributed random number, with mean 0 and standard deviation 1
+static inline float channel_gaussian(struct channel *channel)
+{
+  float sum = 0;
+  for (int i = 0; i < 12; i++)
+    sum += channel_uniform(channel);
+
+  return sum - 6.0f;
+}
+
+// Received 8-bit sample of a chip at the given level, with noise added, clamped to +/-127
+static inline int8_t channel_sample(struct channel *channel, float level)
+{
+  float sample = level + 48.0f * channel->noise * channel_gaussian(channel);
+  return sample > 127.0f ? 127 : sample < -127.0f ? -127 : (int8_t)sample;
+}
+
+/**
+ * Send a packet over the channel.
+ *
+ * @param channel the channel model
+ * @param received buffer to store the received 19-byte packet
+ * @param reliability buffer to store the reliability of each received bit, WAVEBIRD_PACKET_BITS entries
+ * @param packet the transmitted packet
+ *
+ * @return the number of bit errors introduced
+ */
+static inline int channel_transmit(struct channel *channel, uint8_t *received, uint8_t *reliability,
+                                   const uint8_t *packet)
+{
+  int errors      = 0;
+  int burst_until = -1;
+
+  memset(received, 0, WAVEBIRD_PACKET_BYTES);
+
+  for (int i = 0; i < WAVEBIRD_PACKET_BITS; i++) {
+    // Start a new burst, if we're not already in one
+    if (i > burst_until && channel_uniform(channel) < channel->burst_rate)
+      burst_until = i + channel->burst_bits - 1;
+
+    // Add noise to the transmitted symbol
+    float noise  = i <= burst_until ? channel->burst_noise : channel->noise;
+    int bit      = (packet[i / 8] >> (7 - i % 8)) & 1;
+    float symbol = (bit ? 1.0f : -1.0f) + noise * channel_gaussian(channel);
+
+    // Make a hard decision, and use the distance from the decision boundary as the reliability
+    int decision   = symbol > 0;
+    float distance = symbol > 0 ? symbol * 128.0f : -symbol * 128.0f;
+    reliability[i] = distance > 255.0f ? 255 : (uint8_t)distance;
+
+    if (decision)
+      received[i / 8] |= 1 << (7 - i % 8);
+    if (decision != bit)
+      errors++;
+  }
+
+  return errors;
+}
+
+/**
+ * Spread bits into DSSS chips, and send them over the channel as soft samples.
+ *
+ * Each chip is sent as +48/-48 for samples_per_chip samples, with the channel's
+ * background noise added, scaled to the same amplitude.
+ *
+ * @param channel the channel model
+ * @param samples buffer to store the received samples, bits * WAVEBIRD_DSSS_CHIPS * samples_per_chip entries
+ * @param data the bits to send, MSB first
+ * @param bits number of bits
+ * @param samples_per_chip number of samples per chip
+ *
+ * @return the number of samples stored
+ */
+static inline size_t channel_spread(struct channel *channel, int8_t *samples, const uint8_t *data, size_t bits,
+                                    int samples_per_chip)
+{
+  size_t count = 0;
+
+  for (size_t i = 0; i < bits; i++) {
+    int bit = (data[i / 8] >> (7 - i % 8)) & 1;
+    for (int c = 0; c < WAVEBIRD_DSSS_CHIPS; c++) {
+      int chip = ((WAVEBIRD_DSSS_CODE >> (WAVEBIRD_DSSS_CHIPS - 1 - c)) & 1) ^ !bit;
+      for (int s = 0; s < samples_per_chip; s++)
+        samples[count++] = channel_sample(channel, chip ? 48.0f : -48.0f);
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,162 @@
+/**
+ * Reference implementations used to check optimized code paths against.
+ *
+ * These are the original, straightforward implementations from the library,
+ * kept here so tests and benchmarks can compare against them regardless of
+ * which implementation the library was built with, along with the helpers
+ * they share for generating inputs.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wavebird/bch3121.h"
+#include "wavebird/message.h"
+#include "wavebird/packet.h"
+
+#define REFERENCE_BCH3121_POLYNOMIAL 0b11101101001
+
+// Deterministic xorshift32 PRNG for randomized tests and benchmark inputs
+static inline uint32_t reference_random_u32(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Bit-slice 4 codewords into the layout expected by bch3121_decode_x4
+static inline void reference_interleave_x4(uint32_t *interleaved, const uint32_t *codewords)
+{
+  memset(interleaved, 0, 4 * sizeof(uint32_t));
+
+  for (int bit = 0; bit < BCH3121_CODEWORD_LEN; bit++) {
+    for (int lane = 0; lane < 4; lane++) {
+      int position = bit * 4 + lane;
+      if (codewords[lane] & (1 << bit))
+        interleaved[position / 32] |= 1 << (position % 32);
+    }
+  }
+}
+
+// Bit-serial BCH(31,21) encoder
+static inline uint32_t reference_bch3121_encode(uint32_t message)
+{
+  uint32_t codeword = 0;
+  for (int i = 0; i < BCH3121_MESSAGE_LEN; i++) {
+    codeword <<= 1;
+
+    if (message & 1)
+      codeword ^= REFERENCE_BCH3121_POLYNOMIAL;
+
+    message >>= 1;
+  }
+
+  return codeword;
+}
+
+// Bit-serial BCH(31,21) decoder
+static inline uint32_t reference_bch3121_decode(uint32_t *message, uint32_t codeword)
+{
+  uint32_t syndrome = codeword;
+  *message          = 0;
+
+  for (int i = 0; i < BCH3121_MESSAGE_LEN; i++) {
+    *message <<= 1;
+
+    if (syndrome & 1) {
+      syndrome ^= REFERENCE_BCH3121_POLYNOMIAL;
+      *message |= 1;
+    }
+
+    syndrome >>= 1;
+  }
+
+  return syndrome;
+}
+
+// Get the Nth bit from a big-endian byte array
+static inline uint8_t reference_get_bit(const uint8_t *data, uint8_t length, uint8_t bit)
+{
+  return (data[length - 1 - bit / 8] >> (bit % 8)) & 1;
+}
+
+// Set the Nth bit in a big-endian byte array
+static inline void reference_set_bit(uint8_t *data, uint8_t length, uint8_t bit, uint8_t value)
+{
+  if (value) {
+    data[length - 1 - bit / 8] |= 1 << (bit % 8);
+  } else {
+    data[length - 1 - bit / 8] &= ~(1 << (bit % 8));
+  }
+}
+
+// Bit-by-bit packet deinterleaver
+static inline void reference_packet_deinterleave(uint32_t *codewords, const uint8_t *packet)
+{
+  for (uint8_t i = 0; i < 124; i++) {
+    if (reference_get_bit(packet, WAVEBIRD_PACKET_BYTES, i + 28)) {
+      codewords[i % 4] |= 1 << (i / 4);
+    } else {
+      codewords[i % 4] &= ~(1 << (i / 4));
+    }
+  }
+}
+
+// Bit-by-bit packet interleaver
+static inline void reference_packet_interleave(uint8_t *packet, const uint32_t *codewords)
+{
+  for (uint8_t i = 0; i < 124; i++)
+    reference_set_bit(packet, WAVEBIRD_PACKET_BYTES, i + 28, (codewords[i % 4] >> (i / 4)) & 1);
+}
+
+// Bit-by-bit packing of 4 decoded messages into a message, and the transposed CRC state
+static inline void reference_packet_pack_message(uint8_t *message, uint8_t *crc_state, const uint32_t *decoded)
+{
+  message[0] = 0x00;
+
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < BCH3121_MESSAGE_LEN; j++) {
+      uint8_t bit = (decoded[i] >> j) & 1;
+      reference_set_bit(message, WAVEBIRD_MESSAGE_BYTES, i * BCH3121_MESSAGE_LEN + j, bit);
+      reference_set_bit(crc_state, WAVEBIRD_MESSAGE_BYTES, j * 4 + i, bit);
+    }
+  }
+}
+
+// Bit-at-a-time CRC-CCITT
+static inline uint16_t reference_crc_ccitt(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0x0000;
+
+  while (length--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+
+  return crc;
+}
+
+// Two-stage unpacking of a decoded message into a controller state, as the receiver originally did it
+static inline void reference_message_to_gc_state(wavebird_gc_state_t *state, const uint8_t *message)
+{
+  memset(state, 0, sizeof(*state));
+  state->header = (message[0] & 0x0F) << 12 | message[1] << 4 | message[2] >> 4;
+
+  if (wavebird_message_get_type(message) == WB_MESSAGE_TYPE_INPUT_STATE) {
+    state->buttons[0] = (message[3] & 0x80) >> 7 | (message[2] & 0x0F) << 1;
+    state->buttons[1] = (message[3] & 0x7F);
+    memcpy(state->analog, &message[4], 6);
+  } else {
+    uint8_t origin[] = {
+        wavebird_origin_get_stick_x(message),      wavebird_origin_get_stick_y(message),
+        wavebird_origin_get_substick_x(message),   wavebird_origin_get_substick_y(message),
+        wavebird_origin_get_trigger_left(message), wavebird_origin_get_trigger_right(message),
+    };
+    memcpy(state->analog, origin, 6);
+  }
+}
@@ -1,10 +1,26 @@
+#include <string.h>
+
 #include "unity.h"
 
 #include "wavebird/bch3121.h"
 
+#include "reference.h"
+
 static const uint32_t valid_codeword = 0x0394a9d0;
 static const uint32_t valid_message  = 0x00015620;
 
+// Flip up to max_errors distinct random bits in a codeword
+static uint32_t inject_errors(uint32_t codeword, int max_errors, uint32_t *seed)
+{
+  int num_errors = reference_random_u32(seed) % (max_errors + 1);
+  uint32_t error = 0;
+
+  while (__builtin_popcount(error) < num_errors)
+    error |= 1 << (reference_random_u32(seed) % BCH3121_CODEWORD_LEN);
+
+  return codeword ^ error;
+}
+
 // Test bch3121_decode decodes a valid codeword
 static void test_decode()
 {
@@ -68,6 +84,37 @@ static void test_decode_correct_triple_error()
   TEST_ASSERT_EQUAL(-BCH3121_ERR_UNCORRECTABLE, rcode);
 }
 
+// Test bch3121_decode_and_correct agrees with the generated syndrome table for every possible syndrome
+static void test_decode_correct_every_syndrome()
+{
+  static uint16_t syndrome_table[BCH3121_ORDER];
+  bch3121_generate_syndrome_table(syndrome_table);
+
+  for (uint32_t syndrome = 1; syndrome < BCH3121_ORDER; syndrome++) {
+    // A codeword with all message bits clear decodes to exactly this syndrome
+    uint32_t codeword = syndrome << BCH3121_MESSAGE_LEN;
+    uint16_t pattern  = syndrome_table[syndrome];
+
+    uint32_t decoded_message;
+    int rcode = bch3121_decode_and_correct(&decoded_message, codeword);
+
+    if (!pattern) {
+      TEST_ASSERT_EQUAL(-BCH3121_ERR_UNCORRECTABLE, rcode);
+      continue;
+    }
+
+    uint32_t error = 1 << ((pattern >> 2) & 0x1F);
+    if ((pattern & 0x3) == 2)
+      error |= 1 << ((pattern >> 7) & 0x1F);
+
+    uint32_t expected_message;
+    bch3121_decode(&expected_message, codeword ^ error);
+
+    TEST_ASSERT_EQUAL(pattern & 0x3, rcode);
+    TEST_ASSERT_EQUAL_HEX32(expected_message, decoded_message);
+  }
+}
+
 // Test bch3121_encode encodes a message
 static void test_encode()
 {
@@ -85,6 +132,103 @@ static void test_encode_decode()
   TEST_ASSERT_EQUAL_HEX32(0x12345, message);
 }
 
+// Test bch3121_encode matches the bit-serial reference encoder for every message
+static void test_encode_matches_reference()
+{
+  for (uint32_t message = 0; message < (1 << BCH3121_MESSAGE_LEN); message++) {
+    if (bch3121_encode(message) != reference_bch3121_encode(message))
+      TEST_ASSERT_EQUAL_HEX32(reference_bch3121_encode(message), bch3121_encode(message));
+  }
+}
+
+// Test bch3121_decode matches the bit-serial reference decoder, for valid and corrupted codewords
+static void test_decode_matches_reference()
+{
+  uint32_t seed = 0x57500001;
+
+  for (int i = 0; i < (1 << 20); i++) {
+    uint32_t codeword = reference_random_u32(&seed) & 0x7FFFFFFF;
+
+    uint32_t message, expected_message;
+    uint32_t syndrome          = bch3121_decode(&message, codeword);
+    uint32_t expected_syndrome = reference_bch3121_decode(&expected_message, codeword);
+
+    if (syndrome != expected_syndrome || message != expected_message) {
+      TEST_ASSERT_EQUAL_HEX32(expected_syndrome, syndrome);
+      TEST_ASSERT_EQUAL_HEX32(expected_message, message);
+    }
+  }
+}
+
+// Test bch3121_decode_x4 matches the scalar decoder for messages with 0-2 errors per codeword
+static void test_decode_x4_matches_scalar()
+{
+  uint32_t seed = 0x57500002;
+
+  for (int i = 0; i < 100000; i++) {
+    uint32_t codewords[4], interleaved[4];
+    for (int lane = 0; lane < 4; lane++) {
+      uint32_t message = reference_random_u32(&seed) & ((1 << BCH3121_MESSAGE_LEN) - 1);
+      codewords[lane]  = inject_errors(bch3121_encode(message), 2, &seed);
+    }
+    reference_interleave_x4(interleaved, codewords);
+
+    uint32_t messages[4], syndromes[4];
+    uint8_t error_lanes = bch3121_decode_x4(messages, syndromes, interleaved);
+
+    for (int lane = 0; lane < 4; lane++) {
+      uint32_t expected_message;
+      uint32_t expected_syndrome = bch3121_decode(&expected_message, codewords[lane]);
+
+      TEST_ASSERT_EQUAL_HEX32(expected_syndrome, syndromes[lane]);
+      TEST_ASSERT_EQUAL_HEX32(expected_message, messages[lane]);
+      TEST_ASSERT_EQUAL(expected_syndrome != 0, (error_lanes >> lane) & 1);
+    }
+  }
+}
+
+// Test bch3121_decode_and_correct_x4 matches the scalar decoder for messages with 0-2 errors per codeword
+static void test_decode_and_correct_x4_matches_scalar()
+{
+  uint32_t seed = 0x57500003;
+
+  for (int i = 0; i < 100000; i++) {
+    uint32_t codewords[4], interleaved[4];
+    for (int lane = 0; lane < 4; lane++) {
+      uint32_t message = reference_random_u32(&seed) & ((1 << BCH3121_MESSAGE_LEN) - 1);
+      codewords[lane]  = inject_errors(bch3121_encode(message), 2, &seed);
+    }
+    reference_interleave_x4(interleaved, codewords);
+
+    uint32_t messages[4];
+    int errors_corrected = bch3121_decode_and_correct_x4(messages, interleaved);
+
+    int expected_errors = 0;
+    for (int lane = 0; lane < 4; lane++) {
+      uint32_t expected_message;
+      expected_errors += bch3121_decode_and_correct(&expected_message, codewords[lane]);
+
+      TEST_ASSERT_EQUAL_HEX32(expected_message, messages[lane]);
+    }
+    TEST_ASSERT_EQUAL(expected_errors, errors_corrected);
+  }
+}
+
+// Test bch3121_decode_and_correct_x4 fails if any codeword has a triple-bit error
+static void test_decode_and_correct_x4_triple_error()
+{
+  uint32_t messages[4], interleaved[4];
+
+  for (int lane = 0; lane < 4; lane++) {
+    uint32_t codewords[4] = {valid_codeword, valid_codeword, valid_codeword, valid_codeword};
+    codewords[lane] ^= 0x7;
+    reference_interleave_x4(interleaved, codewords);
+
+    int rcode = bch3121_decode_and_correct_x4(messages, interleaved);
+    TEST_ASSERT_EQUAL(-BCH3121_ERR_UNCORRECTABLE, rcode);
+  }
+}
+
 void test_bch3121(void)
 {
   Unity.TestFile = __FILE_NAME__;
@@ -94,6 +238,12 @@ void test_bch3121(void)
   RUN_TEST(test_decode_correct_single_error);
   RUN_TEST(test_decode_correct_double_error);
   RUN_TEST(test_decode_correct_triple_error);
+  RUN_TEST(test_decode_correct_every_syndrome);
   RUN_TEST(test_encode);
   RUN_TEST(test_encode_decode);
+  RUN_TEST(test_encode_matches_reference);
+  RUN_TEST(test_decode_matches_reference);
+  RUN_TEST(test_decode_x4_matches_scalar);
+  RUN_TEST(test_decode_and_correct_x4_matches_scalar);
+  RUN_TEST(test_decode_and_correct_x4_triple_error);
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/bitstream.h"
+#include "wavebird/packet.h"
+
+#include "fixtures.h"
+#include "reference.h"
+
+#define STREAM_BYTES 512
+#define MAX_PACKETS  16
+
+// Packets received from the bitstream decoder
+struct received {
+  uint8_t packets[MAX_PACKETS][WAVEBIRD_PACKET_BYTES];
+  int count;
+};
+
+// Bitstream to push, built a bit at a time
+struct stream {
+  uint8_t data[STREAM_BYTES];
+  size_t bits;
+};
+
+static void handle_packet(const uint8_t *packet, void *context)
+{
+  struct received *received = context;
+  if (received->count < MAX_PACKETS)
+    memcpy(received->packets[received->count], packet, WAVEBIRD_PACKET_BYTES);
+  received->count++;
+}
+
+static void stream_write_bits(struct stream *stream, uint64_t value, int bits)
+{
+  for (int i = bits - 1; i >= 0; i--, stream->bits++) {
+    uint8_t mask = 0x80 >> (stream->bits % 8);
+    if ((value >> i) & 1)
+      stream->data[stream->bits / 8] |= mask;
+    else
+      stream->data[stream->bits / 8] &= ~mask;
+  }
+}
+
+// Write random bits, which may contain the sync pattern by chance in long streams
+static void stream_write_noise(struct stream *stream, int bits, uint32_t *seed)
+{
+  for (int i = 0; i < bits; i++)
+    stream_write_bits(stream, reference_random_u32(seed) & 1, 1);
+}
+
+// Write a frame, with some of the preamble and sync word bits flipped
+static void stream_write_frame(struct stream *stream, const uint8_t *packet, uint64_t sync_errors)
+{
+  stream_write_bits(stream, 0xFAAAAAAA1234 ^ sync_errors, 48);
+  for (int i = 0; i < WAVEBIRD_PACKET_BYTES; i++)
+    stream_write_bits(stream, packet[i], 8);
+}
+
+// Push the stream in random sized chunks
+static void stream_push(wavebird_bitstream_t *bitstream, const struct stream *stream, uint32_t *seed)
+{
+  size_t length = (stream->bits + 7) / 8;
+  for (size_t i = 0; i < length;) {
+    size_t chunk = reference_random_u32(seed) % 24;
+    if (chunk > length - i)
+      chunk = length - i;
+
+    wavebird_bitstream_push(bitstream, &stream->data[i], chunk);
+    i += chunk;
+  }
+}
+
+static void test_bitstream_aligned()
+{
+  struct received received = {0};
+  wavebird_bitstream_t bitstream;
+  wavebird_bitstream_init(&bitstream, 0, handle_packet, &received);
+
+  struct stream stream = {0};
+  stream_write_frame(&stream, packet_input_state_resting, 0);
+  stream_write_frame(&stream, packet_origin, 0);
+  wavebird_bitstream_push(&bitstream, stream.data, stream.bits / 8);
+
+  TEST_ASSERT_EQUAL(2, received.count);
+  TEST_ASSERT_EQUAL(2, bitstream.sync_count);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_input_state_resting, received.packets[0], WAVEBIRD_PACKET_BYTES);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_origin, received.packets[1], WAVEBIRD_PACKET_BYTES);
+}
+
+static void test_bitstream_any_offset()
+{
+  uint32_t seed = 0x5750000F;
+
+  for (int offset = 0; offset < 64; offset++) {
+    struct received received = {0};
+    wavebird_bitstream_t bitstream;
+    wavebird_bitstream_init(&bitstream, 0, handle_packet, &received);
+
+    // Frames at arbitrary bit offsets, separated by silence as in real transmissions
+    struct stream stream = {0};
+    stream_write_bits(&stream, 0, offset);
+    stream_write_frame(&stream, packet_input_state_resting, 0);
+    stream_write_bits(&stream, 0, 37);
+    stream_write_frame(&stream, packet_origin, 0);
+    stream_write_bits(&stream, 0, 8);
+    stream_push(&bitstream, &stream, &seed);
+
+    TEST_ASSERT_EQUAL(2, received.count);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_input_state_resting, received.packets[0], WAVEBIRD_PACKET_BYTES);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_origin, received.packets[1], WAVEBIRD_PACKET_BYTES);
+  }
+}
+
+static void test_bitstream_noise()
+{
+  uint32_t seed = 0x57500010;
+
+  struct received received = {0};
+  wavebird_bitstream_t bitstream;
+  wavebird_bitstream_init(&bitstream, 0, handle_packet, &received);
+
+  // Frames surrounded by random noise
+  struct stream stream = {0};
+  for (int i = 0; i < 4; i++) {
+    stream_write_noise(&stream, 300 + i * 7, &seed);
+    stream_write_frame(&stream, packet_input_state_resting, 0);
+  }
+  stream_push(&bitstream, &stream, &seed);
+
+  TEST_ASSERT_EQUAL(4, received.count);
+  for (int i = 0; i < 4; i++)
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_input_state_resting, received.packets[i], WAVEBIRD_PACKET_BYTES);
+}
+
+static void test_bitstream_sync_errors()
+{
+  uint32_t seed = 0x57500011;
+
+  // Two bit errors in the sync word
+  struct stream stream = {0};
+  stream_write_bits(&stream, 0, 3);
+  stream_write_frame(&stream, packet_input_state_resting, 0x0000000001008);
+  stream_write_bits(&stream, 0, 8);
+
+  // Not found when no errors are allowed
+  struct received received = {0};
+  wavebird_bitstream_t bitstream;
+  wavebird_bitstream_init(&bitstream, 0, handle_packet, &received);
+  stream_push(&bitstream, &stream, &seed);
+  TEST_ASSERT_EQUAL(0, received.count);
+
+  // Found when they are
+  wavebird_bitstream_init(&bitstream, 2, handle_packet, &received);
+  stream_push(&bitstream, &stream, &seed);
+  TEST_ASSERT_EQUAL(1, received.count);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_input_state_resting, received.packets[0], WAVEBIRD_PACKET_BYTES);
+
+  // Errors in the start of the preamble don't matter
+  stream.bits = 0;
+  stream_write_bits(&stream, 0, 5);
+  stream_write_frame(&stream, packet_origin, 0x0F5500000000);
+  stream_write_bits(&stream, 0, 8);
+
+  received.count = 0;
+  wavebird_bitstream_init(&bitstream, 0, handle_packet, &received);
+  stream_push(&bitstream, &stream, &seed);
+  TEST_ASSERT_EQUAL(1, received.count);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_origin, received.packets[0], WAVEBIRD_PACKET_BYTES);
+}
+
+void test_bitstream(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_bitstream_aligned);
+  RUN_TEST(test_bitstream_any_offset);
+  RUN_TEST(test_bitstream_noise);
+  RUN_TEST(test_bitstream_sync_errors);
+}
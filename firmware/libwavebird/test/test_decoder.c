@@ -0,0 +1,139 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/packet.h"
+
+#include "fixtures.h"
+
+#define STRESS_THREADS    8
+#define STRESS_ITERATIONS 20000
+
+// Packets decoded by the stress test, with a triple error in one codeword which needs recovery
+static uint8_t stress_packets[3][WAVEBIRD_PACKET_BYTES];
+
+// Results from a single-threaded decode of each stress test packet
+static uint8_t expected_messages[3][WAVEBIRD_MESSAGE_BYTES];
+static int expected_results[3];
+
+// Count CRC calculations, to check contexts use their own CRC function
+static int crc_calls;
+static uint16_t counting_crc(const uint8_t *data, size_t length)
+{
+  crc_calls++;
+  return wavebird_packet_crc_ccitt(data, length);
+}
+
+static void test_decoder_decode()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  int rcode = wavebird_decoder_decode(&decoder, message, packet_input_state_resting);
+
+  TEST_ASSERT_EQUAL(0, rcode);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+}
+
+static void test_decoder_encode()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  wavebird_decoder_encode(&decoder, packet, message_origin);
+
+  TEST_ASSERT_EQUAL_HEX16(wavebird_packet_get_crc(packet_origin), wavebird_packet_get_crc(packet));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(packet_origin, packet, 15);
+}
+
+static void test_decoder_crc_fn()
+{
+  wavebird_decoder_t counting, plain;
+  wavebird_decoder_init(&counting);
+  wavebird_decoder_init(&plain);
+  wavebird_decoder_set_crc_fn(&counting, counting_crc);
+
+  // Check only the context with the counting CRC function uses it
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  crc_calls = 0;
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&plain, message, packet_input_state_resting));
+  TEST_ASSERT_EQUAL(0, crc_calls);
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&counting, message, packet_input_state_resting));
+  TEST_ASSERT_EQUAL(1, crc_calls);
+
+  // Check the default context is unaffected
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode(message, packet_input_state_resting));
+  TEST_ASSERT_EQUAL(1, crc_calls);
+}
+
+// Decode and encode the stress test packets repeatedly, returning the number of mismatched results
+static void *stress_thread(void *arg)
+{
+  intptr_t mismatches = 0;
+
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_recovery_budget(&decoder, 64);
+
+  for (int i = 0; i < STRESS_ITERATIONS; i++) {
+    int p = i % 3;
+
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    int rcode = wavebird_decoder_decode(&decoder, message, stress_packets[p]);
+    if (rcode != expected_results[p] || memcmp(message, expected_messages[p], WAVEBIRD_MESSAGE_BYTES) != 0)
+      mismatches++;
+
+    uint8_t packet[WAVEBIRD_PACKET_BYTES];
+    wavebird_decoder_encode(&decoder, packet, message_input_state_resting);
+    if (wavebird_packet_get_crc(packet) != wavebird_packet_get_crc(packet_input_state_resting))
+      mismatches++;
+  }
+
+  return (void *)mismatches;
+}
+
+static void test_decoder_stress()
+{
+  // Clean fixture packets, and one with 3 errors in the same codeword (every 4th bit) which needs recovery
+  memcpy(stress_packets[0], packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  memcpy(stress_packets[1], packet_origin, WAVEBIRD_PACKET_BYTES);
+  memcpy(stress_packets[2], packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  stress_packets[2][0] ^= 0x80;
+  stress_packets[2][1] ^= 0x80;
+  stress_packets[2][2] ^= 0x80;
+
+  // Decode each packet on a single thread to get the expected results
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_recovery_budget(&decoder, 64);
+  for (int p = 0; p < 3; p++)
+    expected_results[p] = wavebird_decoder_decode(&decoder, expected_messages[p], stress_packets[p]);
+
+  TEST_ASSERT_EQUAL(0, expected_results[0]);
+  TEST_ASSERT_EQUAL(0, expected_results[1]);
+  TEST_ASSERT_EQUAL(WB_PACKET_RESCUED, expected_results[2]);
+
+  // Decode concurrently, with a context per thread
+  pthread_t threads[STRESS_THREADS];
+  for (int i = 0; i < STRESS_THREADS; i++)
+    TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, stress_thread, NULL));
+
+  for (int i = 0; i < STRESS_THREADS; i++) {
+    void *mismatches;
+    TEST_ASSERT_EQUAL(0, pthread_join(threads[i], &mismatches));
+    TEST_ASSERT_EQUAL(0, (intptr_t)mismatches);
+  }
+}
+
+void test_decoder(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_decoder_decode);
+  RUN_TEST(test_decoder_encode);
+  RUN_TEST(test_decoder_crc_fn);
+  RUN_TEST(test_decoder_stress);
+}
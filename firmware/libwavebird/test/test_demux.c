@@ -0,0 +1,173 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/demux.h"
+#include "wavebird/packet.h"
+
+#include "fixtures.h"
+
+// Make a controller state for a controller ID and message type
+static wavebird_gc_state_t make_state(uint16_t controller_id, bool origin)
+{
+  wavebird_gc_state_t state = {0};
+  state.header              = controller_id | (origin ? WB_MESSAGE_HEADER_ORIGIN : 0);
+  state.analog[0]           = controller_id;
+  return state;
+}
+
+static void test_demux_update()
+{
+  wavebird_demux_t demux;
+  wavebird_demux_init(&demux);
+
+  wavebird_gc_state_t input_state, origin;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&input_state, packet_input_state_resting));
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&origin, packet_origin));
+
+  wavebird_demux_update(&demux, &input_state, NULL, 10);
+  wavebird_demux_update(&demux, &origin, NULL, 20);
+
+  // Both packets are from the same controller, so they share an entry
+  uint16_t controller_id                  = wavebird_gc_state_get_controller_id(&input_state);
+  wavebird_demux_controller_t *controller = wavebird_demux_find(&demux, controller_id);
+  TEST_ASSERT_NOT_NULL(controller);
+  TEST_ASSERT_EQUAL(1, demux.count);
+  TEST_ASSERT_EQUAL_HEX16(controller_id, controller->controller_id);
+  TEST_ASSERT_EQUAL_UINT32(2, controller->packets);
+  TEST_ASSERT_EQUAL_UINT32(10, controller->first_seen);
+  TEST_ASSERT_EQUAL_UINT32(20, controller->last_seen);
+  TEST_ASSERT_EQUAL(255, controller->link_quality);
+
+  TEST_ASSERT_TRUE(controller->has_input);
+  TEST_ASSERT_TRUE(controller->has_origin);
+  TEST_ASSERT_EQUAL_MEMORY(&input_state, &controller->input, sizeof(input_state));
+  TEST_ASSERT_EQUAL_MEMORY(&origin, &controller->origin, sizeof(origin));
+
+  TEST_ASSERT_NULL(wavebird_demux_find(&demux, controller_id ^ 1));
+}
+
+static void test_demux_touch()
+{
+  wavebird_demux_t demux;
+  wavebird_demux_init(&demux);
+
+  // Packets which were only partially decoded are counted, without any state
+  wavebird_demux_touch(&demux, 0x123, 5);
+  wavebird_demux_controller_t *controller = wavebird_demux_touch(&demux, 0x123, 6);
+  TEST_ASSERT_EQUAL_UINT32(2, controller->packets);
+  TEST_ASSERT_FALSE(controller->has_input);
+  TEST_ASSERT_FALSE(controller->has_origin);
+
+  // Message type bits in the ID are ignored
+  TEST_ASSERT_EQUAL_PTR(controller, wavebird_demux_find(&demux, 0x123 | WB_MESSAGE_HEADER_ORIGIN));
+}
+
+static void test_demux_lru_eviction()
+{
+  wavebird_demux_t demux;
+  wavebird_demux_init(&demux);
+
+  for (int i = 0; i < WAVEBIRD_DEMUX_CONTROLLERS; i++) {
+    wavebird_gc_state_t state = make_state(0x100 + i, false);
+    wavebird_demux_update(&demux, &state, NULL, i);
+  }
+
+  // Seeing the oldest controller again makes the second oldest the least recent
+  wavebird_gc_state_t state = make_state(0x100, false);
+  wavebird_demux_update(&demux, &state, NULL, 100);
+
+  state = make_state(0x200, true);
+  wavebird_demux_update(&demux, &state, NULL, 101);
+
+  TEST_ASSERT_EQUAL(WAVEBIRD_DEMUX_CONTROLLERS, demux.count);
+  TEST_ASSERT_EQUAL_UINT32(1, demux.evictions);
+  TEST_ASSERT_NULL(wavebird_demux_find(&demux, 0x101));
+
+  // Every other controller is still tracked, with its own state
+  TEST_ASSERT_NOT_NULL(wavebird_demux_find(&demux, 0x200));
+  for (int i = 0; i < WAVEBIRD_DEMUX_CONTROLLERS; i++) {
+    if (i == 1)
+      continue;
+
+    wavebird_demux_controller_t *controller = wavebird_demux_find(&demux, 0x100 + i);
+    TEST_ASSERT_NOT_NULL(controller);
+    TEST_ASSERT_EQUAL_HEX16(0x100 + i, controller->controller_id);
+    TEST_ASSERT_EQUAL_HEX8((0x100 + i) & 0xFF, controller->input.analog[0]);
+  }
+
+  // Keep evicting, each new controller should replace the least recently seen one
+  for (int i = 0; i < 2 * WAVEBIRD_DEMUX_CONTROLLERS; i++) {
+    state = make_state(0x300 + i, false);
+    wavebird_demux_update(&demux, &state, NULL, 200 + i);
+  }
+
+  TEST_ASSERT_EQUAL(WAVEBIRD_DEMUX_CONTROLLERS, demux.count);
+  for (int i = 0; i < WAVEBIRD_DEMUX_CONTROLLERS; i++) {
+    TEST_ASSERT_NULL(wavebird_demux_find(&demux, 0x300 + i));
+    TEST_ASSERT_NOT_NULL(wavebird_demux_find(&demux, 0x300 + WAVEBIRD_DEMUX_CONTROLLERS + i));
+  }
+}
+
+static void test_demux_expire()
+{
+  wavebird_demux_t demux;
+  wavebird_demux_init(&demux);
+
+  wavebird_demux_touch(&demux, 1, 100);
+  wavebird_demux_touch(&demux, 2, 200);
+  wavebird_demux_touch(&demux, 3, 300);
+  wavebird_demux_touch(&demux, 1, 400);
+
+  TEST_ASSERT_EQUAL(2, wavebird_demux_expire(&demux, 500, 150));
+  TEST_ASSERT_EQUAL(1, demux.count);
+  TEST_ASSERT_NOT_NULL(wavebird_demux_find(&demux, 1));
+  TEST_ASSERT_NULL(wavebird_demux_find(&demux, 2));
+  TEST_ASSERT_NULL(wavebird_demux_find(&demux, 3));
+
+  // New controllers can be tracked after expiry
+  wavebird_demux_touch(&demux, 4, 600);
+  TEST_ASSERT_EQUAL(2, demux.count);
+  TEST_ASSERT_NOT_NULL(wavebird_demux_find(&demux, 4));
+  TEST_ASSERT_EQUAL(2, wavebird_demux_expire(&demux, 2000, 100));
+  TEST_ASSERT_NULL(wavebird_demux_select(&demux, WB_DEMUX_SELECT_MOST_RECENT));
+}
+
+static void test_demux_select()
+{
+  wavebird_demux_t demux;
+  wavebird_demux_init(&demux);
+  TEST_ASSERT_NULL(wavebird_demux_select(&demux, WB_DEMUX_SELECT_FIRST_SEEN));
+
+  // A noisy controller seen first, then a clean one
+  wavebird_decode_result_t noisy = {.corrected_bits = 4};
+  for (int i = 0; i < 16; i++) {
+    wavebird_gc_state_t state = make_state(0x010, false);
+    wavebird_demux_update(&demux, &state, &noisy, i);
+  }
+
+  wavebird_gc_state_t state = make_state(0x020, false);
+  wavebird_demux_update(&demux, &state, NULL, 20);
+
+  // Then the noisy controller again
+  state = make_state(0x010, false);
+  wavebird_demux_update(&demux, &state, &noisy, 30);
+
+  wavebird_demux_controller_t *noisy_controller = wavebird_demux_find(&demux, 0x010);
+  TEST_ASSERT_LESS_THAN(255, noisy_controller->link_quality);
+
+  TEST_ASSERT_EQUAL_HEX16(0x010, wavebird_demux_select(&demux, WB_DEMUX_SELECT_FIRST_SEEN)->controller_id);
+  TEST_ASSERT_EQUAL_HEX16(0x010, wavebird_demux_select(&demux, WB_DEMUX_SELECT_MOST_RECENT)->controller_id);
+  TEST_ASSERT_EQUAL_HEX16(0x020, wavebird_demux_select(&demux, WB_DEMUX_SELECT_STRONGEST)->controller_id);
+}
+
+void test_demux(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_demux_update);
+  RUN_TEST(test_demux_touch);
+  RUN_TEST(test_demux_lru_eviction);
+  RUN_TEST(test_demux_expire);
+  RUN_TEST(test_demux_select);
+}
@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/bitstream.h"
+#include "wavebird/despread.h"
+#include "wavebird/packet.h"
+
+#include "channel.h"
+#include "fixtures.h"
+#include "reference.h"
+
+#define FRAME_BYTES   25
+#define FRAME_BITS    (FRAME_BYTES * 8)
+#define GAP_BITS      10
+#define STREAM_BITS   (FRAME_BITS + 2 * GAP_BITS)
+#define MAX_SAMPLES   (STREAM_BITS * WAVEBIRD_DSSS_CHIPS * WAVEBIRD_DESPREADER_MAX_OVERSAMPLE)
+#define MAX_BITS      (WAVEBIRD_DESPREADER_MAX_BITS(MAX_SAMPLES) + 8)
+#define PUSH_SAMPLES  97
+
+static int8_t samples[MAX_SAMPLES];
+
+// Despread bits, and the packet found in them
+struct despread {
+  uint8_t bits[MAX_BITS];
+  uint8_t confidence[MAX_BITS];
+  size_t count;
+  wavebird_bitstream_t bitstream;
+  size_t pushed;
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  size_t packet_end;
+  int packets;
+};
+
+static void handle_packet(const uint8_t *packet, void *context)
+{
+  struct despread *despread = context;
+  memcpy(despread->packet, packet, WAVEBIRD_PACKET_BYTES);
+
+  // The packet ends offset bits before the end of the last byte pushed
+  despread->packet_end = despread->pushed * 8 - despread->bitstream.offset;
+  despread->packets++;
+}
+
+// Build a frame carrying a packet, with noise before and after it
+static void build_stream(uint8_t *stream, const uint8_t *packet, uint32_t seed)
+{
+  static const uint8_t preamble[] = {0xFA, 0xAA, 0xAA, 0xAA, 0x12, 0x34};
+
+  memset(stream, 0, (STREAM_BITS + 7) / 8);
+  for (int i = 0; i < FRAME_BITS; i++) {
+    int bit = i < 48 ? (preamble[i / 8] >> (7 - i % 8)) & 1 : (packet[(i - 48) / 8] >> (7 - (i - 48) % 8)) & 1;
+    int j   = GAP_BITS + i;
+    stream[j / 8] |= bit << (7 - j % 8);
+  }
+
+  // Random bits either side of the frame, which also spread into valid code periods
+  for (int i = 0; i < GAP_BITS; i++) {
+    reference_random_u32(&seed);
+    stream[i / 8] |= (seed & 1) << (7 - i % 8);
+    int j = GAP_BITS + FRAME_BITS + i;
+    stream[j / 8] |= ((seed >> 1) & 1) << (7 - j % 8);
+  }
+}
+
+// Despread samples in uneven chunks, then search the bits for a packet
+static void despread_samples(struct despread *despread, wavebird_despreader_t *despreader, size_t count)
+{
+  despread->count = 0;
+  for (size_t i = 0; i < count; i += PUSH_SAMPLES) {
+    size_t chunk = count - i < PUSH_SAMPLES ? count - i : PUSH_SAMPLES;
+    despread->count += wavebird_despreader_push(despreader, despread->bits + despread->count,
+                                                despread->confidence + despread->count, samples + i, chunk);
+  }
+
+  wavebird_bitstream_init(&despread->bitstream, 2, handle_packet, despread);
+  despread->pushed  = 0;
+  despread->packets = 0;
+  for (size_t i = 0; i + 8 <= despread->count; i += 8) {
+    uint8_t byte = 0;
+    for (int b = 0; b < 8; b++)
+      byte = byte << 1 | despread->bits[i + b];
+
+    despread->pushed++;
+    wavebird_bitstream_push(&despread->bitstream, &byte, 1);
+  }
+}
+
+static void test_despread_hard_chips()
+{
+  uint8_t stream[(STREAM_BITS + 7) / 8];
+  build_stream(stream, packet_input_state_resting, 0x57500020);
+
+  // Spread the stream into packed hard chips
+  static uint8_t chips[STREAM_BITS * WAVEBIRD_DSSS_CHIPS / 8 + 1];
+  memset(chips, 0, sizeof(chips));
+  for (int i = 0; i < STREAM_BITS * WAVEBIRD_DSSS_CHIPS; i++) {
+    int bit  = (stream[i / WAVEBIRD_DSSS_CHIPS / 8] >> (7 - i / WAVEBIRD_DSSS_CHIPS % 8)) & 1;
+    int chip = ((WAVEBIRD_DSSS_CODE >> (WAVEBIRD_DSSS_CHIPS - 1 - i % WAVEBIRD_DSSS_CHIPS)) & 1) ^ !bit;
+    chips[i / 8] |= chip << (7 - i % 8);
+  }
+
+  static struct despread despread;
+  wavebird_despreader_t despreader;
+  wavebird_despreader_init(&despreader, 1);
+
+  despread.count = wavebird_despreader_push_hard(&despreader, despread.bits, despread.confidence, chips,
+                                                 STREAM_BITS * WAVEBIRD_DSSS_CHIPS);
+
+  // Locks on the first code period, and every bit correlates perfectly, the last bit waits for its late sample
+  TEST_ASSERT_EQUAL_UINT32(1, despreader.locks);
+  TEST_ASSERT_EQUAL_UINT32(0, despreader.adjustments);
+  TEST_ASSERT_EQUAL_UINT32(STREAM_BITS - 1, despread.count);
+  for (size_t i = 0; i < despread.count; i++) {
+    TEST_ASSERT_EQUAL_UINT8((stream[i / 8] >> (7 - i % 8)) & 1, despread.bits[i]);
+    TEST_ASSERT_EQUAL_UINT8(255, despread.confidence[i]);
+  }
+}
+
+static void test_despread_chip_timing_drift()
+{
+  uint8_t stream[(STREAM_BITS + 7) / 8];
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  wavebird_packet_encode(packet, message_origin);
+  build_stream(stream, packet, 0x57500021);
+
+  // Transmitter clocks 0.25% fast and 0.25% slow, dropping or repeating a sample every 400
+  for (int drift = -1; drift <= 1; drift += 2) {
+    struct channel channel = {.seed = 0x57500022, .noise = 0.5f};
+    static int8_t sent[MAX_SAMPLES];
+    size_t count = channel_spread(&channel, sent, stream, STREAM_BITS, 4);
+
+    size_t received = 0;
+    for (size_t i = 0; i < count && received < MAX_SAMPLES; i++) {
+      if (i % 400 == 399 && drift < 0)
+        continue;
+      samples[received++] = sent[i];
+      if (i % 400 == 399 && drift > 0)
+        samples[received++] = sent[i];
+    }
+
+    static struct despread despread;
+    wavebird_despreader_t despreader;
+    wavebird_despreader_init(&despreader, 4);
+    despread_samples(&despread, &despreader, received);
+
+    // Timing is pulled back into line, and the packet comes through intact
+    TEST_ASSERT_GREATER_OR_EQUAL(count / 400 - 1, despreader.adjustments);
+    TEST_ASSERT_EQUAL(1, despread.packets);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet, despread.packet, WAVEBIRD_PACKET_BYTES);
+  }
+}
+
+static void test_despread_soft_decoding()
+{
+  uint8_t stream[(STREAM_BITS + 7) / 8];
+  build_stream(stream, packet_input_state_resting, 0x57500023);
+
+  // Heavy noise, where the confidence lets soft decoding recover packets hard decoding can't
+  struct channel channel = {.seed = 0x57500024, .noise = 1.4f};
+  int hard = 0, soft = 0, wrong = 0;
+  for (int i = 0; i < 50; i++) {
+    size_t count = channel_spread(&channel, samples, stream, STREAM_BITS, 1);
+
+    static struct despread despread;
+    wavebird_despreader_t despreader;
+    wavebird_despreader_init(&despreader, 1);
+    despread_samples(&despread, &despreader, count);
+    if (despread.packets != 1)
+      continue;
+
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    if (wavebird_packet_decode(message, despread.packet) >= 0)
+      hard++;
+
+    const uint8_t *reliability = despread.confidence + despread.packet_end - WAVEBIRD_PACKET_BITS;
+    if (wavebird_packet_decode_soft(message, despread.packet, reliability) >= 0) {
+      soft++;
+      if (memcmp(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES) != 0)
+        wrong++;
+    }
+  }
+
+  TEST_ASSERT_GREATER_THAN(hard, soft);
+  TEST_ASSERT_EQUAL(0, wrong);
+}
+
+void test_despread(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_despread_hard_chips);
+  RUN_TEST(test_despread_chip_timing_drift);
+  RUN_TEST(test_despread_soft_decoding);
+}
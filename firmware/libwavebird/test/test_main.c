@@ -1,7 +1,13 @@
 #include "unity.h"
 
 extern void test_bch3121();
+extern void test_bitstream();
+extern void test_demux();
+extern void test_despread();
 extern void test_packet();
+extern void test_packet_cache();
+extern void test_decoder();
+extern void test_radio();
 
 __attribute__((weak)) void suiteSetUp(void)
 {
@@ -22,7 +28,13 @@ int main(int argc, char **argv)
   suiteSetUp();
 
   test_bch3121();
+  test_bitstream();
+  test_demux();
+  test_despread();
   test_packet();
+  test_packet_cache();
+  test_decoder();
+  test_radio();
 
   return UNITY_END();
 }
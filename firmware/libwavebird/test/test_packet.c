@@ -5,7 +5,43 @@
 #include "wavebird/message.h"
 #include "wavebird/packet.h"
 
+#include "channel.h"
 #include "fixtures.h"
+#include "reference.h"
+
+// Fill a buffer with random bytes
+static void random_bytes(uint8_t *data, size_t length, uint32_t *seed)
+{
+  for (size_t i = 0; i < length; i++)
+    data[i] = reference_random_u32(seed);
+}
+
+// Flip a bit of one of the interleaved codewords in a packet
+static void flip_codeword_bit(uint8_t *packet, int codeword, int bit)
+{
+  int position = 123 - (bit * 4 + codeword);
+  packet[position / 8] ^= 1 << (7 - position % 8);
+}
+
+static void test_crc_ccitt()
+{
+  // Standard check value for CRC-CCITT with initial value 0x0000 (XMODEM)
+  const uint8_t check[] = "123456789";
+  TEST_ASSERT_EQUAL_HEX16(0x31C3, wavebird_packet_crc_ccitt(check, 9));
+}
+
+static void test_crc_ccitt_matches_reference()
+{
+  uint32_t seed = 0x5750000B;
+
+  for (int i = 0; i < 10000; i++) {
+    uint8_t data[64];
+    size_t length = reference_random_u32(&seed) % (sizeof(data) + 1);
+    random_bytes(data, length, &seed);
+
+    TEST_ASSERT_EQUAL_HEX16(reference_crc_ccitt(data, length), wavebird_packet_crc_ccitt(data, length));
+  }
+}
 
 static void test_deinterleave()
 {
@@ -43,6 +79,112 @@ static void test_deinterleave_interleave()
   TEST_ASSERT_EQUAL_HEX8(packet_input_state_resting[15] & 0xf0, packet[15] & 0xf0);
 }
 
+static void test_deinterleave_matches_reference()
+{
+  uint32_t seed = 0x57500008;
+
+  for (int i = 0; i < 10000; i++) {
+    uint8_t packet[WAVEBIRD_PACKET_BYTES];
+    random_bytes(packet, sizeof(packet), &seed);
+
+    uint32_t expected[4] = {0};
+    uint32_t actual[4];
+    reference_packet_deinterleave(expected, packet);
+    wavebird_packet_deinterleave(actual, packet);
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, actual, 4);
+  }
+}
+
+static void test_interleave_matches_reference()
+{
+  uint32_t seed = 0x57500009;
+
+  for (int i = 0; i < 10000; i++) {
+    // Random codewords, interleaved into a random packet to check the CRC and footer are left alone
+    uint32_t codewords[4];
+    for (int j = 0; j < 4; j++)
+      codewords[j] = reference_random_u32(&seed) & 0x7FFFFFFF;
+
+    uint8_t expected[WAVEBIRD_PACKET_BYTES], actual[WAVEBIRD_PACKET_BYTES];
+    random_bytes(expected, sizeof(expected), &seed);
+    memcpy(actual, expected, sizeof(actual));
+
+    reference_packet_interleave(expected, codewords);
+    wavebird_packet_interleave(actual, codewords);
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, WAVEBIRD_PACKET_BYTES);
+  }
+}
+
+static void test_encode_decode_random()
+{
+  uint32_t seed = 0x5750000A;
+
+  for (int i = 0; i < 10000; i++) {
+    // Random 84-bit message
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    random_bytes(message, sizeof(message), &seed);
+    message[0] &= 0x0F;
+
+    uint8_t packet[WAVEBIRD_PACKET_BYTES];
+    wavebird_packet_encode(packet, message);
+
+    // Check each codeword encodes the expected 21 bits of the message
+    uint32_t codewords[4] = {0};
+    reference_packet_deinterleave(codewords, packet);
+    for (int j = 0; j < 4; j++) {
+      uint32_t expected = 0;
+      for (int k = 0; k < BCH3121_MESSAGE_LEN; k++)
+        expected |= reference_get_bit(message, WAVEBIRD_MESSAGE_BYTES, j * BCH3121_MESSAGE_LEN + k) << k;
+
+      TEST_ASSERT_EQUAL_HEX32(reference_bch3121_encode(expected), codewords[j]);
+    }
+
+    // Check the packet decodes back to the same message
+    uint8_t decoded[WAVEBIRD_MESSAGE_BYTES];
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode(decoded, packet));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(message, decoded, WAVEBIRD_MESSAGE_BYTES);
+  }
+}
+
+static void test_encode_custom_crc_fn()
+{
+  uint32_t seed = 0x5750000F;
+
+  // A context with its own CRC function, which calculates the CRC from the transposed CRC state
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_crc_fn(&decoder, reference_crc_ccitt);
+
+  for (int i = 0; i < 10000; i++) {
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    random_bytes(message, sizeof(message), &seed);
+    message[0] &= 0x0F;
+
+    // Check both CRC paths produce identical packets
+    uint8_t expected[WAVEBIRD_PACKET_BYTES], actual[WAVEBIRD_PACKET_BYTES];
+    wavebird_decoder_encode(&decoder, expected, message);
+    wavebird_packet_encode(actual, message);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, WAVEBIRD_PACKET_BYTES);
+
+    // Check each decodes the other's packets
+    uint8_t decoded[WAVEBIRD_MESSAGE_BYTES];
+    TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&decoder, decoded, actual));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(message, decoded, WAVEBIRD_MESSAGE_BYTES);
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode(decoded, expected));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(message, decoded, WAVEBIRD_MESSAGE_BYTES);
+  }
+
+  // Check clearing the CRC function restores the built-in CRC
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45};
+  uint8_t expected[WAVEBIRD_PACKET_BYTES], actual[WAVEBIRD_PACKET_BYTES];
+  wavebird_decoder_set_crc_fn(&decoder, NULL);
+  wavebird_decoder_encode(&decoder, actual, message);
+  wavebird_packet_encode(expected, message);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, WAVEBIRD_PACKET_BYTES);
+}
+
 static void test_encode_input_state()
 {
   // Encode the input state message
@@ -125,6 +267,59 @@ static void test_decode_origin()
   TEST_ASSERT_EQUAL_HEX8(0x13, wavebird_origin_get_trigger_right(message));
 }
 
+static void test_decode_gc_state_input_state()
+{
+  wavebird_gc_state_t state;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&state, packet_input_state_resting));
+
+  TEST_ASSERT_EQUAL(WB_MESSAGE_TYPE_INPUT_STATE, wavebird_gc_state_get_type(&state));
+  TEST_ASSERT_EQUAL_HEX16(0x2B1, wavebird_gc_state_get_controller_id(&state));
+
+  wavebird_gc_state_t expected;
+  reference_message_to_gc_state(&expected, message_input_state_resting);
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &state, sizeof(state));
+}
+
+static void test_decode_gc_state_origin()
+{
+  wavebird_gc_state_t state;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&state, packet_origin));
+
+  TEST_ASSERT_EQUAL(WB_MESSAGE_TYPE_ORIGIN, wavebird_gc_state_get_type(&state));
+  TEST_ASSERT_EQUAL_HEX16(0x2B1, wavebird_gc_state_get_controller_id(&state));
+
+  const uint8_t expected_origin[] = {0x86, 0x7F, 0x8B, 0x83, 0x1B, 0x13};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_origin, state.analog, 6);
+
+  wavebird_gc_state_t expected;
+  reference_message_to_gc_state(&expected, message_origin);
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &state, sizeof(state));
+}
+
+static void test_decode_gc_state_matches_reference()
+{
+  uint32_t seed = 0x5750000C;
+
+  for (int i = 0; i < 10000; i++) {
+    // Random 84-bit message, of either type
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    random_bytes(message, sizeof(message), &seed);
+    message[0] &= 0x0F;
+
+    uint8_t packet[WAVEBIRD_PACKET_BYTES];
+    wavebird_packet_encode(packet, message);
+
+    // Check the fused decode matches decoding and then unpacking the message
+    uint8_t decoded[WAVEBIRD_MESSAGE_BYTES];
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode(decoded, packet));
+
+    wavebird_gc_state_t expected, state;
+    reference_message_to_gc_state(&expected, decoded);
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&state, packet));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &state, sizeof(state));
+  }
+}
+
 static void test_decode_single_error()
 {
   uint8_t packet[WAVEBIRD_PACKET_BYTES];
@@ -224,20 +419,392 @@ static void test_encode_decode()
   TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
 }
 
+static void test_decode_recovery()
+{
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+
+  // Try triple errors in each codeword, at a few different positions
+  int rescued = 0;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 28; j += 3) {
+      memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+      flip_codeword_bit(packet, i, j);
+      flip_codeword_bit(packet, i, j + 1);
+      flip_codeword_bit(packet, i, (j + 16) % BCH3121_CODEWORD_LEN);
+
+      // Skip error patterns which are miscorrected, rather than detected
+      wavebird_packet_set_recovery_budget(0);
+      if (wavebird_packet_decode(message, packet) != -WB_PACKET_ERR_DECODE_FAILED)
+        continue;
+
+      // Check the packet can be recovered
+      wavebird_packet_set_recovery_budget(64);
+      int rcode = wavebird_packet_decode(message, packet);
+      TEST_ASSERT_EQUAL(WB_PACKET_RESCUED, rcode);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+      rescued++;
+    }
+  }
+
+  // Check some of the patterns reached recovery
+  TEST_ASSERT_GREATER_THAN(0, rescued);
+  wavebird_packet_set_recovery_budget(0);
+}
+
+static void test_decode_recovery_two_failed_codewords()
+{
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+
+  // Triple errors in two codewords
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  for (int i = 0; i < 3; i++) {
+    flip_codeword_bit(packet, 0, i);
+    flip_codeword_bit(packet, 1, i);
+  }
+
+  // Check recovery is not attempted
+  wavebird_packet_set_recovery_budget(64);
+  int rcode = wavebird_packet_decode(message, packet);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, rcode);
+
+  wavebird_packet_set_recovery_budget(0);
+}
+
+// Corrupt a codeword with a 3-error pattern which is detected rather than miscorrected
+static void flip_uncorrectable(uint8_t *packet, int codeword)
+{
+  uint32_t message;
+  for (int j = 0; j < 28; j++) {
+    uint32_t errors = 1 << j | 1 << (j + 1) | 1 << (j + 3);
+    if (bch3121_decode_and_correct(&message, bch3121_encode(0) ^ errors) < 0) {
+      flip_codeword_bit(packet, codeword, j);
+      flip_codeword_bit(packet, codeword, j + 1);
+      flip_codeword_bit(packet, codeword, j + 3);
+      return;
+    }
+  }
+
+  TEST_FAIL_MESSAGE("No uncorrectable error pattern found");
+}
+
+static void test_decode_header()
+{
+  uint16_t header;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_header(&header, packet_input_state_resting));
+  TEST_ASSERT_EQUAL_HEX16(0x0AB1, header);
+
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_header(&header, packet_origin));
+  TEST_ASSERT_EQUAL_HEX16(0x0EB1, header);
+
+  // Errors in the other codewords don't matter
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  for (int i = 0; i < 3; i++)
+    flip_uncorrectable(packet, i);
+  flip_codeword_bit(packet, 3, 17);
+
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_header(&header, packet));
+  TEST_ASSERT_EQUAL_HEX16(0x0AB1, header);
+
+  // But the header codeword must decode
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  flip_uncorrectable(packet, 3);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, wavebird_packet_decode_header(&header, packet));
+}
+
+static void test_decode_buttons()
+{
+  uint32_t seed = 0x5750000E;
+
+  for (int i = 0; i < 1000; i++) {
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    random_bytes(message, sizeof(message), &seed);
+    message[0] &= 0x0F;
+
+    uint8_t packet[WAVEBIRD_PACKET_BYTES];
+    wavebird_packet_encode(packet, message);
+
+    uint16_t header, buttons;
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode_buttons(&header, &buttons, packet));
+    TEST_ASSERT_EQUAL_HEX16(wavebird_message_get_controller_id(message), header & WB_MESSAGE_HEADER_CONTROLLER_ID);
+    TEST_ASSERT_EQUAL(wavebird_message_get_type(message), header & WB_MESSAGE_HEADER_ORIGIN ? 1 : 0);
+    TEST_ASSERT_EQUAL_HEX16(wavebird_input_state_get_buttons(message), buttons);
+  }
+}
+
+// Encode a copy of a message with one of its 21-bit parts changed, so only that codeword differs
+static void encode_variant(uint8_t *packet, const uint8_t *message, int codeword)
+{
+  uint8_t variant[WAVEBIRD_MESSAGE_BYTES];
+  memcpy(variant, message, WAVEBIRD_MESSAGE_BYTES);
+
+  int bit = codeword * BCH3121_MESSAGE_LEN + 4;
+  variant[WAVEBIRD_MESSAGE_BYTES - 1 - bit / 8] ^= 1 << (bit % 8);
+  wavebird_packet_encode(packet, variant);
+}
+
+static void test_decode_history_repair()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_history_repair(&decoder, true);
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&decoder, message, packet_input_state_resting));
+
+  // Lose each codeword of the same packet in turn
+  for (int i = 0; i < 4; i++) {
+    memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+    flip_uncorrectable(packet, i);
+
+    TEST_ASSERT_EQUAL(WB_PACKET_REPAIRED, wavebird_decoder_decode(&decoder, message, packet));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+  }
+
+  // Lose a codeword which didn't change since the last packet
+  uint8_t expected[WAVEBIRD_MESSAGE_BYTES];
+  encode_variant(packet, message_input_state_resting, 0);
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&decoder, expected, packet));
+  flip_uncorrectable(packet, 2);
+
+  wavebird_decode_result_t result;
+  TEST_ASSERT_EQUAL(WB_PACKET_REPAIRED, wavebird_decoder_decode_ex(&decoder, message, &result, packet));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, message, WAVEBIRD_MESSAGE_BYTES);
+  TEST_ASSERT_EQUAL(2, result.failed_codeword);
+  TEST_ASSERT_EQUAL(3, result.corrected[2]);
+}
+
+static void test_decode_history_repair_changed_codeword()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+  wavebird_decoder_set_history_repair(&decoder, true);
+
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode(&decoder, message, packet_input_state_resting));
+
+  // Losing a codeword which changed since the last packet can't be repaired
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  encode_variant(packet, message_input_state_resting, 1);
+  flip_uncorrectable(packet, 1);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, wavebird_decoder_decode(&decoder, message, packet));
+
+  // Nor can packets from other controllers
+  uint8_t other[WAVEBIRD_MESSAGE_BYTES];
+  memcpy(other, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES);
+  other[2] ^= 0x10;
+  wavebird_packet_encode(packet, other);
+  flip_uncorrectable(packet, 0);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, wavebird_decoder_decode(&decoder, message, packet));
+
+  // Or anything once repair is disabled
+  wavebird_decoder_set_history_repair(&decoder, false);
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  flip_uncorrectable(packet, 0);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, wavebird_decoder_decode(&decoder, message, packet));
+}
+
+static void test_decode_ex_clean()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  wavebird_decode_result_t result;
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode_ex(&decoder, message, &result, packet_input_state_resting));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+
+  const uint32_t zero_syndromes[4] = {0};
+  const uint8_t zero_corrected[4]  = {0};
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(zero_syndromes, result.syndromes, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(zero_corrected, result.corrected, 4);
+  TEST_ASSERT_EQUAL(-1, result.failed_codeword);
+  TEST_ASSERT_EQUAL(0, result.corrected_bits);
+  TEST_ASSERT_EQUAL_HEX16(wavebird_packet_get_crc(packet_input_state_resting), result.expected_crc);
+  TEST_ASSERT_EQUAL_HEX16(result.expected_crc, result.actual_crc);
+}
+
+static void test_decode_ex_corrected()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  // One error in codeword 0, two in codeword 3
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  flip_codeword_bit(packet, 0, 5);
+  flip_codeword_bit(packet, 3, 0);
+  flip_codeword_bit(packet, 3, 30);
+
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  wavebird_decode_result_t result;
+  TEST_ASSERT_EQUAL(0, wavebird_decoder_decode_ex(&decoder, message, &result, packet));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+
+  const uint8_t expected_corrected[4] = {1, 0, 0, 2};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_corrected, result.corrected, 4);
+  TEST_ASSERT_EQUAL(-1, result.failed_codeword);
+  TEST_ASSERT_EQUAL(3, result.corrected_bits);
+
+  // Check the syndromes match decoding each codeword separately
+  uint32_t codewords[4], tmp;
+  wavebird_packet_deinterleave(codewords, packet);
+  for (int i = 0; i < 4; i++)
+    TEST_ASSERT_EQUAL_HEX32(bch3121_decode(&tmp, codewords[i]), result.syndromes[i]);
+}
+
+static void test_decode_ex_failure()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  // Uncorrectable errors in codeword 1, and a correctable one in codeword 2
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  flip_uncorrectable(packet, 1);
+  flip_codeword_bit(packet, 2, 7);
+
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  wavebird_decode_result_t result;
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_DECODE_FAILED, wavebird_decoder_decode_ex(&decoder, message, &result, packet));
+  TEST_ASSERT_EQUAL(1, result.failed_codeword);
+  TEST_ASSERT_LESS_THAN(0, result.corrected[1]);
+  TEST_ASSERT_EQUAL(1, result.corrected[2]);
+  TEST_ASSERT_EQUAL(1, result.corrected_bits);
+  TEST_ASSERT_EQUAL_HEX16(0, result.actual_crc);
+
+  // With recovery enabled, the packet is rescued and the 3 errors are counted
+  wavebird_decoder_set_recovery_budget(&decoder, 64);
+  TEST_ASSERT_EQUAL(WB_PACKET_RESCUED, wavebird_decoder_decode_ex(&decoder, message, &result, packet));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+  TEST_ASSERT_EQUAL(1, result.failed_codeword);
+  TEST_ASSERT_EQUAL(3, result.corrected[1]);
+  TEST_ASSERT_EQUAL(4, result.corrected_bits);
+  TEST_ASSERT_EQUAL_HEX16(result.expected_crc, result.actual_crc);
+}
+
+static void test_decode_ex_crc_mismatch()
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  packet[16] ^= 0x10;
+
+  wavebird_gc_state_t state;
+  wavebird_decode_result_t result;
+  int rc = wavebird_decoder_decode_gc_state_ex(&decoder, &state, &result, packet);
+  TEST_ASSERT_EQUAL(-WB_PACKET_ERR_CRC_MISMATCH, rc);
+  TEST_ASSERT_EQUAL(-1, result.failed_codeword);
+  TEST_ASSERT_EQUAL_HEX16(wavebird_packet_get_crc(packet), result.expected_crc);
+  TEST_ASSERT_EQUAL_HEX16(wavebird_packet_get_crc(packet_input_state_resting), result.actual_crc);
+}
+
+static void test_decode_soft_clean()
+{
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+  memset(reliability, 255, sizeof(reliability));
+
+  // Check decoding was successful
+  int rcode = wavebird_packet_decode_soft(message, packet_input_state_resting, reliability);
+  TEST_ASSERT_EQUAL(0, rcode);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+}
+
+static void test_decode_soft_weak_bits()
+{
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+
+  // Corrupt 4 bits of the same codeword, every 4th bit belongs to the same codeword
+  memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+  memset(reliability, 200, sizeof(reliability));
+  for (int i = 0; i < 4; i++) {
+    int bit = 8 + i * 12;
+    packet[bit / 8] ^= (1 << (7 - bit % 8));
+    reliability[bit] = 10 + i;
+  }
+
+  // Check hard-decision decoding fails
+  int rcode = wavebird_packet_decode(message, packet);
+  TEST_ASSERT_NOT_EQUAL(0, rcode);
+
+  // Check soft-decision decoding recovers the packet
+  rcode = wavebird_packet_decode_soft(message, packet, reliability);
+  TEST_ASSERT_EQUAL(0, rcode);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+}
+
+static void test_decode_soft_awgn()
+{
+  struct channel channel = {
+      .seed = 0x57500003, .noise = 0.45f, .burst_rate = 0.002f, .burst_noise = 1.5f, .burst_bits = 8};
+
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  uint8_t reliability[WAVEBIRD_PACKET_BITS];
+
+  int hard_decoded = 0, soft_decoded = 0;
+  for (int i = 0; i < 1000; i++) {
+    channel_transmit(&channel, packet, reliability, packet_input_state_resting);
+
+    if (wavebird_packet_decode(message, packet) == 0) {
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+      hard_decoded++;
+    }
+
+    if (wavebird_packet_decode_soft(message, packet, reliability) == 0) {
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(message_input_state_resting, message, WAVEBIRD_MESSAGE_BYTES);
+      soft_decoded++;
+    }
+  }
+
+  // Check soft-decision decoding recovers more packets than hard-decision decoding
+  TEST_ASSERT_GREATER_THAN(hard_decoded, soft_decoded);
+}
+
 void test_packet(void)
 {
   Unity.TestFile = __FILE_NAME__;
 
+  RUN_TEST(test_crc_ccitt);
+  RUN_TEST(test_crc_ccitt_matches_reference);
   RUN_TEST(test_deinterleave);
   RUN_TEST(test_interleave);
   RUN_TEST(test_deinterleave_interleave);
+  RUN_TEST(test_deinterleave_matches_reference);
+  RUN_TEST(test_interleave_matches_reference);
   RUN_TEST(test_encode_input_state);
   RUN_TEST(test_encode_origin);
   RUN_TEST(test_decode_input_state);
   RUN_TEST(test_decode_origin);
+  RUN_TEST(test_decode_gc_state_input_state);
+  RUN_TEST(test_decode_gc_state_origin);
+  RUN_TEST(test_decode_gc_state_matches_reference);
   RUN_TEST(test_decode_single_error);
   RUN_TEST(test_decode_burst_error);
   RUN_TEST(test_decode_failure);
   RUN_TEST(test_decode_crc_mismatch);
   RUN_TEST(test_encode_decode);
+  RUN_TEST(test_encode_decode_random);
+  RUN_TEST(test_encode_custom_crc_fn);
+  RUN_TEST(test_decode_recovery);
+  RUN_TEST(test_decode_recovery_two_failed_codewords);
+  RUN_TEST(test_decode_header);
+  RUN_TEST(test_decode_buttons);
+  RUN_TEST(test_decode_history_repair);
+  RUN_TEST(test_decode_history_repair_changed_codeword);
+  RUN_TEST(test_decode_ex_clean);
+  RUN_TEST(test_decode_ex_corrected);
+  RUN_TEST(test_decode_ex_failure);
+  RUN_TEST(test_decode_ex_crc_mismatch);
+  RUN_TEST(test_decode_soft_clean);
+  RUN_TEST(test_decode_soft_weak_bits);
+  RUN_TEST(test_decode_soft_awgn);
 }
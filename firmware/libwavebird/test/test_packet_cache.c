@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/packet.h"
+#include "wavebird/packet_cache.h"
+
+#include "fixtures.h"
+
+// Encode a message, and decode it into the controller state to cache
+static void encode_state(uint8_t *packet, wavebird_gc_state_t *state, const uint8_t *message)
+{
+  wavebird_packet_encode(packet, message);
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(state, packet));
+}
+
+static void test_cache_miss_when_empty()
+{
+  wavebird_packet_cache_t cache;
+  wavebird_packet_cache_init(&cache);
+
+  wavebird_gc_state_t state;
+  TEST_ASSERT_FALSE(wavebird_packet_cache_lookup(&cache, &state, packet_input_state_resting));
+  TEST_ASSERT_EQUAL_UINT32(0, cache.hits);
+  TEST_ASSERT_EQUAL_UINT32(1, cache.misses);
+}
+
+static void test_cache_hit()
+{
+  wavebird_gc_state_t input_state, origin;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&input_state, packet_input_state_resting));
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&origin, packet_origin));
+
+  wavebird_packet_cache_t cache;
+  wavebird_packet_cache_init(&cache);
+  wavebird_packet_cache_store(&cache, packet_input_state_resting, &input_state);
+  wavebird_packet_cache_store(&cache, packet_origin, &origin);
+
+  wavebird_gc_state_t state = {0};
+  TEST_ASSERT_TRUE(wavebird_packet_cache_lookup(&cache, &state, packet_input_state_resting));
+  TEST_ASSERT_EQUAL_MEMORY(&input_state, &state, sizeof(state));
+
+  TEST_ASSERT_TRUE(wavebird_packet_cache_lookup(&cache, &state, packet_origin));
+  TEST_ASSERT_EQUAL_MEMORY(&origin, &state, sizeof(state));
+
+  TEST_ASSERT_EQUAL_UINT32(2, cache.hits);
+  TEST_ASSERT_EQUAL_UINT32(0, cache.misses);
+}
+
+static void test_cache_miss_on_changed_packet()
+{
+  wavebird_gc_state_t state;
+  TEST_ASSERT_EQUAL(0, wavebird_packet_decode_gc_state(&state, packet_input_state_resting));
+
+  wavebird_packet_cache_t cache;
+  wavebird_packet_cache_init(&cache);
+  wavebird_packet_cache_store(&cache, packet_input_state_resting, &state);
+
+  // Any difference, even one which would be corrected by decoding, must miss
+  uint8_t packet[WAVEBIRD_PACKET_BYTES];
+  for (int i = 0; i < WAVEBIRD_PACKET_BITS; i++) {
+    memcpy(packet, packet_input_state_resting, WAVEBIRD_PACKET_BYTES);
+    packet[i / 8] ^= 1 << (7 - i % 8);
+    TEST_ASSERT_FALSE(wavebird_packet_cache_lookup(&cache, &state, packet));
+  }
+}
+
+static void test_cache_replaces_same_controller()
+{
+  wavebird_packet_cache_t cache;
+  wavebird_packet_cache_init(&cache);
+
+  // Store a few input states from the same controller
+  uint8_t packets[3][WAVEBIRD_PACKET_BYTES];
+  wavebird_gc_state_t states[3];
+  for (int i = 0; i < 3; i++) {
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    memcpy(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES);
+    message[WAVEBIRD_MESSAGE_BYTES - 2] ^= i;
+    encode_state(packets[i], &states[i], message);
+    wavebird_packet_cache_store(&cache, packets[i], &states[i]);
+  }
+
+  // Only the latest one should be remembered
+  wavebird_gc_state_t state;
+  TEST_ASSERT_FALSE(wavebird_packet_cache_lookup(&cache, &state, packets[0]));
+  TEST_ASSERT_FALSE(wavebird_packet_cache_lookup(&cache, &state, packets[1]));
+  TEST_ASSERT_TRUE(wavebird_packet_cache_lookup(&cache, &state, packets[2]));
+  TEST_ASSERT_EQUAL_MEMORY(&states[2], &state, sizeof(state));
+}
+
+static void test_cache_evicts_oldest()
+{
+  wavebird_packet_cache_t cache;
+  wavebird_packet_cache_init(&cache);
+
+  // Store input states from more controllers than the cache can hold
+  uint8_t packets[WAVEBIRD_PACKET_CACHE_ENTRIES + 1][WAVEBIRD_PACKET_BYTES];
+  wavebird_gc_state_t state;
+  for (int i = 0; i <= WAVEBIRD_PACKET_CACHE_ENTRIES; i++) {
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    memcpy(message, message_input_state_resting, WAVEBIRD_MESSAGE_BYTES);
+    message[2] ^= (i + 1) << 4;
+    encode_state(packets[i], &state, message);
+    wavebird_packet_cache_store(&cache, packets[i], &state);
+  }
+
+  TEST_ASSERT_FALSE(wavebird_packet_cache_lookup(&cache, &state, packets[0]));
+  for (int i = 1; i <= WAVEBIRD_PACKET_CACHE_ENTRIES; i++)
+    TEST_ASSERT_TRUE(wavebird_packet_cache_lookup(&cache, &state, packets[i]));
+}
+
+void test_packet_cache(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_cache_miss_when_empty);
+  RUN_TEST(test_cache_hit);
+  RUN_TEST(test_cache_miss_on_changed_packet);
+  RUN_TEST(test_cache_replaces_same_controller);
+  RUN_TEST(test_cache_evicts_oldest);
+}
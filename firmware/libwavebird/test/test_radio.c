@@ -0,0 +1,387 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/radio.h"
+#include "wavebird/radio_sim.h"
+
+#define MAX_EVENTS  8192
+#define MAX_PACKETS 256
+
+// Time between packets from a controller
+#define PACKET_PERIOD_US 4000
+
+// Main loop period
+#define POLL_US 250
+
+static wavebird_radio_sim_event_t timeline[MAX_EVENTS];
+static size_t timeline_count;
+
+// Packets and errors passed to the callbacks
+static struct {
+  uint8_t packets[MAX_PACKETS][WAVEBIRD_PACKET_BYTES];
+  uint32_t times[MAX_PACKETS];
+  wavebird_radio_packet_info_t info[MAX_PACKETS];
+  int count;
+  int errors[MAX_PACKETS];
+  int error_count;
+  bool pairing_started;
+  bool pairing_finished;
+  uint8_t pairing_status;
+  uint8_t pairing_channel;
+  uint32_t pairing_time;
+} received;
+
+static void handle_packet(const uint8_t *packet)
+{
+  TEST_ASSERT_LESS_THAN(MAX_PACKETS, received.count);
+  memcpy(received.packets[received.count], packet, WAVEBIRD_PACKET_BYTES);
+  TEST_ASSERT_NOT_NULL(wavebird_radio_get_packet_info());
+  received.info[received.count]    = *wavebird_radio_get_packet_info();
+  received.times[received.count++] = wavebird_radio_sim_get_time();
+}
+
+static void handle_error(int error)
+{
+  TEST_ASSERT_LESS_THAN(MAX_PACKETS, received.error_count);
+  received.errors[received.error_count++] = error;
+}
+
+static void handle_pairing_started(void)
+{
+  received.pairing_started = true;
+}
+
+static void handle_pairing_finished(uint8_t status, uint8_t channel)
+{
+  received.pairing_finished = true;
+  received.pairing_status   = status;
+  received.pairing_channel  = channel;
+  received.pairing_time     = wavebird_radio_sim_get_time();
+}
+
+// Only qualify packets starting with 0xA0, from the controller being paired
+static bool qualify_packet(const uint8_t *packet)
+{
+  return packet[0] == 0xA0;
+}
+
+// Reset the simulation and the radio, listening on a channel
+static void start_radio(uint8_t channel)
+{
+  memset(&received, 0, sizeof(received));
+  timeline_count = 0;
+
+  wavebird_radio_sim_reset();
+  TEST_ASSERT_EQUAL(0, wavebird_radio_init(handle_packet, handle_error));
+  wavebird_radio_configure_qualification(qualify_packet, 5);
+  wavebird_radio_set_pairing_started_callback(handle_pairing_started);
+  wavebird_radio_set_pairing_finished_callback(handle_pairing_finished);
+  TEST_ASSERT_EQUAL(0, wavebird_radio_set_channel(channel));
+}
+
+// Add a controller's packets to the timeline, tagging each with the first byte and a sequence number
+static void add_controller(uint8_t channel, int8_t rssi, uint32_t start, int count, uint8_t tag)
+{
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_LESS_THAN(MAX_EVENTS, timeline_count);
+    wavebird_radio_sim_event_t *event = &timeline[timeline_count++];
+    event->time                       = start + i * PACKET_PERIOD_US;
+    event->type                       = WB_RADIO_SIM_PACKET;
+    event->channel                    = channel;
+    event->rssi                       = rssi;
+    event->packet[0]                  = tag;
+    event->packet[1]                  = i;
+    for (int b = 2; b < WAVEBIRD_PACKET_BYTES; b++)
+      event->packet[b] = channel * 16 + b;
+  }
+}
+
+static void add_event(uint32_t time, uint8_t type, uint8_t channel)
+{
+  TEST_ASSERT_LESS_THAN(MAX_EVENTS, timeline_count);
+  timeline[timeline_count++] = (wavebird_radio_sim_event_t){.time = time, .type = type, .channel = channel};
+}
+
+static int compare_events(const void *a, const void *b)
+{
+  const wavebird_radio_sim_event_t *x = a, *y = b;
+  return (x->time > y->time) - (x->time < y->time);
+}
+
+static void load_timeline(void)
+{
+  qsort(timeline, timeline_count, sizeof(timeline[0]), compare_events);
+  wavebird_radio_sim_set_timeline(timeline, timeline_count);
+}
+
+// Run the main loop for a while, or until pairing finishes
+static void run(uint32_t duration_us, bool until_paired)
+{
+  for (uint32_t t = 0; t < duration_us && !(until_paired && received.pairing_finished); t += POLL_US) {
+    wavebird_radio_sim_advance(POLL_US);
+    wavebird_radio_process();
+  }
+}
+
+// Count the packets which wrap around the end of the RX FIFO, of the first packets stored back to back in it
+static int wrapped_packets(int count)
+{
+  int wrapped = 0;
+  for (int i = 0; i < count; i++) {
+    int offset = (i * WAVEBIRD_PACKET_BYTES) % WAVEBIRD_RADIO_RX_FIFO_BYTES;
+    if (offset + WAVEBIRD_PACKET_BYTES > WAVEBIRD_RADIO_RX_FIFO_BYTES)
+      wrapped++;
+  }
+
+  return wrapped;
+}
+
+static void test_radio_active_rx()
+{
+  // Controllers on the selected channel and its neighbor
+  start_radio(5);
+  add_controller(5, -60, 1000, 50, 0xA0);
+  add_controller(6, -60, 2500, 50, 0xB0);
+  load_timeline();
+  run(50 * PACKET_PERIOD_US, false);
+
+  // Only the packets on the channel are received, in order, within a main loop period of arriving
+  TEST_ASSERT_EQUAL(50, received.count);
+  for (int i = 0; i < received.count; i++) {
+    TEST_ASSERT_EQUAL_HEX8(0xA0, received.packets[i][0]);
+    TEST_ASSERT_EQUAL(i, received.packets[i][1]);
+    uint32_t arrival = 1000 + i * PACKET_PERIOD_US + WAVEBIRD_RADIO_SIM_PACKET_US;
+    TEST_ASSERT_UINT32_WITHIN(POLL_US, arrival + POLL_US / 2, received.times[i]);
+
+    // Packets are timestamped as they arrive, with their strength and channel
+    TEST_ASSERT_EQUAL_UINT32(arrival, received.info[i].timestamp);
+    TEST_ASSERT_EQUAL(-60, received.info[i].rssi);
+    TEST_ASSERT_EQUAL(5, received.info[i].channel);
+  }
+  TEST_ASSERT_NULL(wavebird_radio_get_packet_info());
+
+  const wavebird_radio_sim_stats_t *stats = wavebird_radio_sim_get_stats();
+  TEST_ASSERT_EQUAL_UINT32(50, stats->packets_received);
+  TEST_ASSERT_EQUAL_UINT32(50, stats->packets_missed);
+  TEST_ASSERT_EQUAL(0, received.error_count);
+  TEST_ASSERT_EQUAL(5, wavebird_radio_get_channel());
+
+  // Packets are decoded in place, unless they wrap around the end of the FIFO
+  wavebird_radio_stats_t radio_stats;
+  wavebird_radio_get_stats(&radio_stats);
+  TEST_ASSERT_EQUAL_UINT32(50, radio_stats.packets);
+  TEST_ASSERT_EQUAL_UINT32(wrapped_packets(50), radio_stats.copied_packets);
+  TEST_ASSERT_EQUAL_UINT32(0, radio_stats.fifo_overflows);
+  TEST_ASSERT_EQUAL_UINT32(1, radio_stats.max_pending);
+  TEST_ASSERT_EQUAL(5, wavebird_radio_sim_get_channel());
+}
+
+static void test_radio_fifo_overflow()
+{
+  int fifo_packets = WAVEBIRD_RADIO_RX_FIFO_BYTES / WAVEBIRD_PACKET_BYTES;
+  int stalled      = fifo_packets + 4;
+
+  start_radio(2);
+  add_controller(2, -60, 1000, stalled + 30, 0xA0);
+  load_timeline();
+
+  // A main loop which stalls for longer than the FIFO can hold loses the packets which don't fit
+  wavebird_radio_sim_advance(stalled * PACKET_PERIOD_US);
+  const wavebird_radio_sim_stats_t *stats = wavebird_radio_sim_get_stats();
+  TEST_ASSERT_EQUAL_UINT32(fifo_packets, stats->packets_received);
+  TEST_ASSERT_EQUAL_UINT32(4, stats->fifo_overflows);
+
+  // Packets wrap around the end of the FIFO once it has been drained
+  run(30 * PACKET_PERIOD_US, false);
+  TEST_ASSERT_EQUAL(fifo_packets + 30, received.count);
+  for (int i = 0; i < received.count; i++) {
+    int sequence = i < fifo_packets ? i : i + 4;
+    TEST_ASSERT_EQUAL(sequence, received.packets[i][1]);
+    TEST_ASSERT_EQUAL_HEX8(2 * 16 + WAVEBIRD_PACKET_BYTES - 1, received.packets[i][WAVEBIRD_PACKET_BYTES - 1]);
+  }
+
+  // Every overflow is reported, and counted with how far the main loop fell behind
+  TEST_ASSERT_EQUAL(4, received.error_count);
+  for (int i = 0; i < received.error_count; i++)
+    TEST_ASSERT_EQUAL(-WB_RADIO_ERR_RX_OVERFLOW, received.errors[i]);
+
+  // Packets which waited in the FIFO keep the time they arrived
+  for (int i = 0; i < fifo_packets; i++) {
+    uint32_t arrival = 1000 + i * PACKET_PERIOD_US + WAVEBIRD_RADIO_SIM_PACKET_US;
+    TEST_ASSERT_EQUAL_UINT32(arrival, received.info[i].timestamp);
+  }
+
+  wavebird_radio_stats_t radio_stats;
+  wavebird_radio_get_stats(&radio_stats);
+  TEST_ASSERT_EQUAL_UINT32(fifo_packets + 30, radio_stats.packets);
+  TEST_ASSERT_EQUAL_UINT32(wrapped_packets(fifo_packets + 30), radio_stats.copied_packets);
+  TEST_ASSERT_EQUAL_UINT32(4, radio_stats.fifo_overflows);
+  TEST_ASSERT_EQUAL_UINT32(fifo_packets, radio_stats.max_pending);
+  TEST_ASSERT_EQUAL_UINT32(0, radio_stats.dropped_packets);
+}
+
+static void test_radio_errors()
+{
+  start_radio(1);
+  add_event(1000, WB_RADIO_SIM_RX_ERROR, 1);
+  add_event(2000, WB_RADIO_SIM_RX_ERROR, 4);
+  add_event(3000, WB_RADIO_SIM_CALIBRATION, 0);
+  add_event(4000, WB_RADIO_SIM_CALIBRATION_ERROR, 0);
+  add_event(5000, WB_RADIO_SIM_SYNC_WORD, 1);
+  load_timeline();
+  run(10000, false);
+
+  // RX errors on other channels aren't heard, and successful calibrations aren't errors
+  TEST_ASSERT_EQUAL(3, received.error_count);
+  TEST_ASSERT_EQUAL(-WB_RADIO_ERR_NO_PACKET, received.errors[0]);
+  TEST_ASSERT_EQUAL(-WB_RADIO_ERR_CALIBRATION, received.errors[1]);
+  TEST_ASSERT_EQUAL(-WB_RADIO_ERR_NO_PACKET, received.errors[2]);
+  TEST_ASSERT_EQUAL_UINT32(2, wavebird_radio_sim_get_stats()->calibrations);
+  TEST_ASSERT_EQUAL_UINT32(2, wavebird_radio_sim_get_stats()->rx_errors);
+
+  wavebird_radio_stats_t radio_stats;
+  wavebird_radio_get_stats(&radio_stats);
+  TEST_ASSERT_EQUAL_UINT32(2, radio_stats.rx_errors);
+}
+
+static void test_radio_error_queue()
+{
+  // More errors than can be queued before the main loop runs
+  start_radio(3);
+  for (int i = 0; i < 12; i++)
+    add_event(1000 + i * 10, WB_RADIO_SIM_RX_ERROR, 3);
+  add_event(1200, WB_RADIO_SIM_CALIBRATION_ERROR, 0);
+  add_event(3000, WB_RADIO_SIM_CALIBRATION_ERROR, 0);
+  load_timeline();
+  wavebird_radio_sim_advance(2000);
+
+  // Errors are reported in order, up to the queue size, and the rest are counted
+  wavebird_radio_process();
+  TEST_ASSERT_EQUAL(8, received.error_count);
+  for (int i = 0; i < received.error_count; i++)
+    TEST_ASSERT_EQUAL(-WB_RADIO_ERR_NO_PACKET, received.errors[i]);
+
+  wavebird_radio_stats_t radio_stats;
+  wavebird_radio_get_stats(&radio_stats);
+  TEST_ASSERT_EQUAL_UINT32(12, radio_stats.rx_errors);
+  TEST_ASSERT_EQUAL_UINT32(5, radio_stats.error_overflows);
+
+  // Once the queue has been emptied, errors are queued again
+  run(2000, false);
+  TEST_ASSERT_EQUAL(9, received.error_count);
+  TEST_ASSERT_EQUAL(-WB_RADIO_ERR_CALIBRATION, received.errors[8]);
+}
+
+static void test_radio_pairing()
+{
+  // A neighbor's controller on channel 2, which doesn't qualify, and the controller being paired on channel 11
+  start_radio(0);
+  add_controller(2, -70, 500, 500, 0xB0);
+  add_controller(11, -40, 1700, 500, 0xA0);
+  load_timeline();
+
+  wavebird_radio_start_pairing();
+  TEST_ASSERT_TRUE(received.pairing_started);
+  run(2000000, true);
+
+  TEST_ASSERT_TRUE(received.pairing_finished);
+  TEST_ASSERT_EQUAL(WB_RADIO_PAIRING_SUCCESS, received.pairing_status);
+  TEST_ASSERT_EQUAL(11, received.pairing_channel);
+  TEST_ASSERT_EQUAL(11, wavebird_radio_get_channel());
+  TEST_ASSERT_EQUAL(11, wavebird_radio_sim_get_channel());
+  TEST_ASSERT_EQUAL(0, received.count);
+
+  // The controller being paired is close by, so it's qualified as soon as it's heard
+  TEST_ASSERT_LESS_THAN(12 * 5000 + 6 * PACKET_PERIOD_US, received.pairing_time);
+
+  // The controller's packets are received once paired
+  run(10 * PACKET_PERIOD_US, false);
+  TEST_ASSERT_GREATER_OR_EQUAL(9, received.count);
+  for (int i = 0; i < received.count; i++)
+    TEST_ASSERT_EQUAL_HEX8(0xA0, received.packets[i][0]);
+}
+
+static void test_radio_pairing_ranked()
+{
+  // A weak neighbor's controller, and the controller being paired across the room, neither close enough to qualify
+  // straight away
+  start_radio(0);
+  add_controller(3, -85, 300, 500, 0xB0);
+  add_controller(9, -65, 2100, 500, 0xA0);
+  add_controller(14, -75, 3500, 500, 0xB0);
+  load_timeline();
+
+  wavebird_radio_start_pairing();
+  run(2000000, true);
+  TEST_ASSERT_EQUAL(WB_RADIO_PAIRING_SUCCESS, received.pairing_status);
+  TEST_ASSERT_EQUAL(9, received.pairing_channel);
+
+  // The strongest channel is qualified first, after a single scan of every channel
+  TEST_ASSERT_LESS_THAN(16 * (5000 + POLL_US) + 6 * PACKET_PERIOD_US, received.pairing_time);
+}
+
+static void test_radio_pairing_last_channel()
+{
+  // The controller being paired is weak, but on the channel last paired to
+  start_radio(13);
+  add_controller(2, -40, 300, 500, 0xB0);
+  add_controller(13, -80, 1100, 500, 0xA0);
+  load_timeline();
+
+  wavebird_radio_start_pairing();
+  run(2000000, true);
+  TEST_ASSERT_EQUAL(WB_RADIO_PAIRING_SUCCESS, received.pairing_status);
+  TEST_ASSERT_EQUAL(13, received.pairing_channel);
+  TEST_ASSERT_LESS_THAN(7 * PACKET_PERIOD_US, received.pairing_time);
+}
+
+static void test_radio_pairing_timeout()
+{
+  // Nothing but the neighbor's controller
+  start_radio(7);
+  add_controller(3, -70, 500, 8000, 0xB0);
+  load_timeline();
+
+  wavebird_radio_start_pairing();
+  run(40000000, true);
+
+  TEST_ASSERT_TRUE(received.pairing_finished);
+  TEST_ASSERT_EQUAL(WB_RADIO_PAIRING_TIMEOUT, received.pairing_status);
+  TEST_ASSERT_EQUAL(7, received.pairing_channel);
+
+  // The timeout is only checked while scanning, so it can be late by up to a hold on the neighbor's channel
+  TEST_ASSERT_GREATER_THAN(30000000, received.pairing_time);
+  TEST_ASSERT_LESS_OR_EQUAL(30000000 + 200000 + POLL_US, received.pairing_time);
+  TEST_ASSERT_EQUAL(7, wavebird_radio_sim_get_channel());
+}
+
+static void test_radio_pairing_cancelled()
+{
+  start_radio(4);
+  wavebird_radio_start_pairing();
+  run(100000, false);
+  TEST_ASSERT_FALSE(received.pairing_finished);
+
+  wavebird_radio_stop_pairing();
+  TEST_ASSERT_TRUE(received.pairing_finished);
+  TEST_ASSERT_EQUAL(WB_RADIO_PAIRING_CANCELLED, received.pairing_status);
+  TEST_ASSERT_EQUAL(4, received.pairing_channel);
+  TEST_ASSERT_EQUAL(4, wavebird_radio_sim_get_channel());
+}
+
+void test_radio(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_radio_active_rx);
+  RUN_TEST(test_radio_fifo_overflow);
+  RUN_TEST(test_radio_errors);
+  RUN_TEST(test_radio_error_queue);
+  RUN_TEST(test_radio_pairing);
+  RUN_TEST(test_radio_pairing_ranked);
+  RUN_TEST(test_radio_pairing_last_channel);
+  RUN_TEST(test_radio_pairing_timeout);
+  RUN_TEST(test_radio_pairing_cancelled);
+}
@@ -7,8 +7,10 @@
 
 #include "si/commands.h"
 #include "si/device/gc_controller.h"
+#include "wavebird/demux.h"
 #include "wavebird/message.h"
 #include "wavebird/packet.h"
+#include "wavebird/packet_cache.h"
 #include "wavebird/radio.h"
 
 #include "button.h"
@@ -22,6 +24,15 @@
 
 #define INPUT_VALID_MS 100
 
+// Candidates to check when recovering a packet with an uncorrectable codeword, ~8 covers almost every case
+#define PACKET_RECOVERY_BUDGET 8
+
+// Stop tracking controllers which haven't sent a packet for this long
+#define CONTROLLER_TIMEOUT_MS 1000
+
+// Controller to pin to when emulating wireless ID pinning with wired controllers, see WB_DEMUX_SELECT_*
+#define PIN_SELECT_POLICY WB_DEMUX_SELECT_FIRST_SEEN
+
 // Controller types
 typedef enum {
   // Present as an OEM WaveBird receiver
@@ -73,9 +84,18 @@ struct {
   uint8_t packets;
   uint8_t radio_errors;
   uint8_t decode_errors;
-  uint8_t _reserved;
+  uint8_t rescued;
+  uint8_t repaired;
+  uint16_t corrected_bits; // Bit errors corrected by FEC, for estimating the pre-FEC bit error rate
+  uint32_t max_latency_us; // Longest time from an input state arriving over the air to being ready for SI
 } packet_stats = {0};
 
+// Recently decoded packets, so repeated packets from idle controllers skip decoding
+static wavebird_packet_cache_t packet_cache;
+
+// Controllers seen on the current channel
+static wavebird_demux_t demux;
+
 // SI state
 static struct si_device_gc_controller si_device = {0};
 static bool enable_si_command_handling          = true;
@@ -91,6 +111,9 @@ static bool pairing_active = false;
 // Current settings
 static wp_settings_t settings;
 
+// Wireless ID of the controller chosen by PIN_SELECT_POLICY, for emulating wireless ID pinning with wired controllers
+static uint16_t pinned_id = 0;
+
 // Stale inpute validation
 static uint32_t input_valid_until = 0;
 
@@ -142,25 +165,68 @@ static void handle_channel_wheel_change(struct channel_wheel *channel_wheel, uin
 }
 #endif
 
+// Get the wireless ID packets are pinned to, or -1 if packets from any controller are accepted
+static int get_pinned_wireless_id(void)
+{
+  if (!settings.pin_id)
+    return -1;
+
+  if (settings.cont_type == WP_CONT_TYPE_GC_WAVEBIRD)
+    return si_device_gc_wireless_id_fixed(&si_device) ? si_device_gc_get_wireless_id(&si_device) : -1;
+
+  return pinned_id != 0 ? pinned_id : -1;
+}
+
 // Handle packets from the WaveBird radio
 static void handle_wavebird_packet(const uint8_t *packet)
 {
   // Update packet stats
   packet_stats.packets++;
 
-  // Decode the WaveBird packet
-  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
-  int rc = wavebird_packet_decode(message, packet);
-  if (rc < 0) {
-    // DEBUG_PRINT("Failed to decode WaveBird packet: %d\n", rcode);
-    packet_stats.decode_errors++;
-    return;
+  // Decode the WaveBird packet, unless it is a repeat of a recently decoded one
+  wavebird_gc_state_t state;
+  if (wavebird_packet_cache_lookup(&packet_cache, &state, packet)) {
+    // Track the controller, its link quality was counted when the packet was first decoded
+    wavebird_demux_update(&demux, &state, NULL, millis);
+  } else {
+    // Drop packets from other controllers after decoding just the header, if the wireless ID is pinned
+    int pinned_wireless_id = get_pinned_wireless_id();
+    uint16_t header;
+    if (pinned_wireless_id >= 0 && wavebird_packet_decode_header(&header, packet) == 0 &&
+        (header & WB_MESSAGE_HEADER_CONTROLLER_ID) != pinned_wireless_id) {
+      // Still track the other controller's activity on the channel
+      wavebird_demux_touch(&demux, header, millis);
+      return;
+    }
+
+    wavebird_decode_result_t result;
+    int rc = wavebird_packet_decode_gc_state_ex(&state, &result, packet);
+
+    // Count corrected bit errors, even in packets which were dropped
+    packet_stats.corrected_bits += result.corrected_bits;
+
+    if (rc < 0) {
+      // DEBUG_PRINT("Failed to decode WaveBird packet: %d\n", rcode);
+      packet_stats.decode_errors++;
+      return;
+    }
+
+    // Count packets rescued by CRC-guided recovery
+    if (rc == WB_PACKET_RESCUED)
+      packet_stats.rescued++;
+
+    // Count packets repaired from the previous packets
+    if (rc == WB_PACKET_REPAIRED)
+      packet_stats.repaired++;
+
+    wavebird_packet_cache_store(&packet_cache, packet, &state);
+    wavebird_demux_update(&demux, &state, &result, millis);
   }
 
   // Handle wireless ID pinning, if enabled
   if (settings.pin_id) {
     // Get the controller ID from the packet
-    uint16_t wireless_id = wavebird_message_get_controller_id(message);
+    uint16_t wireless_id = wavebird_gc_state_get_controller_id(&state);
 
     // Check the controller id is as expected
     if (settings.cont_type == WP_CONT_TYPE_GC_WAVEBIRD) {
@@ -175,14 +241,14 @@ static void handle_wavebird_packet(const uint8_t *packet)
       }
     } else {
       // Emulate wireless ID pinning for wired controllers
-      static uint16_t first_seen_id = 0;
-      if (first_seen_id == 0) {
-        // Set the first seen ID
-        first_seen_id = wireless_id;
-      } else if (first_seen_id != wireless_id) {
-        // Drop packets from other controllers
-        return;
+      if (pinned_id == 0) {
+        // Pin to the controller chosen by policy
+        pinned_id = wavebird_demux_select(&demux, PIN_SELECT_POLICY)->controller_id;
       }
+
+      // Drop packets from other controllers
+      if (pinned_id != wireless_id)
+        return;
     }
   }
 
@@ -191,7 +257,7 @@ static void handle_wavebird_packet(const uint8_t *packet)
     led_effect_blink(status_led, INPUT_VALID_MS, 1);
 
   // Handle the packet
-  if (wavebird_message_get_type(message) == WB_MESSAGE_TYPE_INPUT_STATE) {
+  if (wavebird_gc_state_get_type(&state) == WB_MESSAGE_TYPE_INPUT_STATE) {
     //
     // Handle input state packets
     //
@@ -200,12 +266,12 @@ static void handle_wavebird_packet(const uint8_t *packet)
     si_device.input.buttons.bytes[0] &= ~0x1F;
     si_device.input.buttons.bytes[1] &= ~0x7F;
 
-    // Copy the buttons from the WaveBird message
-    si_device.input.buttons.bytes[0] |= (message[3] & 0x80) >> 7 | (message[2] & 0x0F) << 1;
-    si_device.input.buttons.bytes[1] |= (message[3] & 0x7F);
+    // Copy the buttons, they are already in SI order
+    si_device.input.buttons.bytes[0] |= state.buttons[0];
+    si_device.input.buttons.bytes[1] |= state.buttons[1];
 
     // Copy the stick, substick, and trigger values
-    memcpy(&si_device.input.stick_x, &message[4], 6);
+    memcpy(&si_device.input.stick_x, state.analog, 6);
 
     // We have a good input state, enable SI command handling if it was disabled
     enable_si_command_handling = true;
@@ -213,22 +279,20 @@ static void handle_wavebird_packet(const uint8_t *packet)
     // Set the input state as valid
     input_valid_until = millis + INPUT_VALID_MS;
     si_device_set_input_valid(&si_device, true);
+
+    // Track how long the input state took to reach SI since it arrived
+    uint32_t latency = wavebird_radio_get_time() - wavebird_radio_get_packet_info()->timestamp;
+    if (latency > packet_stats.max_latency_us)
+      packet_stats.max_latency_us = latency;
   } else {
     //
     // Handle origin packets
     //
 
-    // Copy the origin values from the packet
-    uint8_t new_origin[] = {
-        wavebird_origin_get_stick_x(message),      wavebird_origin_get_stick_y(message),
-        wavebird_origin_get_substick_x(message),   wavebird_origin_get_substick_y(message),
-        wavebird_origin_get_trigger_left(message), wavebird_origin_get_trigger_right(message),
-    };
-
     // Check if the origin packet is different from the last known origin
-    if (memcmp(&si_device.origin.stick_x, new_origin, 6) != 0) {
+    if (memcmp(&si_device.origin.stick_x, state.analog, 6) != 0) {
       // Update the origin state
-      memcpy(&si_device.origin.stick_x, new_origin, 6);
+      memcpy(&si_device.origin.stick_x, state.analog, 6);
 
       // Set the "need origin" flag to true so the host knows to fetch the new origin
       si_device.input.buttons.need_origin = true;
@@ -303,15 +367,18 @@ static void handle_pairing_finished(uint8_t status, uint8_t channel)
 // Qualify a WaveBird packet during pairing
 static bool qualify_packet(const uint8_t *packet)
 {
-  // Decode the packet into an input state
-  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
-  int rc = wavebird_packet_decode(message, packet);
-  if (rc < 0 || wavebird_message_get_type(message) != WB_MESSAGE_TYPE_INPUT_STATE)
+  // Decode just the header and buttons of the packet
+  uint16_t header, buttons;
+  if (wavebird_packet_decode_buttons(&header, &buttons, packet) < 0 || (header & WB_MESSAGE_HEADER_ORIGIN))
     return false;
 
   // Check for a specific key combination
-  uint16_t buttons = wavebird_input_state_get_buttons(message);
-  return (buttons & settings.pair_btns) == settings.pair_btns;
+  if ((buttons & settings.pair_btns) != settings.pair_btns)
+    return false;
+
+  // Verify the whole packet before accepting it
+  uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+  return wavebird_packet_decode(message, packet) >= 0;
 }
 
 void system_init(void)
@@ -394,6 +461,14 @@ int main(void)
   // Initialize persistent settings
   settings_init(&settings, sizeof(wp_settings_t), SETTINGS_SIGNATURE, &DEFAULT_SETTINGS);
 
+#if ENABLE_PACKET_RECOVERY
+  // Enable recovery of packets with a single uncorrectable codeword, and repair from the previous packets
+  wavebird_packet_set_recovery_budget(PACKET_RECOVERY_BUDGET);
+  wavebird_packet_set_history_repair(true);
+#endif
+  wavebird_packet_cache_init(&packet_cache);
+  wavebird_demux_init(&demux);
+
   // Initialize and configure the WaveBird radio
   wavebird_radio_configure_qualification(qualify_packet, 5);
   wavebird_radio_set_pairing_started_callback(handle_pairing_started);
@@ -443,5 +518,8 @@ int main(void)
     // Invalidate stale inputs
     if (si_device.input_valid && (int32_t)(millis - input_valid_until) >= 0)
       si_device_set_input_valid(&si_device, false);
+
+    // Stop tracking controllers which have gone quiet
+    wavebird_demux_expire(&demux, millis, CONTROLLER_TIMEOUT_MS);
   }
 }
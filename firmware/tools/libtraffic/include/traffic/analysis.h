@@ -0,0 +1,90 @@
+/**
+ * Capture analysis.
+ *
+ * Decodes every packet in a capture, and collects per-controller statistics
+ * for investigating dropouts: packet rates, decode and CRC failure rates,
+ * corrected bit histograms, gaps between decoded packets, and how often the
+ * controller's input state changes.
+ *
+ * Captures are split into one contiguous range of records per thread. Each
+ * thread collects statistics for its own range, which are then merged in
+ * order, joining up the gaps and input changes across range boundaries, so
+ * the results are identical for any number of threads.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wavebird/message.h"
+
+#include "traffic/capture.h"
+
+// Number of controller IDs
+#define ANALYSIS_CONTROLLERS (WB_MESSAGE_HEADER_CONTROLLER_ID + 1)
+
+// Corrected bit histogram bins, 0 to 7 corrected bits and then 8 or more
+#define ANALYSIS_BIT_BINS 9
+
+// Gap histogram bins, in packet periods: 1 (no loss), 2, 3-4, 5-8, 9-250, and over 1 second
+#define ANALYSIS_GAP_BINS 6
+
+/**
+ * Statistics for one controller.
+ *
+ * Packets which fail to decode are attributed to a controller if their header
+ * codeword could still be decoded.
+ */
+struct analysis_controller {
+  uint64_t packets;                           // Packets decoded
+  uint64_t origins;                           // Origin packets decoded
+  uint64_t crc_failures;                      // Packets with a CRC mismatch
+  uint64_t decode_failures;                   // Packets with an uncorrectable codeword
+  uint64_t corrected_bits[ANALYSIS_BIT_BINS]; // Decoded packets by the number of bits corrected
+  uint64_t gaps[ANALYSIS_GAP_BINS];           // Gaps between decoded packets, see ANALYSIS_GAP_BINS
+  uint64_t max_gap_us;                        // Longest gap between decoded packets
+  uint64_t input_changes;                     // Input state packets which differ from the previous one
+  uint64_t first_us;                          // Timestamp of the first decoded packet
+  uint64_t last_us;                           // Timestamp of the last decoded packet
+  bool has_input;                             // Set once an input state packet has been decoded
+  wavebird_gc_state_t first_input;            // First input state, for joining ranges
+  wavebird_gc_state_t last_input;             // Last input state
+};
+
+/**
+ * Capture analysis results.
+ */
+struct analysis {
+  struct analysis_controller controllers[ANALYSIS_CONTROLLERS];
+  uint64_t records;                           // Records analyzed
+  uint64_t decoded;                           // Packets decoded
+  uint64_t crc_failures;                      // Packets with a CRC mismatch
+  uint64_t decode_failures;                   // Packets with an uncorrectable codeword
+  uint64_t unattributed;                      // Failed packets whose controller could not be identified
+  uint64_t corrected_bits[ANALYSIS_BIT_BINS]; // Decoded packets by the number of bits corrected
+  uint64_t first_us;                          // Timestamp of the first record
+  uint64_t last_us;                           // Timestamp of the last record
+};
+
+/**
+ * Analyze a capture.
+ *
+ * @param analysis buffer to store the results in
+ * @param records the capture records, in timestamp order
+ * @param count the number of records
+ * @param threads the number of threads to decode with
+ *
+ * @return 0 on success, -1 if the threads or their results could not be allocated
+ */
+int analysis_run(struct analysis *analysis, const struct capture_record *records, size_t count, int threads);
+
+/**
+ * Get the lower bound of a gap histogram bin.
+ *
+ * @param bin the bin
+ *
+ * @return the shortest gap in the bin, in packet periods
+ */
+uint32_t analysis_gap_bin_start(int bin);
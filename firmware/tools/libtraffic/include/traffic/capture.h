@@ -0,0 +1,79 @@
+/**
+ * WaveBird packet capture files.
+ *
+ * A capture file is a short header followed by fixed-size records, one per
+ * packet received. Fixed-size records keep files simple to generate, and let
+ * tools seek to or split on any record without parsing the ones before it.
+ *
+ * All fields are stored in host byte order, captures are only expected to be
+ * processed on little-endian hosts.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "wavebird/packet.h"
+
+// "WBCP" when read as bytes
+#define CAPTURE_MAGIC   0x50434257
+#define CAPTURE_VERSION 1
+
+// Record flags
+#define CAPTURE_FLAG_SYNTHETIC (1 << 0) // Generated by a channel model, bit_errors is known
+#define CAPTURE_FLAG_COLLISION (1 << 1) // Overlapped with a co-channel transmission
+
+/**
+ * Capture file header.
+ */
+struct capture_header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+};
+
+/**
+ * Captured packet.
+ */
+struct capture_record {
+  uint64_t timestamp_us;                 // Time the packet was received
+  uint8_t channel;                       // 0-indexed WaveBird channel
+  int8_t rssi;                           // Received signal strength, in dBm, or dBFS for surveyed packets
+  uint8_t flags;                         // See CAPTURE_FLAG_*
+  uint8_t bit_errors;                    // Bit errors in the packet, if CAPTURE_FLAG_SYNTHETIC is set
+  uint8_t packet[WAVEBIRD_PACKET_BYTES]; // The 19-byte packet from the radio
+  uint8_t reserved;                      // Must be 0
+};
+
+_Static_assert(sizeof(struct capture_record) == 32, "capture records must be 32 bytes");
+
+/**
+ * Write a capture file header.
+ *
+ * @param file the file to write to
+ *
+ * @return 0 on success, -1 on failure
+ */
+int capture_write_header(FILE *file);
+
+/**
+ * Write records to a capture file.
+ *
+ * @param file the file to write to
+ * @param records the records to write
+ * @param count the number of records
+ *
+ * @return 0 on success, -1 on failure
+ */
+int capture_write_records(FILE *file, const struct capture_record *records, size_t count);
+
+/**
+ * Check a capture file header is one this version of the format can read.
+ *
+ * @param header the header read from the start of the file
+ *
+ * @return 0 if the header is valid, -1 otherwise
+ */
+int capture_check_header(const struct capture_header *header);
@@ -0,0 +1,103 @@
+/**
+ * Polyphase filter bank channelizer.
+ *
+ * Splits a wideband IQ recording into evenly spaced channels, each mixed down
+ * to baseband, low-pass filtered and decimated, for surveying every WaveBird
+ * channel at once from a single recording.
+ *
+ * The recording's sample rate is split into `bins` channels spaced by
+ * sample_rate / bins, with bin 0 at the recording's center frequency and bins
+ * above bins / 2 below it. Each channel is decimated by bins / 2, so its
+ * samples are at twice the channel spacing, and the low-pass filter can be
+ * wide enough to pass a whole WaveBird transmission, which is wider than the
+ * channel spacing.
+ *
+ * Each output frame is the polyphase partial sums of CHANNELIZER_TAPS_PER_BIN
+ * taps per bin, followed by an inverse FFT across the bins. Frames are worked
+ * out CHANNELIZER_BATCH at a time, with the filter loops running over the bins
+ * and the FFT butterflies running over the frames of the batch, so all the
+ * inner loops are fixed-length float loops the compiler can vectorize. Only
+ * the bins selected with channelizer_init() are copied out.
+ *
+ * Channel samples are only correct up to a constant phase offset per channel,
+ * which makes no difference to FSK demodulation.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Most bins supported
+#define CHANNELIZER_MAX_BINS 64
+
+// Prototype filter taps per bin
+#define CHANNELIZER_TAPS_PER_BIN 8
+
+// Most bins which can be selected for output
+#define CHANNELIZER_MAX_OUTPUTS 32
+
+// Frames worked out together
+#define CHANNELIZER_BATCH 8
+
+// Input samples kept, enough for the filter and a few batches at the most bins
+#define CHANNELIZER_HISTORY (CHANNELIZER_MAX_BINS * (CHANNELIZER_TAPS_PER_BIN + 4 * CHANNELIZER_BATCH))
+
+// Most frames one push of a number of input samples can produce, for sizing the output buffers
+#define CHANNELIZER_MAX_FRAMES(samples, bins) ((samples) / ((bins) / 2) + CHANNELIZER_BATCH)
+
+// Input sample formats
+enum {
+  CHANNELIZER_FORMAT_CS8,  // Interleaved signed 8-bit I and Q
+  CHANNELIZER_FORMAT_CS16, // Interleaved signed 16-bit I and Q, in host byte order
+};
+
+/**
+ * Channelizer state.
+ */
+struct channelizer {
+  float taps[CHANNELIZER_TAPS_PER_BIN][CHANNELIZER_MAX_BINS]; // Prototype filter, reversed, one row per tap of each bin
+  float history_re[CHANNELIZER_HISTORY];                      // Input samples, starting with the oldest the next frame uses
+  float history_im[CHANNELIZER_HISTORY];                      //
+  float twiddle_re[CHANNELIZER_MAX_BINS / 2];                 // FFT twiddle factors
+  float twiddle_im[CHANNELIZER_MAX_BINS / 2];                 //
+  uint8_t bit_reverse[CHANNELIZER_MAX_BINS];                  // FFT input order
+  uint8_t outputs[CHANNELIZER_MAX_OUTPUTS];                   // Bins to output, in output order
+  uint8_t output_count;                                       // Number of bins to output
+  uint8_t bins;                                               // Number of bins
+  uint8_t format;                                             // Input sample format, see CHANNELIZER_FORMAT_*
+  uint16_t fill;                                              // Samples in the history
+  uint64_t frames;                                            // Frames produced
+};
+
+/**
+ * Initialize a channelizer.
+ *
+ * @param channelizer the channelizer
+ * @param bins number of bins, a power of two from 4 to CHANNELIZER_MAX_BINS
+ * @param format input sample format, see CHANNELIZER_FORMAT_*
+ * @param outputs the bins to output, in order
+ * @param output_count number of bins to output, up to CHANNELIZER_MAX_OUTPUTS
+ *
+ * @return 0 on success, -1 if the number of bins or outputs is invalid
+ */
+int channelizer_init(struct channelizer *channelizer, int bins, uint8_t format, const uint8_t *outputs,
+                     int output_count);
+
+/**
+ * Push the next input samples, and produce channel samples.
+ *
+ * One frame is produced for every bins / 2 input samples, once a whole batch
+ * of frames is available. Pushing a multiple of CHANNELIZER_BATCH * bins / 2
+ * samples always produces the same number of frames.
+ *
+ * @param channelizer the channelizer
+ * @param re buffers to store the real part of each output's samples, CHANNELIZER_MAX_FRAMES(count, bins) entries
+ * @param im buffers to store the imaginary part of each output's samples
+ * @param samples the next input samples, in the channelizer's format
+ * @param count number of complex input samples
+ *
+ * @return the number of frames produced
+ */
+size_t channelizer_push(struct channelizer *channelizer, float *const *re, float *const *im, const void *samples,
+                        size_t count);
@@ -0,0 +1,89 @@
+/**
+ * WaveBird FSK demodulation and modulation.
+ *
+ * The demodulator turns one channel's baseband samples (see channelizer.h)
+ * into soft chips for the despreader (see wavebird/despread.h). Each sample's
+ * frequency is measured with a quadrature discriminator, Im(z[n] z*[n - 1])
+ * normalized by the power of the two samples, which is close to the sine of
+ * the phase step between them without working out any arctangents. The
+ * frequencies are then resampled to FSK_SAMPLES_PER_CHIP samples per chip by
+ * linear interpolation, at a ratio of whole numbers so the sample timing never
+ * drifts. A frequency above the channel's center is a 1 chip.
+ *
+ * The modulator adds a controller's transmission to wideband IQ samples, for
+ * generating synthetic recordings: the unmodulated carrier, then the preamble,
+ * sync word and packet spread with the DSSS code, with the frequency ramping
+ * linearly between the centers of each chip in place of the radio's Gaussian
+ * filter.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wavebird/packet.h"
+
+// Samples per chip the demodulator produces
+#define FSK_SAMPLES_PER_CHIP 2
+
+// Unmodulated carrier sent before each frame, in microseconds
+#define FSK_CARRIER_US 100
+
+// Bits in each frame, the preamble, sync word and packet
+#define FSK_FRAME_BITS (48 + WAVEBIRD_PACKET_BITS)
+
+/**
+ * Demodulator state.
+ */
+struct fsk_demodulator {
+  float last_re;        // Previous channel sample
+  float last_im;        //
+  float last_frequency; // Previous discriminator output
+  float scale;          // Chip sample per unit of discriminator output
+  uint32_t up;          // Resampling ratio, up chip samples for every down channel samples
+  uint32_t down;        //
+  uint32_t position;    // Position of the next chip sample after the previous channel sample, in 1/up samples
+  double energy;        // Total power of the channel samples pushed
+};
+
+/**
+ * Initialize a demodulator.
+ *
+ * @param demodulator the demodulator
+ * @param sample_rate the channel sample rate, in Hz, at least FSK_SAMPLES_PER_CHIP times the chip rate
+ *
+ * @return 0 on success, -1 if the sample rate is too low
+ */
+int fsk_demodulator_init(struct fsk_demodulator *demodulator, uint32_t sample_rate);
+
+/**
+ * Demodulate the next channel samples.
+ *
+ * @param demodulator the demodulator
+ * @param chips buffer to store the soft chips, count * up / down + 1 entries
+ * @param re the real part of the channel samples
+ * @param im the imaginary part of the channel samples
+ * @param count number of channel samples
+ *
+ * @return the number of chip samples produced
+ */
+size_t fsk_demodulate(struct fsk_demodulator *demodulator, int8_t *chips, const float *re, const float *im,
+                      size_t count);
+
+/**
+ * Add a WaveBird transmission to wideband IQ samples.
+ *
+ * Any part of the transmission outside the samples is left out.
+ *
+ * @param re the real part of the samples to add to
+ * @param im the imaginary part of the samples to add to
+ * @param count number of samples
+ * @param sample_rate the sample rate, in Hz
+ * @param offset the channel's frequency relative to the center of the samples, in Hz
+ * @param start the sample the carrier starts at
+ * @param packet the 19-byte packet to send
+ * @param amplitude the signal's amplitude
+ */
+void fsk_modulate(float *re, float *im, size_t count, uint32_t sample_rate, double offset, size_t start,
+                  const uint8_t *packet, float amplitude);
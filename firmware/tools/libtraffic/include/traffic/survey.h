@@ -0,0 +1,103 @@
+/**
+ * Wideband channel survey.
+ *
+ * Finds the packets on every WaveBird channel of a wideband IQ recording, for
+ * surveying all the controllers in a room from a single recording. The
+ * recording is split into one bin per channel index with a polyphase filter
+ * bank (see channelizer.h), and the bins of the 16 WaveBird channels are
+ * demodulated (see fsk.h), despread (see wavebird/despread.h) and searched
+ * for packets (see wavebird/bitstream.h).
+ *
+ * Recordings must be sampled at 32 or 64 times the channel spacing (76.8 or
+ * 153.6 MS/s), centered on a channel index's frequency, and cover all the
+ * WaveBird channels. At 76.8 MS/s, the only center which does is 2443.2 MHz,
+ * the frequency of channel index 16, which puts channel index 0 (WaveBird
+ * channel 3) right at the edge of the band, where most radios' anti-aliasing
+ * filters will weaken it.
+ *
+ * Recordings are processed in SURVEY_CHUNK_US chunks, and split into one
+ * contiguous range of chunks per thread. Each thread starts SURVEY_WARMUP_US
+ * before its range so a packet which straddles the boundary is received in
+ * full, runs a chunk past its end to flush the last bits through, and only
+ * keeps the packets whose last bit was despread inside its own range.
+ * Packets are timestamped with the end of the chunk their last bit was
+ * despread in, and sorted by timestamp then channel, so the results don't
+ * depend on the number of threads, as long as each thread's receivers settle
+ * during the warm up.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wavebird/radio.h"
+
+#include "traffic/capture.h"
+
+// Length of each chunk of the recording, and the resolution of packet timestamps
+#define SURVEY_CHUNK_US 100
+
+// Time each thread starts before its range, longer than a transmission
+#define SURVEY_WARMUP_US 4000
+
+/**
+ * Recording configuration.
+ */
+struct survey_config {
+  uint32_t sample_rate;      // Sample rate, in Hz
+  uint64_t center_frequency; // Center frequency, in Hz
+  uint8_t format;            // Sample format, see CHANNELIZER_FORMAT_*
+};
+
+/**
+ * Statistics for one WaveBird channel.
+ */
+struct survey_channel {
+  uint64_t packets; // Packets found
+  uint64_t locks;   // Times the despreader locked on, including to noise
+  double power;     // Average power, in dB relative to full scale
+};
+
+/**
+ * Survey results.
+ */
+struct survey {
+  struct survey_channel channels[WAVEBIRD_RADIO_CHANNELS];
+  struct capture_record *records; // Packets found on every channel, in timestamp then channel order
+  size_t count;                   // Number of packets found
+  uint64_t samples;               // Samples surveyed, the recording rounded down to whole chunks
+};
+
+/**
+ * Check a recording configuration is one the survey supports.
+ *
+ * @param config the recording configuration
+ *
+ * @return 0 if the configuration is valid, -1 otherwise
+ */
+int survey_check_config(const struct survey_config *config);
+
+/**
+ * Survey a recording.
+ *
+ * Packets are stored with their 0-indexed WaveBird channel, and the power of
+ * the channel, in dB relative to full scale, as their RSSI.
+ *
+ * @param survey buffer to store the results in, free them with survey_free()
+ * @param config the recording configuration
+ * @param samples the recording's samples
+ * @param count number of complex samples
+ * @param threads the number of threads to survey with
+ *
+ * @return 0 on success, -1 if the configuration is invalid, or the threads or results could not be allocated
+ */
+int survey_run(struct survey *survey, const struct survey_config *config, const void *samples, size_t count,
+               int threads);
+
+/**
+ * Free a survey's results.
+ *
+ * @param survey the survey
+ */
+void survey_free(struct survey *survey);
@@ -0,0 +1,127 @@
+/**
+ * Synthetic WaveBird traffic generator.
+ *
+ * Generates the packet stream a receiver would see on one channel, from any
+ * number of controllers following scripted input trajectories:
+ * - Each controller transmits every 4ms, at its own offset within the period
+ * - Every 250th packet (once per second) is an origin message instead of an
+ *   input state message, as with real controllers
+ * - Packets are sent through a channel model which flips random bits, adds
+ *   error bursts, drops packets, and corrupts packets which collide with
+ *   other transmissions on the same channel
+ * - Co-channel collisions corrupt the bits of a packet which overlap another
+ *   controller's transmission, from its carrier to its last packet bit, unless
+ *   the packet is received TRAFFIC_CAPTURE_DB stronger. Other channel users
+ *   are modeled as a random collision rate
+ *
+ * Packets are produced one at a time in timestamp order, so the generator can
+ * feed benchmarks directly, or be written to a capture file, see capture.h.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wavebird/message.h"
+#include "wavebird/packet.h"
+
+#include "traffic/capture.h"
+
+// Maximum number of controllers on the channel
+#define TRAFFIC_MAX_CONTROLLERS 16
+
+// Time between packets from each controller
+#define TRAFFIC_PACKET_PERIOD_US 4000
+
+// Input state packets sent between each origin packet
+#define TRAFFIC_ORIGIN_INTERVAL 250
+
+// Signal strength advantage, in dB, at which a packet survives a co-channel collision
+#define TRAFFIC_CAPTURE_DB 10
+
+// Scripted input trajectories
+enum {
+  TRAFFIC_SCRIPT_IDLE,   // Nobody is touching the controller, every input state message is identical
+  TRAFFIC_SCRIPT_CIRCLE, // The main stick is rotated once per second, with A pressed every other second
+  TRAFFIC_SCRIPT_PLAY,   // Random button presses and stick movements, roughly like someone playing a game
+};
+
+/**
+ * Channel model configuration.
+ */
+struct traffic_model {
+  float bit_error_rate;       // Probability of each bit being flipped
+  float burst_rate;           // Probability of a packet containing an error burst
+  uint8_t burst_bits;         // Length of each error burst, in which bits are replaced with random values
+  float drop_rate;            // Probability of a packet being lost entirely, must be less than 1
+  float collision_rate;       // Probability of a packet colliding with a transmission from another channel user
+  bool co_channel_collisions; // Corrupt packets where they overlap transmissions from the other controllers
+};
+
+/**
+ * Controller on the channel, and its scripted input state.
+ */
+struct traffic_controller {
+  uint16_t controller_id;
+  uint8_t script;          // See TRAFFIC_SCRIPT_*
+  int8_t rssi;             // Average received signal strength, in dBm
+  uint32_t offset_us;      // Transmit offset within each packet period
+  uint32_t packets;        // Packets sent, including those lost by the channel
+  uint16_t buttons;        // Current buttons, see WB_BUTTONS_*
+  uint8_t analog[6];       // Current stick, substick and trigger positions
+  uint8_t origin[6];       // Stick, substick and trigger positions at power on
+  uint32_t hold_until;     // Packet to release the held button at, for TRAFFIC_SCRIPT_PLAY
+  uint8_t stick_target[2]; // Stick position to move towards, for TRAFFIC_SCRIPT_PLAY
+};
+
+/**
+ * Traffic generator state.
+ */
+struct traffic_generator {
+  struct traffic_controller controllers[TRAFFIC_MAX_CONTROLLERS];
+  uint8_t order[TRAFFIC_MAX_CONTROLLERS]; // Controllers sorted by transmit offset
+  uint8_t controller_count;               // Number of controllers added
+  uint8_t channel;                        // Channel to report in generated records
+  struct traffic_model model;             // Channel model, a perfect channel by default
+  uint32_t seed;                          // PRNG state
+  uint64_t period;                        // Current packet period
+  uint8_t next_controller;                // Index into order of the next controller to transmit
+  uint64_t sent;                          // Packets sent by all controllers
+  uint64_t dropped;                       // Packets lost by the channel
+  uint64_t collisions;                    // Packets corrupted by collisions
+  uint64_t bit_errors;                    // Bit errors in delivered packets
+};
+
+/**
+ * Initialize a traffic generator, with no controllers and a perfect channel.
+ *
+ * @param generator the traffic generator
+ * @param seed the PRNG seed, the same seed and configuration always produce the same traffic
+ */
+void traffic_init(struct traffic_generator *generator, uint32_t seed);
+
+/**
+ * Add a controller to the channel.
+ *
+ * Controllers must all be added before the first packet is generated.
+ *
+ * @param generator the traffic generator
+ * @param controller_id the 10-bit controller ID
+ * @param script the input trajectory to follow, see TRAFFIC_SCRIPT_*
+ *
+ * @return the controller, or NULL if there are already TRAFFIC_MAX_CONTROLLERS controllers
+ */
+struct traffic_controller *traffic_add_controller(struct traffic_generator *generator, uint16_t controller_id,
+                                                  uint8_t script);
+
+/**
+ * Generate the next packet to make it through the channel.
+ *
+ * At least one controller must have been added.
+ *
+ * @param generator the traffic generator
+ * @param record buffer to store the received packet and its metadata
+ * @param message buffer to store the 11-byte message which was sent, or NULL
+ */
+void traffic_next(struct traffic_generator *generator, struct capture_record *record, uint8_t *message);
@@ -0,0 +1,210 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavebird/packet.h"
+
+#include "traffic/analysis.h"
+#include "traffic/traffic.h"
+
+// Shortest gap in each gap histogram bin, in packet periods
+static const uint32_t GAP_BIN_START[ANALYSIS_GAP_BINS] = {1, 2, 3, 5, 9, TRAFFIC_ORIGIN_INTERVAL + 1};
+
+// A thread's range of records, and the statistics collected from it
+struct shard {
+  pthread_t thread;
+  const struct capture_record *records;
+  size_t count;
+  struct analysis analysis;
+};
+
+// Count a gap between two decoded packets from the same controller
+static void count_gap(struct analysis_controller *controller, uint64_t gap_us)
+{
+  // Round to the nearest packet period, to allow for timestamp jitter
+  uint64_t periods = (gap_us + TRAFFIC_PACKET_PERIOD_US / 2) / TRAFFIC_PACKET_PERIOD_US;
+
+  int bin = 0;
+  while (bin < ANALYSIS_GAP_BINS - 1 && periods >= GAP_BIN_START[bin + 1])
+    bin++;
+
+  controller->gaps[bin]++;
+  if (gap_us > controller->max_gap_us)
+    controller->max_gap_us = gap_us;
+}
+
+// Check if two input states differ
+static bool input_changed(const wavebird_gc_state_t *a, const wavebird_gc_state_t *b)
+{
+  return memcmp(a->buttons, b->buttons, sizeof(a->buttons)) != 0 || memcmp(a->analog, b->analog, sizeof(a->analog)) != 0;
+}
+
+// Count a decoded input state packet
+static void count_input(struct analysis_controller *controller, const wavebird_gc_state_t *state)
+{
+  if (!controller->has_input) {
+    controller->first_input = *state;
+    controller->has_input   = true;
+  } else if (input_changed(&controller->last_input, state)) {
+    controller->input_changes++;
+  }
+
+  controller->last_input = *state;
+}
+
+// Analyze a range of records
+static void analyze_records(struct analysis *analysis, const struct capture_record *records, size_t count)
+{
+  wavebird_decoder_t decoder;
+  wavebird_decoder_init(&decoder);
+
+  for (size_t i = 0; i < count; i++) {
+    const struct capture_record *record = &records[i];
+
+    wavebird_gc_state_t state;
+    wavebird_decode_result_t result;
+    int rc = wavebird_decoder_decode_gc_state_ex(&decoder, &state, &result, record->packet);
+
+    if (rc < 0) {
+      if (rc == -WB_PACKET_ERR_CRC_MISMATCH)
+        analysis->crc_failures++;
+      else
+        analysis->decode_failures++;
+
+      // Attribute the failure to a controller, if the header survived
+      uint16_t header;
+      if (wavebird_packet_decode_header(&header, record->packet) < 0) {
+        analysis->unattributed++;
+        continue;
+      }
+
+      struct analysis_controller *controller = &analysis->controllers[header & WB_MESSAGE_HEADER_CONTROLLER_ID];
+      if (rc == -WB_PACKET_ERR_CRC_MISMATCH)
+        controller->crc_failures++;
+      else
+        controller->decode_failures++;
+
+      continue;
+    }
+
+    int bits = result.corrected_bits < ANALYSIS_BIT_BINS ? result.corrected_bits : ANALYSIS_BIT_BINS - 1;
+    analysis->decoded++;
+    analysis->corrected_bits[bits]++;
+
+    struct analysis_controller *controller = &analysis->controllers[wavebird_gc_state_get_controller_id(&state)];
+    if (controller->packets == 0)
+      controller->first_us = record->timestamp_us;
+    else
+      count_gap(controller, record->timestamp_us - controller->last_us);
+
+    controller->packets++;
+    controller->corrected_bits[bits]++;
+    controller->last_us = record->timestamp_us;
+
+    if (wavebird_gc_state_get_type(&state) == WB_MESSAGE_TYPE_ORIGIN)
+      controller->origins++;
+    else
+      count_input(controller, &state);
+  }
+
+  analysis->records = count;
+  if (count > 0) {
+    analysis->first_us = records[0].timestamp_us;
+    analysis->last_us  = records[count - 1].timestamp_us;
+  }
+}
+
+static void *shard_thread(void *arg)
+{
+  struct shard *shard = arg;
+  analyze_records(&shard->analysis, shard->records, shard->count);
+  return NULL;
+}
+
+// Merge a controller's statistics from the next range of records
+static void merge_controller(struct analysis_controller *into, const struct analysis_controller *from)
+{
+  // Join up the gap and input change across the boundary between the ranges
+  if (into->packets > 0 && from->packets > 0)
+    count_gap(into, from->first_us - into->last_us);
+  if (into->has_input && from->has_input && input_changed(&into->last_input, &from->first_input))
+    into->input_changes++;
+
+  if (into->packets == 0)
+    into->first_us = from->first_us;
+  if (from->packets > 0)
+    into->last_us = from->last_us;
+  if (!into->has_input)
+    into->first_input = from->first_input;
+  if (from->has_input)
+    into->last_input = from->last_input;
+
+  into->packets += from->packets;
+  into->origins += from->origins;
+  into->crc_failures += from->crc_failures;
+  into->decode_failures += from->decode_failures;
+  into->input_changes += from->input_changes;
+  into->has_input |= from->has_input;
+  if (from->max_gap_us > into->max_gap_us)
+    into->max_gap_us = from->max_gap_us;
+
+  for (int i = 0; i < ANALYSIS_BIT_BINS; i++)
+    into->corrected_bits[i] += from->corrected_bits[i];
+  for (int i = 0; i < ANALYSIS_GAP_BINS; i++)
+    into->gaps[i] += from->gaps[i];
+}
+
+int analysis_run(struct analysis *analysis, const struct capture_record *records, size_t count, int threads)
+{
+  memset(analysis, 0, sizeof(*analysis));
+  if (threads < 1)
+    threads = 1;
+
+  struct shard *shards = calloc(threads, sizeof(*shards));
+  if (!shards)
+    return -1;
+
+  // Split the records into one contiguous range per thread
+  int started = 0;
+  for (int i = 0; i < threads; i++) {
+    size_t start      = count * i / threads;
+    shards[i].records = records + start;
+    shards[i].count   = count * (i + 1) / threads - start;
+    if (pthread_create(&shards[i].thread, NULL, shard_thread, &shards[i]) != 0)
+      break;
+    started++;
+  }
+
+  for (int i = 0; i < started; i++)
+    pthread_join(shards[i].thread, NULL);
+
+  if (started < threads) {
+    free(shards);
+    return -1;
+  }
+
+  // Merge the results in record order
+  analysis->first_us = count > 0 ? records[0].timestamp_us : 0;
+  analysis->last_us  = count > 0 ? records[count - 1].timestamp_us : 0;
+  for (int i = 0; i < threads; i++) {
+    const struct analysis *shard = &shards[i].analysis;
+    analysis->records += shard->records;
+    analysis->decoded += shard->decoded;
+    analysis->crc_failures += shard->crc_failures;
+    analysis->decode_failures += shard->decode_failures;
+    analysis->unattributed += shard->unattributed;
+    for (int j = 0; j < ANALYSIS_BIT_BINS; j++)
+      analysis->corrected_bits[j] += shard->corrected_bits[j];
+
+    for (int c = 0; c < ANALYSIS_CONTROLLERS; c++)
+      merge_controller(&analysis->controllers[c], &shard->controllers[c]);
+  }
+
+  free(shards);
+  return 0;
+}
+
+uint32_t analysis_gap_bin_start(int bin)
+{
+  return GAP_BIN_START[bin];
+}
@@ -0,0 +1,28 @@
+#include "traffic/capture.h"
+
+int capture_write_header(FILE *file)
+{
+  struct capture_header header = {
+      .magic       = CAPTURE_MAGIC,
+      .version     = CAPTURE_VERSION,
+      .record_size = sizeof(struct capture_record),
+  };
+
+  return fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+}
+
+int capture_write_records(FILE *file, const struct capture_record *records, size_t count)
+{
+  return fwrite(records, sizeof(*records), count, file) == count ? 0 : -1;
+}
+
+int capture_check_header(const struct capture_header *header)
+{
+  if (header->magic != CAPTURE_MAGIC || header->version != CAPTURE_VERSION)
+    return -1;
+
+  if (header->record_size != sizeof(struct capture_record))
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,192 @@
+#include <math.h>
+#include <string.h>
+
+#include "traffic/channelizer.h"
+
+// Prototype filter cutoff, as a fraction of the bin spacing, passing the whole of a transmission centered in the bin
+#define CUTOFF 0.75
+
+_Static_assert(CHANNELIZER_HISTORY >= CHANNELIZER_MAX_BINS * CHANNELIZER_TAPS_PER_BIN +
+                                          (CHANNELIZER_BATCH - 1) * CHANNELIZER_MAX_BINS / 2,
+               "history must hold a whole batch of frames");
+
+int channelizer_init(struct channelizer *channelizer, int bins, uint8_t format, const uint8_t *outputs,
+                     int output_count)
+{
+  if (bins < 4 || bins > CHANNELIZER_MAX_BINS || (bins & (bins - 1)) != 0)
+    return -1;
+  if (output_count < 0 || output_count > CHANNELIZER_MAX_OUTPUTS)
+    return -1;
+  for (int i = 0; i < output_count; i++) {
+    if (outputs[i] >= bins)
+      return -1;
+  }
+
+  memset(channelizer, 0, sizeof(*channelizer));
+  channelizer->bins         = bins;
+  channelizer->format       = format;
+  channelizer->output_count = output_count;
+  memcpy(channelizer->outputs, outputs, output_count);
+
+  // Hamming windowed sinc low-pass filter, with unity gain
+  int length    = bins * CHANNELIZER_TAPS_PER_BIN;
+  double cutoff = CUTOFF / bins;
+  double prototype[CHANNELIZER_MAX_BINS * CHANNELIZER_TAPS_PER_BIN];
+  double gain = 0;
+  for (int i = 0; i < length; i++) {
+    double x     = i - (length - 1) / 2.0;
+    double sinc  = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+    prototype[i] = sinc * (0.54 - 0.46 * cos(2 * M_PI * i / (length - 1)));
+    gain += prototype[i];
+  }
+
+  // Branch p of each frame sums taps p + r * bins against the samples p + r * bins before the frame's newest sample.
+  // Each row is stored reversed, so the sums run forwards through the history.
+  for (int r = 0; r < CHANNELIZER_TAPS_PER_BIN; r++) {
+    for (int q = 0; q < bins; q++)
+      channelizer->taps[r][q] = prototype[bins - 1 - q + r * bins] / gain;
+  }
+
+  // Inverse FFT twiddle factors, and the bit-reversed input order
+  int bits = 0;
+  while ((1 << bits) < bins)
+    bits++;
+  for (int i = 0; i < bins / 2; i++) {
+    channelizer->twiddle_re[i] = cos(2 * M_PI * i / bins);
+    channelizer->twiddle_im[i] = sin(2 * M_PI * i / bins);
+  }
+  for (int i = 0; i < bins; i++) {
+    int reversed = 0;
+    for (int b = 0; b < bits; b++)
+      reversed |= (i >> b & 1) << (bits - 1 - b);
+    channelizer->bit_reverse[i] = reversed;
+  }
+
+  // The first frame's newest sample is the last sample of the first decimation block, the samples before it are 0
+  channelizer->fill = length - bins / 2;
+
+  return 0;
+}
+
+// Convert input samples to floats in the history, scaled so full scale is 1
+static void convert_samples(struct channelizer *channelizer, const void *samples, size_t count)
+{
+  float *re = channelizer->history_re + channelizer->fill;
+  float *im = channelizer->history_im + channelizer->fill;
+
+  if (channelizer->format == CHANNELIZER_FORMAT_CS16) {
+    const int16_t *in = samples;
+    for (size_t i = 0; i < count; i++) {
+      re[i] = in[2 * i] * (1.0f / 32768);
+      im[i] = in[2 * i + 1] * (1.0f / 32768);
+    }
+  } else {
+    const int8_t *in = samples;
+    for (size_t i = 0; i < count; i++) {
+      re[i] = in[2 * i] * (1.0f / 128);
+      im[i] = in[2 * i + 1] * (1.0f / 128);
+    }
+  }
+
+  channelizer->fill += count;
+}
+
+// Work out a batch of frames, the first of which has its oldest sample at the given history offset
+static void channelize_batch(const struct channelizer *channelizer, float fft_re[][CHANNELIZER_BATCH],
+                             float fft_im[][CHANNELIZER_BATCH], int start)
+{
+  const int bins       = channelizer->bins;
+  const int decimation = bins / 2;
+
+  // Polyphase partial sums, scattered into the FFT's input order
+  for (int frame = 0; frame < CHANNELIZER_BATCH; frame++) {
+    const float *in_re = channelizer->history_re + start + frame * decimation;
+    const float *in_im = channelizer->history_im + start + frame * decimation;
+
+    float sum_re[CHANNELIZER_MAX_BINS] = {0};
+    float sum_im[CHANNELIZER_MAX_BINS] = {0};
+    for (int r = 0; r < CHANNELIZER_TAPS_PER_BIN; r++) {
+      const float *taps = channelizer->taps[r];
+      const float *x_re = in_re + (CHANNELIZER_TAPS_PER_BIN - 1 - r) * bins;
+      const float *x_im = in_im + (CHANNELIZER_TAPS_PER_BIN - 1 - r) * bins;
+      for (int q = 0; q < bins; q++) {
+        sum_re[q] += taps[q] * x_re[q];
+        sum_im[q] += taps[q] * x_im[q];
+      }
+    }
+
+    // Branch p is the sum ending p samples before the newest sample
+    for (int q = 0; q < bins; q++) {
+      int input            = channelizer->bit_reverse[bins - 1 - q];
+      fft_re[input][frame] = sum_re[q];
+      fft_im[input][frame] = sum_im[q];
+    }
+  }
+
+  // Radix-2 inverse FFT across the bins, with every butterfly applied to all the frames in the batch at once
+  for (int half = 1; half < bins; half *= 2) {
+    int stride = bins / (2 * half);
+    for (int group = 0; group < bins; group += 2 * half) {
+      for (int j = 0; j < half; j++) {
+        float w_re  = channelizer->twiddle_re[j * stride];
+        float w_im  = channelizer->twiddle_im[j * stride];
+        float *a_re = fft_re[group + j], *a_im = fft_im[group + j];
+        float *b_re = fft_re[group + j + half], *b_im = fft_im[group + j + half];
+        for (int i = 0; i < CHANNELIZER_BATCH; i++) {
+          float t_re = w_re * b_re[i] - w_im * b_im[i];
+          float t_im = w_re * b_im[i] + w_im * b_re[i];
+          b_re[i]    = a_re[i] - t_re;
+          b_im[i]    = a_im[i] - t_im;
+          a_re[i] += t_re;
+          a_im[i] += t_im;
+        }
+      }
+    }
+  }
+}
+
+size_t channelizer_push(struct channelizer *channelizer, float *const *re, float *const *im, const void *samples,
+                        size_t count)
+{
+  const int bins       = channelizer->bins;
+  const int decimation = bins / 2;
+  const int length     = bins * CHANNELIZER_TAPS_PER_BIN;
+  const int batch      = CHANNELIZER_BATCH * decimation;
+  const size_t stride  = channelizer->format == CHANNELIZER_FORMAT_CS16 ? 4 : 2;
+  size_t produced      = 0;
+
+  float fft_re[CHANNELIZER_MAX_BINS][CHANNELIZER_BATCH];
+  float fft_im[CHANNELIZER_MAX_BINS][CHANNELIZER_BATCH];
+
+  for (size_t i = 0; i < count;) {
+    size_t space = CHANNELIZER_HISTORY - channelizer->fill;
+    size_t chunk = count - i < space ? count - i : space;
+    convert_samples(channelizer, (const uint8_t *)samples + i * stride, chunk);
+    i += chunk;
+
+    // Work out every whole batch in the history, then keep the samples the next batch needs
+    int start = 0;
+    for (; start + length + batch - decimation <= channelizer->fill; start += batch) {
+      channelize_batch(channelizer, fft_re, fft_im, start);
+
+      // The mix down to each bin advances by half a turn per frame in odd bins, undo it so the phase is continuous
+      for (int o = 0; o < channelizer->output_count; o++) {
+        int bin = channelizer->outputs[o];
+        for (int frame = 0; frame < CHANNELIZER_BATCH; frame++) {
+          float sign              = bin & (channelizer->frames + frame) & 1 ? -1.0f : 1.0f;
+          re[o][produced + frame] = sign * fft_re[bin][frame];
+          im[o][produced + frame] = sign * fft_im[bin][frame];
+        }
+      }
+
+      channelizer->frames += CHANNELIZER_BATCH;
+      produced += CHANNELIZER_BATCH;
+    }
+
+    channelizer->fill -= start;
+    memmove(channelizer->history_re, channelizer->history_re + start, channelizer->fill * sizeof(float));
+    memmove(channelizer->history_im, channelizer->history_im + start, channelizer->fill * sizeof(float));
+  }
+
+  return produced;
+}
@@ -0,0 +1,158 @@
+#include <math.h>
+#include <string.h>
+
+#include "wavebird/despread.h"
+#include "wavebird/radio.h"
+
+#include "traffic/fsk.h"
+
+// Chip sample at the full frequency deviation
+#define CHIP_AMPLITUDE 64
+
+// Channel samples discriminated at a time
+#define DISCRIMINATOR_BLOCK 256
+
+// Samples between renormalizing the modulator's carrier, to stop rounding errors building up
+#define RENORMALIZE_SAMPLES 64
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+  while (b) {
+    uint32_t t = a % b;
+    a          = b;
+    b          = t;
+  }
+
+  return a;
+}
+
+int fsk_demodulator_init(struct fsk_demodulator *demodulator, uint32_t sample_rate)
+{
+  uint32_t chip_sample_rate = WAVEBIRD_RADIO_CHIP_RATE * FSK_SAMPLES_PER_CHIP;
+  if (sample_rate < chip_sample_rate)
+    return -1;
+
+  uint32_t divisor = gcd(sample_rate, chip_sample_rate);
+  memset(demodulator, 0, sizeof(*demodulator));
+  demodulator->up    = chip_sample_rate / divisor;
+  demodulator->down  = sample_rate / divisor;
+  demodulator->scale = CHIP_AMPLITUDE / sin(2 * M_PI * WAVEBIRD_RADIO_DEVIATION / sample_rate);
+
+  return 0;
+}
+
+size_t fsk_demodulate(struct fsk_demodulator *demodulator, int8_t *chips, const float *re, const float *im,
+                      size_t count)
+{
+  const uint32_t up   = demodulator->up;
+  const uint32_t down = demodulator->down;
+  const float step    = 1.0f / up;
+  size_t produced     = 0;
+
+  // Discriminator outputs, following on from the previous block's last one
+  float frequency[DISCRIMINATOR_BLOCK + 1];
+  float power[DISCRIMINATOR_BLOCK + 1];
+
+  for (size_t start = 0; start < count; start += DISCRIMINATOR_BLOCK) {
+    const float *block_re = re + start;
+    const float *block_im = im + start;
+    size_t block          = count - start < DISCRIMINATOR_BLOCK ? count - start : DISCRIMINATOR_BLOCK;
+
+    // Normalized by the power of both samples, so the output is at most the sine of the phase step. The first sample
+    // follows on from the last one pushed, the rest are a plain loop over the block the compiler can vectorize.
+    frequency[0] = demodulator->last_frequency;
+    power[0]     = demodulator->last_re * demodulator->last_re + demodulator->last_im * demodulator->last_im;
+    power[1]     = block_re[0] * block_re[0] + block_im[0] * block_im[0];
+    frequency[1] = 2 * (block_im[0] * demodulator->last_re - block_re[0] * demodulator->last_im) /
+                   (power[0] + power[1] + 1e-20f);
+    for (size_t i = 1; i < block; i++) {
+      power[i + 1]     = block_re[i] * block_re[i] + block_im[i] * block_im[i];
+      float cross      = block_im[i] * block_re[i - 1] - block_re[i] * block_im[i - 1];
+      frequency[i + 1] = 2 * cross / (power[i] + power[i + 1] + 1e-20f);
+    }
+
+    float energy = 0;
+    for (size_t i = 1; i <= block; i++)
+      energy += power[i];
+    demodulator->energy += energy;
+
+    // Interpolate between the discriminator outputs either side of each chip sample
+    uint32_t position = demodulator->position;
+    for (; position < block * up; position += down) {
+      uint32_t i  = position / up;
+      float value = frequency[i] + (position % up) * step * (frequency[i + 1] - frequency[i]);
+      value *= demodulator->scale;
+
+      chips[produced++] = value > 127 ? 127 : value < -127 ? -127 : lrintf(value);
+    }
+
+    demodulator->position       = position - block * up;
+    demodulator->last_frequency = frequency[block];
+    demodulator->last_re        = block_re[block - 1];
+    demodulator->last_im        = block_im[block - 1];
+  }
+
+  return produced;
+}
+
+// Chip of a frame, +1 or -1, or 0 before and after the frame
+static int frame_chip(const uint8_t *frame, int chip)
+{
+  if (chip < 0 || chip >= FSK_FRAME_BITS * WAVEBIRD_DSSS_CHIPS)
+    return 0;
+
+  int bit  = chip / WAVEBIRD_DSSS_CHIPS;
+  int code = WAVEBIRD_DSSS_CODE >> (WAVEBIRD_DSSS_CHIPS - 1 - chip % WAVEBIRD_DSSS_CHIPS) & 1;
+  int data = frame[bit / 8] >> (7 - bit % 8) & 1;
+  return code ^ !data ? 1 : -1;
+}
+
+void fsk_modulate(float *re, float *im, size_t count, uint32_t sample_rate, double offset, size_t start,
+                  const uint8_t *packet, float amplitude)
+{
+  static const uint8_t header[] = {0xFA, 0xAA, 0xAA, 0xAA, 0x12, 0x34};
+  uint8_t frame[FSK_FRAME_BITS / 8];
+  memcpy(frame, header, sizeof(header));
+  memcpy(frame + sizeof(header), packet, WAVEBIRD_PACKET_BYTES);
+
+  double samples_per_chip = (double)sample_rate / WAVEBIRD_RADIO_CHIP_RATE;
+  double carrier          = (double)sample_rate * FSK_CARRIER_US / 1000000;
+  size_t end              = start + (size_t)ceil(carrier + FSK_FRAME_BITS * WAVEBIRD_DSSS_CHIPS * samples_per_chip);
+  if (end > count)
+    end = count;
+
+  // Rotate the carrier by the channel offset and the frequency deviation each sample, the deviation's rotation is
+  // small enough for a few terms of its Taylor series
+  double offset_re  = cos(2 * M_PI * offset / sample_rate);
+  double offset_im  = sin(2 * M_PI * offset / sample_rate);
+  double carrier_re = 1, carrier_im = 0;
+
+  for (size_t n = start; n < end; n++) {
+    // Ramp the frequency between the chips either side, which are centered on half chips
+    double t         = (n - start - carrier) / samples_per_chip - 0.5;
+    int chip         = (int)floor(t);
+    double weight    = t - chip;
+    double deviation = (frame_chip(frame, chip) * (1 - weight) + frame_chip(frame, chip + 1) * weight) *
+                       WAVEBIRD_RADIO_DEVIATION;
+
+    double theta     = 2 * M_PI * deviation / sample_rate;
+    double theta2    = theta * theta;
+    double rotate_re = 1 - theta2 / 2 + theta2 * theta2 / 24;
+    double rotate_im = theta - theta * theta2 / 6;
+
+    re[n] += amplitude * carrier_re;
+    im[n] += amplitude * carrier_im;
+
+    double step_re = offset_re * rotate_re - offset_im * rotate_im;
+    double step_im = offset_re * rotate_im + offset_im * rotate_re;
+    double next_re = carrier_re * step_re - carrier_im * step_im;
+    carrier_im     = carrier_re * step_im + carrier_im * step_re;
+    carrier_re     = next_re;
+
+    if ((n - start) % RENORMALIZE_SAMPLES == 0) {
+      double magnitude = 1.5 - 0.5 * (carrier_re * carrier_re + carrier_im * carrier_im);
+      carrier_re *= magnitude;
+      carrier_im *= magnitude;
+    }
+  }
+}
@@ -0,0 +1,314 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavebird/bitstream.h"
+#include "wavebird/despread.h"
+
+#include "traffic/channelizer.h"
+#include "traffic/fsk.h"
+#include "traffic/survey.h"
+
+// Channel samples per chunk, each bin is decimated to twice the channel spacing
+#define CHUNK_FRAMES (2 * WAVEBIRD_RADIO_CHANNEL_SPACING / 1000 * SURVEY_CHUNK_US / 1000)
+
+// Chunks each thread starts before its range
+#define WARMUP_CHUNKS (SURVEY_WARMUP_US / SURVEY_CHUNK_US)
+
+// Chunks processed after each thread's range, long enough to push the byte holding the last bit in range
+#define TAIL_CHUNKS 1
+
+// Chunks before a packet's last bit its RSSI is averaged over, all inside the transmission
+#define RSSI_CHUNKS 16
+
+// Chip samples per chunk, at most
+#define CHUNK_CHIPS (CHUNK_FRAMES + 1)
+
+// Sync pattern bit errors allowed
+#define MAX_SYNC_ERRORS 1
+
+// Receiver for one WaveBird channel
+struct receiver {
+  struct shard *shard;
+  uint8_t channel;
+  struct fsk_demodulator demodulator;
+  wavebird_despreader_t despreader;
+  wavebird_bitstream_t bitstream;
+  uint8_t byte;                         // Despread bits not yet pushed to the bitstream decoder
+  uint8_t bits;                         // Number of bits in byte
+  uint64_t bit_chunks[8];               // Chunk each bit in byte was despread in
+  double chunk_energy[RSSI_CHUNKS + 1]; // Power in the latest chunks, indexed by chunk
+  double energy;                        // Total power in the chunks in range
+  uint64_t frames;                      // Channel samples in the chunks in range
+};
+
+// A thread's range of chunks, and the packets found in it
+struct shard {
+  pthread_t thread;
+  const struct survey_config *config;
+  const uint8_t *samples; // The first sample of the first chunk
+  size_t chunk_samples;   // Samples per chunk
+  size_t sample_size;     // Bytes per sample
+  uint64_t first_chunk;   // First chunk processed, including the warm up
+  uint64_t start_chunk;   // First chunk in range
+  uint64_t end_chunk;     // Chunk after the last chunk in range
+  uint64_t last_chunk;    // Chunk after the last chunk processed, including the tail
+  uint64_t chunk;         // Chunk being processed
+  struct survey survey;   // Packets found in range, and their statistics
+  size_t capacity;        // Records allocated
+  bool failed;            // Set if the records could not be allocated
+  struct channelizer channelizer;
+  struct receiver receivers[WAVEBIRD_RADIO_CHANNELS];
+  float re[WAVEBIRD_RADIO_CHANNELS][CHUNK_FRAMES + CHANNELIZER_BATCH];
+  float im[WAVEBIRD_RADIO_CHANNELS][CHUNK_FRAMES + CHANNELIZER_BATCH];
+  int8_t chips[CHUNK_CHIPS];
+  uint8_t despread[WAVEBIRD_DESPREADER_MAX_BITS(CHUNK_CHIPS)];
+};
+
+// Work out the filter bank bin of each WaveBird channel, if the recording covers them all
+static int channel_bins(uint8_t *bins, const struct survey_config *config)
+{
+  static const uint8_t channel_map[WAVEBIRD_RADIO_CHANNELS] = WAVEBIRD_RADIO_CHANNEL_MAP;
+
+  if (config->format != CHANNELIZER_FORMAT_CS8 && config->format != CHANNELIZER_FORMAT_CS16)
+    return -1;
+
+  // One bin per channel index, and the center on a channel index
+  uint32_t bin_count = config->sample_rate / WAVEBIRD_RADIO_CHANNEL_SPACING;
+  if (config->sample_rate % WAVEBIRD_RADIO_CHANNEL_SPACING != 0 || bin_count < 4 ||
+      bin_count > CHANNELIZER_MAX_BINS || (bin_count & (bin_count - 1)) != 0)
+    return -1;
+
+  int64_t center_offset = (int64_t)config->center_frequency - WAVEBIRD_RADIO_BASE_FREQUENCY;
+  if (center_offset % WAVEBIRD_RADIO_CHANNEL_SPACING != 0)
+    return -1;
+
+  for (int i = 0; i < WAVEBIRD_RADIO_CHANNELS; i++) {
+    int64_t offset = channel_map[i] - center_offset / WAVEBIRD_RADIO_CHANNEL_SPACING;
+    if (offset < -(int64_t)bin_count / 2 || offset > (int64_t)bin_count / 2)
+      return -1;
+
+    bins[i] = (offset + bin_count) % bin_count;
+  }
+
+  return bin_count;
+}
+
+// Power in dB relative to full scale, clamped to fit in a record's RSSI
+static int8_t power_rssi(double power)
+{
+  double db = power > 0 ? 10 * log10(power) : -128;
+  return db < -128 ? -128 : db > 0 ? 0 : lrint(db);
+}
+
+static void handle_packet(const uint8_t *packet, void *context)
+{
+  struct receiver *receiver = context;
+  struct shard *shard       = receiver->shard;
+
+  // The packet ends offset bits before the end of the byte just pushed. Packets ending outside the thread's range
+  // belong to the threads either side.
+  uint64_t chunk = receiver->bit_chunks[7 - receiver->bitstream.offset];
+  if (chunk < shard->start_chunk || chunk >= shard->end_chunk || shard->failed)
+    return;
+
+  if (shard->survey.count == shard->capacity) {
+    size_t capacity                = shard->capacity ? shard->capacity * 2 : 1024;
+    struct capture_record *records = realloc(shard->survey.records, capacity * sizeof(*records));
+    if (!records) {
+      shard->failed = true;
+      return;
+    }
+
+    shard->survey.records = records;
+    shard->capacity       = capacity;
+  }
+
+  struct capture_record *record = &shard->survey.records[shard->survey.count++];
+  memset(record, 0, sizeof(*record));
+  // Average the power over the chunks before the one the packet ended in
+  double energy = 0;
+  for (int i = 1; i <= RSSI_CHUNKS; i++)
+    energy += receiver->chunk_energy[(chunk - i) % (RSSI_CHUNKS + 1)];
+
+  record->timestamp_us = (chunk + 1) * SURVEY_CHUNK_US;
+  record->channel      = receiver->channel;
+  record->rssi         = power_rssi(energy / (RSSI_CHUNKS * CHUNK_FRAMES));
+  memcpy(record->packet, packet, WAVEBIRD_PACKET_BYTES);
+
+  shard->survey.channels[receiver->channel].packets++;
+}
+
+// Channelize a chunk, and run each channel's samples through its receiver
+static void survey_chunk(struct shard *shard, const uint8_t *samples)
+{
+  float *re[WAVEBIRD_RADIO_CHANNELS], *im[WAVEBIRD_RADIO_CHANNELS];
+  for (int i = 0; i < WAVEBIRD_RADIO_CHANNELS; i++) {
+    re[i] = shard->re[i];
+    im[i] = shard->im[i];
+  }
+
+  size_t frames = channelizer_push(&shard->channelizer, re, im, samples, shard->chunk_samples);
+  bool in_range = shard->chunk >= shard->start_chunk && shard->chunk < shard->end_chunk;
+
+  for (int i = 0; i < WAVEBIRD_RADIO_CHANNELS; i++) {
+    struct receiver *receiver = &shard->receivers[i];
+    uint32_t locks            = receiver->despreader.locks;
+
+    receiver->demodulator.energy = 0;
+    size_t chips = fsk_demodulate(&receiver->demodulator, shard->chips, shard->re[i], shard->im[i], frames);
+    receiver->chunk_energy[shard->chunk % (RSSI_CHUNKS + 1)] = receiver->demodulator.energy;
+
+    size_t bits = wavebird_despreader_push(&receiver->despreader, shard->despread, NULL, shard->chips, chips);
+    for (size_t b = 0; b < bits; b++) {
+      receiver->byte                       = receiver->byte << 1 | shard->despread[b];
+      receiver->bit_chunks[receiver->bits] = shard->chunk;
+      if (++receiver->bits == 8) {
+        wavebird_bitstream_push(&receiver->bitstream, &receiver->byte, 1);
+        receiver->bits = 0;
+      }
+    }
+
+    if (in_range) {
+      shard->survey.channels[i].locks += receiver->despreader.locks - locks;
+      receiver->energy += receiver->demodulator.energy;
+      receiver->frames += frames;
+    }
+  }
+}
+
+static void *shard_thread(void *arg)
+{
+  struct shard *shard = arg;
+
+  uint8_t bins[WAVEBIRD_RADIO_CHANNELS];
+  int bin_count = channel_bins(bins, shard->config);
+  channelizer_init(&shard->channelizer, bin_count, shard->config->format, bins, WAVEBIRD_RADIO_CHANNELS);
+
+  for (int i = 0; i < WAVEBIRD_RADIO_CHANNELS; i++) {
+    struct receiver *receiver = &shard->receivers[i];
+    receiver->shard           = shard;
+    receiver->channel         = i;
+    fsk_demodulator_init(&receiver->demodulator, 2 * WAVEBIRD_RADIO_CHANNEL_SPACING);
+    wavebird_despreader_init(&receiver->despreader, FSK_SAMPLES_PER_CHIP);
+    wavebird_bitstream_init(&receiver->bitstream, MAX_SYNC_ERRORS, handle_packet, receiver);
+  }
+
+  for (shard->chunk = shard->first_chunk; shard->chunk < shard->last_chunk; shard->chunk++) {
+    const uint8_t *samples = shard->samples + shard->chunk * shard->chunk_samples * shard->sample_size;
+    survey_chunk(shard, samples);
+  }
+
+  return NULL;
+}
+
+// Order packets by timestamp, then channel, packets are found in a different order depending on where each channel's
+// bytes happen to be split
+static int compare_records(const void *a, const void *b)
+{
+  const struct capture_record *x = a, *y = b;
+  if (x->timestamp_us != y->timestamp_us)
+    return x->timestamp_us < y->timestamp_us ? -1 : 1;
+
+  return x->channel - y->channel;
+}
+
+int survey_check_config(const struct survey_config *config)
+{
+  uint8_t bins[WAVEBIRD_RADIO_CHANNELS];
+  return channel_bins(bins, config) < 0 ? -1 : 0;
+}
+
+int survey_run(struct survey *survey, const struct survey_config *config, const void *samples, size_t count,
+               int threads)
+{
+  memset(survey, 0, sizeof(*survey));
+  if (survey_check_config(config) < 0)
+    return -1;
+  if (threads < 1)
+    threads = 1;
+
+  struct shard *shards = calloc(threads, sizeof(*shards));
+  if (!shards)
+    return -1;
+
+  // Split the whole chunks into one contiguous range per thread
+  size_t chunk_samples = (size_t)CHUNK_FRAMES * (config->sample_rate / WAVEBIRD_RADIO_CHANNEL_SPACING / 2);
+  uint64_t chunks      = count / chunk_samples;
+  int started          = 0;
+  for (int i = 0; i < threads; i++) {
+    struct shard *shard  = &shards[i];
+    shard->config        = config;
+    shard->samples       = samples;
+    shard->chunk_samples = chunk_samples;
+    shard->sample_size   = config->format == CHANNELIZER_FORMAT_CS16 ? 4 : 2;
+    shard->start_chunk   = chunks * i / threads;
+    shard->end_chunk     = chunks * (i + 1) / threads;
+    shard->first_chunk   = shard->start_chunk > WARMUP_CHUNKS ? shard->start_chunk - WARMUP_CHUNKS : 0;
+    shard->last_chunk    = shard->end_chunk + TAIL_CHUNKS < chunks ? shard->end_chunk + TAIL_CHUNKS : chunks;
+    if (pthread_create(&shard->thread, NULL, shard_thread, shard) != 0)
+      break;
+    started++;
+  }
+
+  for (int i = 0; i < started; i++)
+    pthread_join(shards[i].thread, NULL);
+
+  // Join the packets from each range
+  bool failed = started < threads;
+  for (int i = 0; i < started; i++)
+    failed |= shards[i].failed;
+
+  size_t total = 0;
+  for (int i = 0; i < started; i++)
+    total += shards[i].survey.count;
+
+  survey->records = failed || total == 0 ? NULL : malloc(total * sizeof(*survey->records));
+  if (total > 0 && !survey->records)
+    failed = true;
+
+  double energy[WAVEBIRD_RADIO_CHANNELS]   = {0};
+  uint64_t frames[WAVEBIRD_RADIO_CHANNELS] = {0};
+  for (int i = 0; i < started; i++) {
+    const struct shard *shard = &shards[i];
+    if (!failed && shard->survey.count > 0) {
+      memcpy(survey->records + survey->count, shard->survey.records, shard->survey.count * sizeof(*survey->records));
+      survey->count += shard->survey.count;
+    }
+
+    for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++) {
+      survey->channels[c].packets += shard->survey.channels[c].packets;
+      survey->channels[c].locks += shard->survey.channels[c].locks;
+      energy[c] += shard->receivers[c].energy;
+      frames[c] += shard->receivers[c].frames;
+    }
+
+    free(shard->survey.records);
+  }
+
+  free(shards);
+  if (failed) {
+    survey_free(survey);
+    return -1;
+  }
+
+  if (survey->count > 0)
+    qsort(survey->records, survey->count, sizeof(*survey->records), compare_records);
+
+  survey->samples = chunks * chunk_samples;
+  for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++) {
+    double power              = frames[c] ? energy[c] / frames[c] : 0;
+    survey->channels[c].power = power > 0 ? 10 * log10(power) : -INFINITY;
+  }
+
+  return 0;
+}
+
+void survey_free(struct survey *survey)
+{
+  free(survey->records);
+  survey->records = NULL;
+  survey->count   = 0;
+}
@@ -0,0 +1,283 @@
+#include <math.h>
+#include <string.h>
+
+#include "wavebird/despread.h"
+#include "wavebird/radio.h"
+
+#include "traffic/fsk.h"
+#include "traffic/traffic.h"
+
+// Message header bit which is always set by real controllers
+#define HEADER_ALWAYS_SET (1 << 11)
+
+// Transmission timing, from the start of the carrier, see fsk.h
+#define PERIOD_NS       ((int64_t)TRAFFIC_PACKET_PERIOD_US * 1000)
+#define BIT_NS          ((int64_t)WAVEBIRD_DSSS_CHIPS * 1000000000 / WAVEBIRD_RADIO_CHIP_RATE)
+#define PACKET_START_NS (FSK_CARRIER_US * 1000 + (FSK_FRAME_BITS - WAVEBIRD_PACKET_BITS) * BIT_NS)
+#define TRANSMISSION_NS (FSK_CARRIER_US * 1000 + FSK_FRAME_BITS * BIT_NS)
+
+// How far the stick moves towards its target in each packet, for TRAFFIC_SCRIPT_PLAY
+#define PLAY_STICK_SPEED 6
+
+// Uniformly distributed random number
+static inline uint32_t random_u32(struct traffic_generator *generator)
+{
+  generator->seed ^= generator->seed << 13;
+  generator->seed ^= generator->seed >> 17;
+  generator->seed ^= generator->seed << 5;
+  return generator->seed;
+}
+
+// Uniformly distributed random number in [0, 1)
+static inline float random_uniform(struct traffic_generator *generator)
+{
+  return (random_u32(generator) >> 8) * (1.0f / (1 << 24));
+}
+
+// Uniformly distributed random integer in [0, n)
+static inline uint32_t random_below(struct traffic_generator *generator, uint32_t n)
+{
+  return (uint64_t)random_u32(generator) * n >> 32;
+}
+
+// Write a big-endian bit field into an 11-byte message, starting after the 4 bits of padding at the start
+static void put_bits(uint8_t *message, int *bit, uint32_t value, int count)
+{
+  for (int i = count - 1; i >= 0; i--, (*bit)++) {
+    int position = *bit + 4;
+    if (value >> i & 1)
+      message[position / 8] |= 0x80 >> (position % 8);
+  }
+}
+
+// Pack a controller's current state into an input state or origin message
+static void pack_message(uint8_t *message, const struct traffic_controller *controller, bool origin)
+{
+  int bit = 0;
+  memset(message, 0, WAVEBIRD_MESSAGE_BYTES);
+
+  put_bits(message, &bit, HEADER_ALWAYS_SET | (origin ? WB_MESSAGE_HEADER_ORIGIN : 0) | controller->controller_id, 16);
+  if (!origin)
+    put_bits(message, &bit, controller->buttons, 12);
+
+  const uint8_t *analog = origin ? controller->origin : controller->analog;
+  for (int i = 0; i < 6; i++)
+    put_bits(message, &bit, analog[i], 8);
+}
+
+// Move a stick axis towards a target
+static uint8_t approach(uint8_t value, uint8_t target, int speed)
+{
+  if (value + speed < target)
+    return value + speed;
+  if (value - speed > target)
+    return value - speed;
+
+  return target;
+}
+
+// Advance a controller's scripted input state to its next packet
+static void run_script(struct traffic_generator *generator, struct traffic_controller *controller)
+{
+  uint32_t packet = controller->packets;
+
+  switch (controller->script) {
+    case TRAFFIC_SCRIPT_CIRCLE: {
+      float angle           = 2.0f * (float)M_PI * (packet % TRAFFIC_ORIGIN_INTERVAL) / TRAFFIC_ORIGIN_INTERVAL;
+      controller->analog[0] = controller->origin[0] + lrintf(100.0f * cosf(angle));
+      controller->analog[1] = controller->origin[1] + lrintf(100.0f * sinf(angle));
+      controller->buttons   = (packet / TRAFFIC_ORIGIN_INTERVAL) % 2 ? WB_BUTTONS_A : 0;
+      break;
+    }
+
+    case TRAFFIC_SCRIPT_PLAY:
+      // Press a new button, or nothing, for 50-300ms
+      if (packet >= controller->hold_until) {
+        controller->buttons    = random_below(generator, 2) ? 1 << random_below(generator, 12) : 0;
+        controller->hold_until = packet + 12 + random_below(generator, 64);
+      }
+
+      // Move the stick towards a target, and pick a new one once it gets there
+      for (int i = 0; i < 2; i++) {
+        controller->analog[i] = approach(controller->analog[i], controller->stick_target[i], PLAY_STICK_SPEED);
+        if (controller->analog[i] == controller->stick_target[i])
+          controller->stick_target[i] = 28 + random_below(generator, 200);
+      }
+
+      // Fully press the analog triggers along with the digital L and R buttons
+      controller->analog[4] = controller->buttons & WB_BUTTONS_L ? 0xFF : controller->origin[4];
+      controller->analog[5] = controller->buttons & WB_BUTTONS_R ? 0xFF : controller->origin[5];
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Geometrically distributed number of error-free bits before the next bit error
+static int error_free_bits(struct traffic_generator *generator)
+{
+  float skip = logf(1.0f - random_uniform(generator)) / log1pf(-generator->model.bit_error_rate);
+  return skip < WAVEBIRD_PACKET_BITS ? (int)skip : WAVEBIRD_PACKET_BITS;
+}
+
+// Replace a range of packet bits with random values
+static void randomize_bits(struct traffic_generator *generator, uint8_t *packet, int start, int length)
+{
+  for (int i = start; i < start + length && i < WAVEBIRD_PACKET_BITS; i++) {
+    if (random_u32(generator) & 1)
+      packet[i / 8] ^= 0x80 >> (i % 8);
+  }
+}
+
+// Corrupt the bits of a packet which overlap transmissions from the other controllers on the channel
+static void apply_co_channel(struct traffic_generator *generator, const struct traffic_controller *controller,
+                             struct capture_record *record)
+{
+  for (int i = 0; i < generator->controller_count; i++) {
+    const struct traffic_controller *other = &generator->controllers[i];
+    if (other == controller || controller->rssi >= other->rssi + TRAFFIC_CAPTURE_DB)
+      continue;
+
+    // The other controller's transmissions starting in the previous and current period can overlap the packet
+    int64_t offset_ns = (int64_t)(other->offset_us + TRAFFIC_PACKET_PERIOD_US - controller->offset_us) %
+                        TRAFFIC_PACKET_PERIOD_US * 1000;
+    for (int64_t start_ns = offset_ns - PERIOD_NS; start_ns < TRANSMISSION_NS; start_ns += PERIOD_NS) {
+      // Nothing was sent before the first period
+      if ((int64_t)record->timestamp_us * 1000 + start_ns < 0)
+        continue;
+
+      int64_t first = (start_ns - PACKET_START_NS) / BIT_NS;
+      int64_t end   = (start_ns + TRANSMISSION_NS - PACKET_START_NS + BIT_NS - 1) / BIT_NS;
+      first         = first < 0 ? 0 : first;
+      end           = end > WAVEBIRD_PACKET_BITS ? WAVEBIRD_PACKET_BITS : end;
+      if (first >= end)
+        continue;
+
+      randomize_bits(generator, record->packet, first, end - first);
+      record->flags |= CAPTURE_FLAG_COLLISION;
+    }
+  }
+}
+
+// Send a packet from a controller through the channel model
+static void apply_channel(struct traffic_generator *generator, const struct traffic_controller *controller,
+                          struct capture_record *record)
+{
+  const struct traffic_model *model = &generator->model;
+  uint8_t sent[WAVEBIRD_PACKET_BYTES];
+  memcpy(sent, record->packet, sizeof(sent));
+
+  // Random bit errors, skipping straight to each error
+  if (model->bit_error_rate > 0) {
+    for (int i = error_free_bits(generator); i < WAVEBIRD_PACKET_BITS; i += 1 + error_free_bits(generator))
+      record->packet[i / 8] ^= 0x80 >> (i % 8);
+  }
+
+  // Error bursts, from short bursts of interference
+  if (random_uniform(generator) < model->burst_rate)
+    randomize_bits(generator, record->packet, random_below(generator, WAVEBIRD_PACKET_BITS), model->burst_bits);
+
+  // Collisions with other channel users, where another transmission overlaps the start or end of the packet
+  if (random_uniform(generator) < model->collision_rate) {
+    int overlap = 8 + random_below(generator, WAVEBIRD_PACKET_BITS - 8);
+    int start   = random_below(generator, 2) ? 0 : WAVEBIRD_PACKET_BITS - overlap;
+    randomize_bits(generator, record->packet, start, overlap);
+    record->flags |= CAPTURE_FLAG_COLLISION;
+  }
+
+  // Collisions with the other controllers on the channel
+  if (model->co_channel_collisions)
+    apply_co_channel(generator, controller, record);
+
+  if (record->flags & CAPTURE_FLAG_COLLISION)
+    generator->collisions++;
+
+  int errors = 0;
+  for (int i = 0; i < WAVEBIRD_PACKET_BYTES; i++)
+    errors += __builtin_popcount(sent[i] ^ record->packet[i]);
+
+  record->bit_errors = errors > UINT8_MAX ? UINT8_MAX : errors;
+  generator->bit_errors += errors;
+}
+
+void traffic_init(struct traffic_generator *generator, uint32_t seed)
+{
+  memset(generator, 0, sizeof(*generator));
+  generator->seed = seed ? seed : 1;
+}
+
+struct traffic_controller *traffic_add_controller(struct traffic_generator *generator, uint16_t controller_id,
+                                                  uint8_t script)
+{
+  if (generator->controller_count == TRAFFIC_MAX_CONTROLLERS)
+    return NULL;
+
+  struct traffic_controller *controller = &generator->controllers[generator->controller_count];
+  memset(controller, 0, sizeof(*controller));
+  controller->controller_id = controller_id & WB_MESSAGE_HEADER_CONTROLLER_ID;
+  controller->script        = script;
+  controller->rssi          = -40 - (int)random_below(generator, 40);
+  controller->offset_us     = random_below(generator, TRAFFIC_PACKET_PERIOD_US);
+
+  // Sticks rest slightly off center, and the analog triggers slightly pressed
+  for (int i = 0; i < 4; i++)
+    controller->origin[i] = 0x78 + random_below(generator, 16);
+  for (int i = 4; i < 6; i++)
+    controller->origin[i] = 0x10 + random_below(generator, 16);
+
+  memcpy(controller->analog, controller->origin, sizeof(controller->analog));
+  memcpy(controller->stick_target, controller->origin, sizeof(controller->stick_target));
+
+  // Keep the transmit order sorted by offset, so packets are generated in timestamp order
+  int position = generator->controller_count++;
+  while (position > 0 && generator->controllers[generator->order[position - 1]].offset_us > controller->offset_us) {
+    generator->order[position] = generator->order[position - 1];
+    position--;
+  }
+  generator->order[position] = controller - generator->controllers;
+
+  return controller;
+}
+
+void traffic_next(struct traffic_generator *generator, struct capture_record *record, uint8_t *message)
+{
+  uint8_t sent[WAVEBIRD_MESSAGE_BYTES];
+
+  while (true) {
+    struct traffic_controller *controller = &generator->controllers[generator->order[generator->next_controller]];
+    uint64_t timestamp_us = generator->period * TRAFFIC_PACKET_PERIOD_US + controller->offset_us;
+    if (++generator->next_controller == generator->controller_count) {
+      generator->next_controller = 0;
+      generator->period++;
+    }
+
+    // Controllers send their origin when powered on, and then once per second
+    bool origin = controller->packets % TRAFFIC_ORIGIN_INTERVAL == 0;
+    if (!origin)
+      run_script(generator, controller);
+
+    pack_message(sent, controller, origin);
+    controller->packets++;
+    generator->sent++;
+
+    // Lost packets never reach the receiver
+    if (random_uniform(generator) < generator->model.drop_rate) {
+      generator->dropped++;
+      continue;
+    }
+
+    memset(record, 0, sizeof(*record));
+    record->timestamp_us = timestamp_us;
+    record->channel      = generator->channel;
+    record->rssi         = controller->rssi - 2 + (int)random_below(generator, 5);
+    record->flags        = CAPTURE_FLAG_SYNTHETIC;
+    wavebird_packet_encode(record->packet, sent);
+    apply_channel(generator, controller, record);
+
+    if (message)
+      memcpy(message, sent, WAVEBIRD_MESSAGE_BYTES);
+
+    return;
+  }
+}
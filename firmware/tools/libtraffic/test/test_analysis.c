@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "traffic/analysis.h"
+#include "traffic/traffic.h"
+
+#define PACKETS 20000
+
+static struct capture_record records[PACKETS];
+static struct analysis single, threaded;
+
+static void test_analysis_clean_channel()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 7);
+  traffic_add_controller(&generator, 0x2B1, TRAFFIC_SCRIPT_IDLE);
+  traffic_add_controller(&generator, 0x038, TRAFFIC_SCRIPT_CIRCLE);
+
+  // 4 seconds of traffic from each controller
+  int packets = 2 * 4 * TRAFFIC_ORIGIN_INTERVAL;
+  for (int i = 0; i < packets; i++)
+    traffic_next(&generator, &records[i], NULL);
+
+  TEST_ASSERT_EQUAL(0, analysis_run(&single, records, packets, 3));
+  TEST_ASSERT_EQUAL_UINT32(packets, single.records);
+  TEST_ASSERT_EQUAL_UINT32(packets, single.decoded);
+  TEST_ASSERT_EQUAL_UINT32(packets, single.corrected_bits[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, single.crc_failures + single.decode_failures + single.unattributed);
+
+  const struct analysis_controller *idle = &single.controllers[0x2B1], *circle = &single.controllers[0x038];
+  TEST_ASSERT_EQUAL_UINT32(packets / 2, idle->packets);
+  TEST_ASSERT_EQUAL_UINT32(4, idle->origins);
+  TEST_ASSERT_EQUAL_UINT32(packets / 2 - 1, idle->gaps[0]);
+  TEST_ASSERT_EQUAL_UINT32(TRAFFIC_PACKET_PERIOD_US, idle->max_gap_us);
+  TEST_ASSERT_EQUAL_UINT32(0, idle->input_changes);
+
+  // The circling stick changes position on most packets
+  TEST_ASSERT_EQUAL_UINT32(packets / 2, circle->packets);
+  TEST_ASSERT_GREATER_THAN(packets / 4, circle->input_changes);
+  TEST_ASSERT_EQUAL_UINT32(0, single.controllers[0x100].packets);
+}
+
+static void test_analysis_threads_match()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 1234);
+  generator.model.bit_error_rate = 0.005f;
+  generator.model.burst_rate     = 0.02f;
+  generator.model.burst_bits     = 8;
+  generator.model.drop_rate      = 0.1f;
+  for (int i = 0; i < 4; i++)
+    traffic_add_controller(&generator, 0x200 + i * 0x31, TRAFFIC_SCRIPT_PLAY);
+
+  for (int i = 0; i < PACKETS; i++)
+    traffic_next(&generator, &records[i], NULL);
+
+  // Results don't depend on how the capture is split between threads
+  TEST_ASSERT_EQUAL(0, analysis_run(&single, records, PACKETS, 1));
+  for (int threads = 2; threads <= 8; threads += 3) {
+    TEST_ASSERT_EQUAL(0, analysis_run(&threaded, records, PACKETS, threads));
+    TEST_ASSERT_EQUAL_MEMORY(&single, &threaded, sizeof(single));
+  }
+
+  // Every record is accounted for
+  uint64_t decoded = 0, failures = single.unattributed, gaps = 0, lost = 0;
+  for (int i = 0; i < ANALYSIS_CONTROLLERS; i++) {
+    const struct analysis_controller *controller = &single.controllers[i];
+    decoded += controller->packets;
+    failures += controller->crc_failures + controller->decode_failures;
+    for (int j = 0; j < ANALYSIS_GAP_BINS; j++)
+      gaps += controller->gaps[j];
+    lost += controller->gaps[1] + controller->gaps[2] + controller->gaps[3];
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(PACKETS, single.records);
+  TEST_ASSERT_EQUAL_UINT32(single.decoded, decoded);
+  TEST_ASSERT_EQUAL_UINT32(single.crc_failures + single.decode_failures, failures);
+  TEST_ASSERT_EQUAL_UINT32(PACKETS, decoded + failures);
+  TEST_ASSERT_EQUAL_UINT32(decoded - 4, gaps);
+
+  // Dropped packets show up as gaps
+  TEST_ASSERT_GREATER_THAN(generator.dropped / 2, lost);
+}
+
+void test_analysis(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_analysis_clean_channel);
+  RUN_TEST(test_analysis_threads_match);
+}
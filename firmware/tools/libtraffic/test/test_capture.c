@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "traffic/capture.h"
+
+static void test_capture_roundtrip()
+{
+  struct capture_record records[3] = {
+      {.timestamp_us = 1000, .channel = 3, .rssi = -50, .flags = CAPTURE_FLAG_SYNTHETIC},
+      {.timestamp_us = 5000, .channel = 3, .rssi = -51, .bit_errors = 2},
+      {.timestamp_us = 9000, .channel = 3, .rssi = -49, .flags = CAPTURE_FLAG_COLLISION},
+  };
+  records[1].packet[0] = 0xA5;
+
+  FILE *file = tmpfile();
+  TEST_ASSERT_NOT_NULL(file);
+  TEST_ASSERT_EQUAL(0, capture_write_header(file));
+  TEST_ASSERT_EQUAL(0, capture_write_records(file, records, 3));
+  TEST_ASSERT_EQUAL(sizeof(struct capture_header) + 3 * sizeof(struct capture_record), ftell(file));
+
+  // Read the file back
+  rewind(file);
+  struct capture_header header;
+  struct capture_record read[3];
+  TEST_ASSERT_EQUAL(1, fread(&header, sizeof(header), 1, file));
+  TEST_ASSERT_EQUAL(0, capture_check_header(&header));
+  TEST_ASSERT_EQUAL(3, fread(read, sizeof(read[0]), 3, file));
+  TEST_ASSERT_EQUAL_MEMORY(records, read, sizeof(records));
+
+  fclose(file);
+}
+
+static void test_capture_check_header()
+{
+  struct capture_header header = {CAPTURE_MAGIC, CAPTURE_VERSION, sizeof(struct capture_record)};
+  TEST_ASSERT_EQUAL(0, capture_check_header(&header));
+
+  header.version = CAPTURE_VERSION + 1;
+  TEST_ASSERT_EQUAL(-1, capture_check_header(&header));
+
+  header.version     = CAPTURE_VERSION;
+  header.record_size = 16;
+  TEST_ASSERT_EQUAL(-1, capture_check_header(&header));
+
+  header.record_size = sizeof(struct capture_record);
+  header.magic       = 0;
+  TEST_ASSERT_EQUAL(-1, capture_check_header(&header));
+}
+
+void test_capture(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_capture_roundtrip);
+  RUN_TEST(test_capture_check_header);
+}
@@ -0,0 +1,109 @@
+#include <math.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "traffic/channelizer.h"
+
+#define BINS       32
+#define DECIMATION (BINS / 2)
+#define FRAMES     512
+#define SAMPLES    (FRAMES * DECIMATION)
+#define SETTLE     (2 * CHANNELIZER_TAPS_PER_BIN)
+
+static int16_t samples[2 * SAMPLES];
+static float output_re[BINS][CHANNELIZER_MAX_FRAMES(SAMPLES, BINS)];
+static float output_im[BINS][CHANNELIZER_MAX_FRAMES(SAMPLES, BINS)];
+
+// Channelize a tone at a frequency in cycles per sample, outputting every bin in order
+static size_t channelize_tone(double frequency, double amplitude)
+{
+  for (int i = 0; i < SAMPLES; i++) {
+    samples[2 * i]     = lrint(32767 * amplitude * cos(2 * M_PI * frequency * i));
+    samples[2 * i + 1] = lrint(32767 * amplitude * sin(2 * M_PI * frequency * i));
+  }
+
+  uint8_t outputs[BINS];
+  float *re[BINS], *im[BINS];
+  for (int i = 0; i < BINS; i++) {
+    outputs[i] = i;
+    re[i]      = output_re[i];
+    im[i]      = output_im[i];
+  }
+
+  struct channelizer channelizer;
+  TEST_ASSERT_EQUAL(0, channelizer_init(&channelizer, BINS, CHANNELIZER_FORMAT_CS16, outputs, BINS));
+
+  // Push in uneven chunks
+  size_t frames = 0;
+  for (int i = 0; i < SAMPLES; i += 1000) {
+    int chunk = SAMPLES - i < 1000 ? SAMPLES - i : 1000;
+    frames += channelizer_push(&channelizer, re, im, samples + 2 * i, chunk);
+    for (int b = 0; b < BINS; b++) {
+      re[b] = output_re[b] + frames;
+      im[b] = output_im[b] + frames;
+    }
+  }
+
+  return frames;
+}
+
+// Average power of a bin's output, once the filter has settled
+static double bin_power(int bin, size_t frames)
+{
+  double power = 0;
+  for (size_t i = SETTLE; i < frames; i++)
+    power += output_re[bin][i] * output_re[bin][i] + output_im[bin][i] * output_im[bin][i];
+
+  return power / (frames - SETTLE);
+}
+
+static void test_channelizer_tone_isolation()
+{
+  // Tones 300 kHz above the center of bin 5 and 500 kHz below bin -3, with 2.4 MHz bins
+  static const struct {
+    int bin;
+    double offset;
+  } tones[] = {{5, 0.125}, {BINS - 3, -0.208}};
+
+  for (int t = 0; t < 2; t++) {
+    double frequency = (tones[t].bin - (tones[t].bin >= BINS / 2 ? BINS : 0) + tones[t].offset) / BINS;
+    size_t frames    = channelize_tone(frequency, 0.5);
+    TEST_ASSERT_EQUAL(FRAMES, frames);
+
+    // The tone comes out of its own bin at full strength, and at least 50 dB down everywhere but the bins either side
+    TEST_ASSERT_FLOAT_WITHIN(0.25 * 0.05, 0.25, bin_power(tones[t].bin, frames));
+    for (int bin = 0; bin < BINS; bin++) {
+      int distance = (bin - tones[t].bin + BINS) % BINS;
+      if (distance > 1 && distance < BINS - 1)
+        TEST_ASSERT_LESS_THAN(0.25 * 1e-5, bin_power(bin, frames));
+    }
+
+    // At the tone's offset from the bin center, with a continuous phase from frame to frame
+    int bin = tones[t].bin;
+    for (size_t i = SETTLE; i < frames; i++) {
+      float cross    = output_im[bin][i] * output_re[bin][i - 1] - output_re[bin][i] * output_im[bin][i - 1];
+      float dot      = output_re[bin][i] * output_re[bin][i - 1] + output_im[bin][i] * output_im[bin][i - 1];
+      double advance = atan2(cross, dot) / (2 * M_PI) / DECIMATION * BINS;
+      TEST_ASSERT_FLOAT_WITHIN(0.001, tones[t].offset, advance);
+    }
+  }
+}
+
+static void test_channelizer_invalid()
+{
+  struct channelizer channelizer;
+  uint8_t outputs[] = {0, 40};
+  TEST_ASSERT_EQUAL(-1, channelizer_init(&channelizer, 48, CHANNELIZER_FORMAT_CS8, outputs, 1));
+  TEST_ASSERT_EQUAL(-1, channelizer_init(&channelizer, 128, CHANNELIZER_FORMAT_CS8, outputs, 1));
+  TEST_ASSERT_EQUAL(-1, channelizer_init(&channelizer, 32, CHANNELIZER_FORMAT_CS8, outputs, 2));
+  TEST_ASSERT_EQUAL(0, channelizer_init(&channelizer, 64, CHANNELIZER_FORMAT_CS8, outputs, 2));
+}
+
+void test_channelizer(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_channelizer_tone_isolation);
+  RUN_TEST(test_channelizer_invalid);
+}
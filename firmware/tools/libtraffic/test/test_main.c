@@ -0,0 +1,28 @@
+#include "unity.h"
+
+extern void test_analysis();
+extern void test_capture();
+extern void test_channelizer();
+extern void test_survey();
+extern void test_traffic();
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+
+  test_analysis();
+  test_capture();
+  test_channelizer();
+  test_survey();
+  test_traffic();
+
+  return UNITY_END();
+}
@@ -0,0 +1,169 @@
+#include <math.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "wavebird/despread.h"
+
+#include "traffic/channelizer.h"
+#include "traffic/fsk.h"
+#include "traffic/survey.h"
+#include "traffic/traffic.h"
+
+#define SAMPLE_RATE      76800000
+#define CENTER_FREQUENCY 2443200000
+#define DURATION_US      21000
+#define SAMPLES          ((size_t)SAMPLE_RATE / 1000 * DURATION_US / 1000)
+#define MAX_PACKETS      32
+
+// Time from the start of a transmission to the end of its packet
+#define TRANSMISSION_US (FSK_CARRIER_US + FSK_FRAME_BITS * WAVEBIRD_DSSS_CHIPS * 1000 / (WAVEBIRD_RADIO_CHIP_RATE / 1000))
+
+static float recording_re[SAMPLES];
+static float recording_im[SAMPLES];
+static int8_t recording[2 * SAMPLES];
+
+// Packets sent on each channel
+struct transmissions {
+  struct capture_record records[WAVEBIRD_RADIO_CHANNELS][MAX_PACKETS];
+  int count[WAVEBIRD_RADIO_CHANNELS];
+};
+
+// Gaussian noise, from a xorshift PRNG
+static float gaussian(uint32_t *seed)
+{
+  float u[2];
+  for (int i = 0; i < 2; i++) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    u[i] = ((*seed >> 8) + 0.5f) * (1.0f / (1 << 24));
+  }
+
+  return sqrtf(-2 * logf(u[0])) * cosf(2 * (float)M_PI * u[1]);
+}
+
+// Record a controller on each of the given WaveBird channels, with some noise, at 8 bits per sample
+static void build_recording(struct transmissions *sent, const uint8_t *channels, int channel_count)
+{
+  static const uint8_t channel_map[WAVEBIRD_RADIO_CHANNELS] = WAVEBIRD_RADIO_CHANNEL_MAP;
+
+  memset(sent, 0, sizeof(*sent));
+  memset(recording_re, 0, sizeof(recording_re));
+  memset(recording_im, 0, sizeof(recording_im));
+
+  for (int i = 0; i < channel_count; i++) {
+    uint8_t channel = channels[i];
+    double offset   = WAVEBIRD_RADIO_BASE_FREQUENCY + (double)channel_map[channel] * WAVEBIRD_RADIO_CHANNEL_SPACING -
+                    CENTER_FREQUENCY;
+
+    struct traffic_generator generator;
+    traffic_init(&generator, 0x57500021 + i);
+    traffic_add_controller(&generator, 0x100 + i * 0x51, TRAFFIC_SCRIPT_PLAY);
+    generator.channel = channel;
+
+    // Only keep the packets which finish before the end of the recording
+    struct capture_record record;
+    for (traffic_next(&generator, &record, NULL); record.timestamp_us + TRANSMISSION_US < DURATION_US;
+         traffic_next(&generator, &record, NULL)) {
+      size_t start = record.timestamp_us * SAMPLE_RATE / 1000000;
+      fsk_modulate(recording_re, recording_im, SAMPLES, SAMPLE_RATE, offset, start, record.packet, 0.08f);
+      sent->records[channel][sent->count[channel]++] = record;
+    }
+  }
+
+  uint32_t seed = 0x57500022;
+  for (size_t i = 0; i < SAMPLES; i++) {
+    recording[2 * i]     = lrintf(127 * (recording_re[i] + 0.01f * gaussian(&seed)));
+    recording[2 * i + 1] = lrintf(127 * (recording_im[i] + 0.01f * gaussian(&seed)));
+  }
+}
+
+static void test_survey_all_channels()
+{
+  // Controllers on the channel indexes at both edges of the band, and two in the middle
+  static const uint8_t channels[] = {0, 2, 7, 12};
+  static struct transmissions sent;
+  build_recording(&sent, channels, sizeof(channels));
+
+  struct survey_config config = {SAMPLE_RATE, CENTER_FREQUENCY, CHANNELIZER_FORMAT_CS8};
+  struct survey survey;
+  TEST_ASSERT_EQUAL(0, survey_run(&survey, &config, recording, SAMPLES, 1));
+  TEST_ASSERT_EQUAL_UINT32(SAMPLES, survey.samples);
+
+  // Every packet is found on its own channel, shortly after its transmission ends
+  int found[WAVEBIRD_RADIO_CHANNELS] = {0};
+  for (size_t i = 0; i < survey.count; i++) {
+    const struct capture_record *record = &survey.records[i];
+    TEST_ASSERT_LESS_THAN(WAVEBIRD_RADIO_CHANNELS, record->channel);
+    TEST_ASSERT_LESS_THAN(sent.count[record->channel], found[record->channel]);
+
+    const struct capture_record *expected = &sent.records[record->channel][found[record->channel]++];
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected->packet, record->packet, WAVEBIRD_PACKET_BYTES);
+    TEST_ASSERT_UINT32_WITHIN(2 * SURVEY_CHUNK_US, expected->timestamp_us + TRANSMISSION_US, record->timestamp_us);
+    TEST_ASSERT_INT_WITHIN(3, -22, record->rssi);
+  }
+
+  for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++) {
+    TEST_ASSERT_EQUAL(sent.count[c], found[c]);
+    TEST_ASSERT_EQUAL_UINT32(sent.count[c], survey.channels[c].packets);
+  }
+
+  TEST_ASSERT_GREATER_OR_EQUAL(4, sent.count[0]);
+  survey_free(&survey);
+}
+
+static void test_survey_threads_match()
+{
+  static const uint8_t channels[] = {1, 3, 4, 5, 8, 10, 11, 15};
+  static struct transmissions sent;
+  build_recording(&sent, channels, sizeof(channels));
+
+  struct survey_config config = {SAMPLE_RATE, CENTER_FREQUENCY, CHANNELIZER_FORMAT_CS8};
+  struct survey single, threaded;
+  TEST_ASSERT_EQUAL(0, survey_run(&single, &config, recording, SAMPLES, 1));
+
+  int total = 0;
+  for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++)
+    total += sent.count[c];
+  TEST_ASSERT_EQUAL(total, single.count);
+
+  // Packets straddling the boundaries between threads are only found once, with the same timestamps
+  for (int threads = 2; threads <= 7; threads += 5) {
+    TEST_ASSERT_EQUAL(0, survey_run(&threaded, &config, recording, SAMPLES, threads));
+    TEST_ASSERT_EQUAL(single.count, threaded.count);
+    TEST_ASSERT_EQUAL_MEMORY(single.records, threaded.records, single.count * sizeof(*single.records));
+    for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++)
+      TEST_ASSERT_EQUAL_UINT32(single.channels[c].packets, threaded.channels[c].packets);
+    survey_free(&threaded);
+  }
+
+  survey_free(&single);
+}
+
+static void test_survey_invalid_config()
+{
+  // Not a whole number of bins, too narrow to cover every channel, and not centered on a channel index
+  struct survey_config config = {SAMPLE_RATE, CENTER_FREQUENCY, CHANNELIZER_FORMAT_CS16};
+  TEST_ASSERT_EQUAL(0, survey_check_config(&config));
+  config.sample_rate = 80000000;
+  TEST_ASSERT_EQUAL(-1, survey_check_config(&config));
+  config.sample_rate = 38400000;
+  TEST_ASSERT_EQUAL(-1, survey_check_config(&config));
+  config.sample_rate      = SAMPLE_RATE;
+  config.center_frequency = 2442000000;
+  TEST_ASSERT_EQUAL(-1, survey_check_config(&config));
+  config.sample_rate = 2 * SAMPLE_RATE;
+  TEST_ASSERT_EQUAL(-1, survey_check_config(&config));
+  config.center_frequency = CENTER_FREQUENCY + 2 * WAVEBIRD_RADIO_CHANNEL_SPACING;
+  TEST_ASSERT_EQUAL(0, survey_check_config(&config));
+}
+
+void test_survey(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_survey_all_channels);
+  RUN_TEST(test_survey_threads_match);
+  RUN_TEST(test_survey_invalid_config);
+}
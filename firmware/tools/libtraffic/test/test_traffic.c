@@ -0,0 +1,201 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "traffic/traffic.h"
+#include "wavebird/message.h"
+#include "wavebird/packet.h"
+
+#define PACKETS 10000
+
+static void test_traffic_clean_channel()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 1234);
+  traffic_add_controller(&generator, 0x2B1, TRAFFIC_SCRIPT_IDLE);
+  traffic_add_controller(&generator, 0x038, TRAFFIC_SCRIPT_CIRCLE);
+  traffic_add_controller(&generator, 0x155, TRAFFIC_SCRIPT_PLAY);
+
+  // 10 seconds of traffic from each controller
+  int packets          = 3 * 10 * TRAFFIC_ORIGIN_INTERVAL;
+  int origins          = 0;
+  uint64_t previous_us = 0;
+  for (int i = 0; i < packets; i++) {
+    struct capture_record record;
+    uint8_t sent[WAVEBIRD_MESSAGE_BYTES], decoded[WAVEBIRD_MESSAGE_BYTES];
+    traffic_next(&generator, &record, sent);
+
+    // Every packet decodes back to the message which was sent
+    TEST_ASSERT_EQUAL(0, record.bit_errors);
+    TEST_ASSERT_EQUAL(0, wavebird_packet_decode(decoded, record.packet));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sent, decoded, WAVEBIRD_MESSAGE_BYTES);
+
+    // Packets are generated in timestamp order
+    TEST_ASSERT_GREATER_OR_EQUAL(previous_us, record.timestamp_us);
+    previous_us = record.timestamp_us;
+
+    if (wavebird_message_get_type(decoded) == WB_MESSAGE_TYPE_ORIGIN)
+      origins++;
+  }
+
+  // One origin per controller per second
+  TEST_ASSERT_EQUAL(3 * 10, origins);
+  TEST_ASSERT_EQUAL_UINT32(packets, generator.sent);
+  TEST_ASSERT_EQUAL_UINT32((packets - 1) / 3, previous_us / TRAFFIC_PACKET_PERIOD_US);
+}
+
+static void test_traffic_idle_packets_repeat()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 99);
+  traffic_add_controller(&generator, 0x100, TRAFFIC_SCRIPT_IDLE);
+
+  // Skip the power on origin
+  struct capture_record first, record;
+  traffic_next(&generator, &first, NULL);
+  traffic_next(&generator, &first, NULL);
+
+  for (int i = 2; i < TRAFFIC_ORIGIN_INTERVAL; i++) {
+    traffic_next(&generator, &record, NULL);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(first.packet, record.packet, WAVEBIRD_PACKET_BYTES);
+    TEST_ASSERT_EQUAL_UINT32(first.timestamp_us + (i - 1) * TRAFFIC_PACKET_PERIOD_US, record.timestamp_us);
+  }
+}
+
+static void test_traffic_deterministic()
+{
+  struct traffic_generator a, b;
+  traffic_init(&a, 42);
+  traffic_init(&b, 42);
+  a.model.bit_error_rate = b.model.bit_error_rate = 0.01f;
+
+  for (int i = 0; i < 4; i++) {
+    traffic_add_controller(&a, 0x200 + i, TRAFFIC_SCRIPT_PLAY);
+    traffic_add_controller(&b, 0x200 + i, TRAFFIC_SCRIPT_PLAY);
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    struct capture_record record_a, record_b;
+    traffic_next(&a, &record_a, NULL);
+    traffic_next(&b, &record_b, NULL);
+    TEST_ASSERT_EQUAL_MEMORY(&record_a, &record_b, sizeof(record_a));
+  }
+}
+
+static void test_traffic_channel_model()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 7);
+  traffic_add_controller(&generator, 0x2B1, TRAFFIC_SCRIPT_PLAY);
+  generator.model.bit_error_rate = 0.005f;
+  generator.model.drop_rate      = 0.1f;
+  generator.model.collision_rate = 0.05f;
+
+  int errors = 0, random_errors = 0, collisions = 0;
+  for (int i = 0; i < PACKETS; i++) {
+    struct capture_record record;
+    traffic_next(&generator, &record, NULL);
+
+    // The decoder can't correct more errors than were introduced
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    wavebird_decode_result_t result;
+    int rc = wavebird_packet_decode_ex(message, &result, record.packet);
+    if (record.bit_errors == 0)
+      TEST_ASSERT_EQUAL(0, rc);
+    if (rc >= 0)
+      TEST_ASSERT_LESS_OR_EQUAL(record.bit_errors, result.corrected_bits);
+
+    errors += record.bit_errors;
+    if (record.flags & CAPTURE_FLAG_COLLISION)
+      collisions++;
+    else
+      random_errors += record.bit_errors;
+  }
+
+  // Rates are roughly as configured
+  float ber = (float)random_errors / ((generator.sent - generator.dropped - collisions) * WAVEBIRD_PACKET_BITS);
+  TEST_ASSERT_GREATER_THAN(0.004f, ber);
+  TEST_ASSERT_LESS_THAN(0.006f, ber);
+  TEST_ASSERT_GREATER_THAN(PACKETS / 11, generator.dropped);
+  TEST_ASSERT_LESS_THAN(PACKETS / 8, generator.dropped);
+  TEST_ASSERT_GREATER_THAN(PACKETS / 25, collisions);
+  TEST_ASSERT_LESS_THAN(PACKETS / 15, collisions);
+  TEST_ASSERT_EQUAL_UINT32(errors, generator.bit_errors);
+}
+
+// Two controllers on the channel, transmitting 1ms apart with the given signal strengths
+static void add_overlapping_controllers(struct traffic_generator *generator, int8_t rssi_a, int8_t rssi_b)
+{
+  traffic_add_controller(generator, 0x2B1, TRAFFIC_SCRIPT_PLAY);
+  traffic_add_controller(generator, 0x038, TRAFFIC_SCRIPT_PLAY);
+  generator->model.co_channel_collisions = true;
+
+  generator->controllers[0].offset_us = 0;
+  generator->controllers[0].rssi      = rssi_a;
+  generator->controllers[1].offset_us = 1000;
+  generator->controllers[1].rssi      = rssi_b;
+  generator->order[0]                 = 0;
+  generator->order[1]                 = 1;
+}
+
+// First and one past the last packet bit which differ from the packet that was sent
+static void error_span(const struct capture_record *record, const uint8_t *message, int *first, int *end)
+{
+  uint8_t sent[WAVEBIRD_PACKET_BYTES];
+  wavebird_packet_encode(sent, message);
+
+  *first = WAVEBIRD_PACKET_BITS;
+  *end   = 0;
+  for (int i = 0; i < WAVEBIRD_PACKET_BITS; i++) {
+    if ((sent[i / 8] ^ record->packet[i / 8]) & (0x80 >> (i % 8))) {
+      *first = i < *first ? i : *first;
+      *end   = i + 1;
+    }
+  }
+}
+
+static void test_traffic_co_channel()
+{
+  struct traffic_generator generator;
+  traffic_init(&generator, 5);
+  add_overlapping_controllers(&generator, -50, -52);
+
+  // Packet bits start 600us into each transmission, and each transmission lasts 2183us. The second controller's
+  // transmission overlaps the first's packet from bit 38 on, and the first's overlaps the second's before bit 56.
+  for (int i = 0; i < 2 * TRAFFIC_ORIGIN_INTERVAL; i++) {
+    struct capture_record record;
+    uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+    traffic_next(&generator, &record, message);
+    TEST_ASSERT_TRUE(record.flags & CAPTURE_FLAG_COLLISION);
+    TEST_ASSERT_GREATER_THAN(0, record.bit_errors);
+
+    int first, end;
+    error_span(&record, message, &first, &end);
+    if (i % 2 == 0)
+      TEST_ASSERT_GREATER_OR_EQUAL(38, first);
+    else
+      TEST_ASSERT_LESS_OR_EQUAL(56, end);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2 * TRAFFIC_ORIGIN_INTERVAL, generator.collisions);
+
+  // A much stronger packet survives the collision
+  traffic_init(&generator, 5);
+  add_overlapping_controllers(&generator, -40, -40 - TRAFFIC_CAPTURE_DB);
+  for (int i = 0; i < 2 * TRAFFIC_ORIGIN_INTERVAL; i++) {
+    struct capture_record record;
+    traffic_next(&generator, &record, NULL);
+    TEST_ASSERT_EQUAL(i % 2, record.bit_errors > 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(TRAFFIC_ORIGIN_INTERVAL, generator.collisions);
+}
+
+void test_traffic(void)
+{
+  Unity.TestFile = __FILE_NAME__;
+
+  RUN_TEST(test_traffic_clean_channel);
+  RUN_TEST(test_traffic_idle_packets_repeat);
+  RUN_TEST(test_traffic_deterministic);
+  RUN_TEST(test_traffic_channel_model);
+  RUN_TEST(test_traffic_co_channel);
+}
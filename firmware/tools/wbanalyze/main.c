@@ -0,0 +1,171 @@
+/**
+ * Decode a capture file across multiple threads, and report per-controller
+ * statistics for investigating dropouts.
+ *
+ * Examples:
+ *   wbanalyze capture.wbcp
+ *   wbanalyze -j 8 capture.wbcp
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "traffic/analysis.h"
+#include "traffic/capture.h"
+#include "traffic/traffic.h"
+
+static void usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s [options] CAPTURE\n"
+          "  -j, --threads N          threads to decode with (default: one per CPU)\n",
+          program);
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static double percent(uint64_t count, uint64_t total)
+{
+  return total ? 100.0 * count / total : 0;
+}
+
+static void print_summary(const struct analysis *analysis)
+{
+  double seconds = (analysis->last_us - analysis->first_us) * 1e-6;
+  printf("records:  %llu over %.1f s\n", (unsigned long long)analysis->records, seconds);
+  printf("decoded:  %llu (%.2f%%)\n", (unsigned long long)analysis->decoded,
+         percent(analysis->decoded, analysis->records));
+  printf("failed:   %llu CRC (%.2f%%), %llu decode (%.2f%%), %llu unattributed\n",
+         (unsigned long long)analysis->crc_failures, percent(analysis->crc_failures, analysis->records),
+         (unsigned long long)analysis->decode_failures, percent(analysis->decode_failures, analysis->records),
+         (unsigned long long)analysis->unattributed);
+
+  printf("\ncorrected bits:\n");
+  for (int i = 0; i < ANALYSIS_BIT_BINS; i++) {
+    printf("  %d%s %12llu (%6.2f%%)\n", i, i == ANALYSIS_BIT_BINS - 1 ? "+" : " ",
+           (unsigned long long)analysis->corrected_bits[i], percent(analysis->corrected_bits[i], analysis->decoded));
+  }
+}
+
+static void print_controllers(const struct analysis *analysis)
+{
+  printf("\n%-6s %10s %8s %8s %8s %8s", "id", "packets", "pkt/s", "crc %", "fail %", "changes");
+  for (int i = 0; i < ANALYSIS_GAP_BINS; i++) {
+    char label[16];
+    if (i == ANALYSIS_GAP_BINS - 1)
+      snprintf(label, sizeof(label), ">%u", analysis_gap_bin_start(i) - 1);
+    else if (analysis_gap_bin_start(i + 1) - analysis_gap_bin_start(i) == 1)
+      snprintf(label, sizeof(label), "%u", analysis_gap_bin_start(i));
+    else
+      snprintf(label, sizeof(label), "%u-%u", analysis_gap_bin_start(i), analysis_gap_bin_start(i + 1) - 1);
+    printf(" %9s", label);
+  }
+  printf(" %10s\n", "max gap ms");
+
+  for (int id = 0; id < ANALYSIS_CONTROLLERS; id++) {
+    const struct analysis_controller *controller = &analysis->controllers[id];
+    uint64_t received = controller->packets + controller->crc_failures + controller->decode_failures;
+    if (controller->packets == 0)
+      continue;
+
+    double seconds = (controller->last_us - controller->first_us) * 1e-6;
+    printf("0x%03X  %10llu %8.1f %8.2f %8.2f %8llu", id, (unsigned long long)controller->packets,
+           seconds > 0 ? (controller->packets - 1) / seconds : 0, percent(controller->crc_failures, received),
+           percent(controller->crc_failures + controller->decode_failures, received),
+           (unsigned long long)controller->input_changes);
+    for (int i = 0; i < ANALYSIS_GAP_BINS; i++)
+      printf(" %9llu", (unsigned long long)controller->gaps[i]);
+    printf(" %10.1f\n", controller->max_gap_us * 1e-3);
+  }
+
+  printf("\ngaps are between decoded packets, in %d ms packet periods\n", TRAFFIC_PACKET_PERIOD_US / 1000);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] = {
+      {"threads", required_argument, NULL, 'j'},
+      {"help", no_argument, NULL, 'h'},
+      {0},
+  };
+
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  int option;
+  while ((option = getopt_long(argc, argv, "j:h", options, NULL)) != -1) {
+    switch (option) {
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return option == 'h' ? 0 : 1;
+    }
+  }
+
+  if (threads < 1 || optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Map the whole capture, records are decoded straight from the page cache
+  const char *path = argv[optind];
+  int fd           = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(path);
+    return 1;
+  }
+
+  if ((size_t)st.st_size < sizeof(struct capture_header)) {
+    fprintf(stderr, "%s: not a capture file\n", path);
+    return 1;
+  }
+
+  const uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return 1;
+  }
+  madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+  close(fd);
+
+  if (capture_check_header((const struct capture_header *)data) < 0) {
+    fprintf(stderr, "%s: not a capture file, or an unsupported version\n", path);
+    return 1;
+  }
+
+  const struct capture_record *records = (const struct capture_record *)(data + sizeof(struct capture_header));
+  size_t count                         = (st.st_size - sizeof(struct capture_header)) / sizeof(struct capture_record);
+
+  // Static, the per-controller tables are too large for the stack
+  static struct analysis analysis;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (analysis_run(&analysis, records, count, threads) < 0) {
+    fprintf(stderr, "failed to start %d threads\n", threads);
+    return 1;
+  }
+
+  double seconds = elapsed_seconds(&start);
+  munmap((void *)data, st.st_size);
+
+  print_summary(&analysis);
+  print_controllers(&analysis);
+  fprintf(stderr, "\n%zu records in %.3f s with %d threads, %.2fM records/s\n", count, seconds, threads,
+          count / seconds * 1e-6);
+
+  return 0;
+}
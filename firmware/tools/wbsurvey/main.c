@@ -0,0 +1,224 @@
+/**
+ * Survey every WaveBird channel in a wideband IQ recording, and report the
+ * controllers on each channel and their packet loss.
+ *
+ * Examples:
+ *   wbsurvey recording.cs8
+ *   wbsurvey -r 153600000 -f cs16 -j 8 -o packets.wbcp recording.cs16
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "traffic/analysis.h"
+#include "traffic/capture.h"
+#include "traffic/channelizer.h"
+#include "traffic/survey.h"
+#include "traffic/traffic.h"
+
+static const char *const FORMAT_NAMES[] = {"cs8", "cs16"};
+
+static void usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s [options] RECORDING\n"
+          "  -r, --sample-rate HZ     sample rate, 32 or 64 times the channel spacing (default 76800000)\n"
+          "  -c, --center HZ          center frequency, on a channel index (default 2443200000)\n"
+          "  -f, --format NAME        sample format: cs8 or cs16 (default cs8)\n"
+          "  -j, --threads N          threads to survey with (default: one per CPU)\n"
+          "  -o, --output FILE        write the packets found to a capture file\n",
+          program);
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static double percent(uint64_t count, uint64_t total)
+{
+  return total ? 100.0 * count / total : 0;
+}
+
+// Frequency of a WaveBird channel, in MHz
+static double channel_mhz(int channel)
+{
+  static const uint8_t channel_map[WAVEBIRD_RADIO_CHANNELS] = WAVEBIRD_RADIO_CHANNEL_MAP;
+  return (WAVEBIRD_RADIO_BASE_FREQUENCY + (double)channel_map[channel] * WAVEBIRD_RADIO_CHANNEL_SPACING) * 1e-6;
+}
+
+static void print_channels(const struct survey *survey, double seconds)
+{
+  printf("%-8s %10s %10s %8s %10s\n", "channel", "MHz", "power dB", "locks/s", "packets");
+  for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++) {
+    const struct survey_channel *channel = &survey->channels[c];
+    printf("%-8d %10.1f %10.1f %8.0f %10llu\n", c + 1, channel_mhz(c), channel->power,
+           seconds > 0 ? channel->locks / seconds : 0, (unsigned long long)channel->packets);
+  }
+}
+
+// Report each controller on a channel, and how many of its packets were lost
+static void print_controllers(int channel, const struct analysis *analysis)
+{
+  printf("\nchannel %d:\n", channel + 1);
+  printf("%-6s %10s %8s %8s %8s %8s %10s\n", "id", "packets", "pkt/s", "lost %", "crc %", "fail %", "max gap ms");
+
+  for (int id = 0; id < ANALYSIS_CONTROLLERS; id++) {
+    const struct analysis_controller *controller = &analysis->controllers[id];
+    uint64_t received = controller->packets + controller->crc_failures + controller->decode_failures;
+    if (controller->packets == 0)
+      continue;
+
+    // Controllers send a packet every period, so anything missing between the first and last packet was lost
+    uint64_t span_us  = controller->last_us - controller->first_us;
+    uint64_t expected = (span_us + TRAFFIC_PACKET_PERIOD_US / 2) / TRAFFIC_PACKET_PERIOD_US + 1;
+    double seconds    = span_us * 1e-6;
+    printf("0x%03X  %10llu %8.1f %8.2f %8.2f %8.2f %10.1f\n", id, (unsigned long long)controller->packets,
+           seconds > 0 ? (controller->packets - 1) / seconds : 0,
+           percent(expected > controller->packets ? expected - controller->packets : 0, expected),
+           percent(controller->crc_failures, received),
+           percent(controller->crc_failures + controller->decode_failures, received), controller->max_gap_us * 1e-3);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] = {
+      {"sample-rate", required_argument, NULL, 'r'},
+      {"center", required_argument, NULL, 'c'},
+      {"format", required_argument, NULL, 'f'},
+      {"threads", required_argument, NULL, 'j'},
+      {"output", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {0},
+  };
+
+  struct survey_config config = {76800000, 2443200000, CHANNELIZER_FORMAT_CS8};
+  int threads                 = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *output          = NULL;
+  int format                  = CHANNELIZER_FORMAT_CS8;
+
+  int option;
+  while ((option = getopt_long(argc, argv, "r:c:f:j:o:h", options, NULL)) != -1) {
+    switch (option) {
+      case 'r':
+        config.sample_rate = strtoul(optarg, NULL, 0);
+        break;
+      case 'c':
+        config.center_frequency = strtoull(optarg, NULL, 0);
+        break;
+      case 'f':
+        format = -1;
+        for (int i = 0; i < (int)(sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0])); i++) {
+          if (strcmp(optarg, FORMAT_NAMES[i]) == 0)
+            format = i;
+        }
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return option == 'h' ? 0 : 1;
+    }
+  }
+
+  if (format < 0 || threads < 1 || optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  config.format = format;
+  if (survey_check_config(&config) < 0) {
+    fprintf(stderr, "the recording must be sampled at 32 or 64 times the channel spacing, centered on a channel, "
+                    "and cover every WaveBird channel\n");
+    return 1;
+  }
+
+  // Map the whole recording, samples are channelized straight from the page cache
+  const char *path = argv[optind];
+  int fd           = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(path);
+    return 1;
+  }
+
+  const void *data = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "%s: could not map the recording\n", path);
+    return 1;
+  }
+  madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+  close(fd);
+
+  size_t count = st.st_size / (format == CHANNELIZER_FORMAT_CS16 ? 4 : 2);
+  struct survey survey;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (survey_run(&survey, &config, data, count, threads) < 0) {
+    fprintf(stderr, "failed to start %d threads, or out of memory\n", threads);
+    return 1;
+  }
+
+  double elapsed = elapsed_seconds(&start);
+  double seconds = (double)survey.samples / config.sample_rate;
+  munmap((void *)data, st.st_size);
+
+  if (output) {
+    FILE *file = fopen(output, "wb");
+    if (!file || capture_write_header(file) < 0 || capture_write_records(file, survey.records, survey.count) < 0) {
+      perror(output);
+      return 1;
+    }
+    fclose(file);
+  }
+
+  print_channels(&survey, seconds);
+
+  // Analyze each channel's packets on their own, the same controller ID can turn up on more than one channel
+  static struct analysis analysis;
+  struct capture_record *records = malloc((survey.count ? survey.count : 1) * sizeof(*records));
+  if (!records) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for (int c = 0; c < WAVEBIRD_RADIO_CHANNELS; c++) {
+    size_t channel_count = 0;
+    for (size_t i = 0; i < survey.count; i++) {
+      if (survey.records[i].channel == c)
+        records[channel_count++] = survey.records[i];
+    }
+
+    if (channel_count == 0)
+      continue;
+
+    if (analysis_run(&analysis, records, channel_count, threads) < 0) {
+      fprintf(stderr, "failed to start %d threads\n", threads);
+      return 1;
+    }
+    print_controllers(c, &analysis);
+  }
+
+  free(records);
+  survey_free(&survey);
+
+  fprintf(stderr, "\n%.3f s of recording in %.3f s with %d threads, %.2fx real time\n", seconds, elapsed, threads,
+          elapsed > 0 ? seconds / elapsed : 0);
+
+  return 0;
+}
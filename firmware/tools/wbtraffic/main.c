@@ -0,0 +1,206 @@
+/**
+ * Generate synthetic WaveBird traffic, and write it to a capture file or
+ * decode it in-process.
+ *
+ * Examples:
+ *   wbtraffic -n 1000000 -c 4 --ber 0.002 -o capture.wbcp
+ *   wbtraffic -n 1000000 -c 8 --script play --collision-rate 0.05 --decode
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "traffic/capture.h"
+#include "traffic/traffic.h"
+#include "wavebird/packet.h"
+
+// Records to buffer before writing to the capture file
+#define WRITE_BATCH 1024
+
+static const char *const SCRIPT_NAMES[] = {"idle", "circle", "play"};
+
+static void usage(const char *program)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -n, --packets N          packets to generate (default 15000, one minute of one controller)\n"
+          "  -c, --controllers N      controllers on the channel, 1-%d (default 1)\n"
+          "  -s, --script NAME        input script: idle, circle or play (default play)\n"
+          "  -S, --seed N             PRNG seed (default 1)\n"
+          "  -C, --channel N          0-indexed channel to report (default 0)\n"
+          "      --ber P              probability of each bit being flipped\n"
+          "      --burst-rate P       probability of a packet containing an error burst\n"
+          "      --burst-bits N       length of each error burst (default 8)\n"
+          "      --drop-rate P        probability of a packet being lost\n"
+          "      --collision-rate P   probability of a packet colliding with another channel user\n"
+          "      --no-co-channel      don't corrupt packets which overlap the other controllers' transmissions\n"
+          "  -o, --output FILE        write packets to a capture file\n"
+          "  -d, --decode             decode packets in-process, and report decode statistics\n",
+          program, TRAFFIC_MAX_CONTROLLERS);
+}
+
+static double elapsed_seconds(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option options[] = {
+      {"packets", required_argument, NULL, 'n'},
+      {"controllers", required_argument, NULL, 'c'},
+      {"script", required_argument, NULL, 's'},
+      {"seed", required_argument, NULL, 'S'},
+      {"channel", required_argument, NULL, 'C'},
+      {"ber", required_argument, NULL, 'b'},
+      {"burst-rate", required_argument, NULL, 'r'},
+      {"burst-bits", required_argument, NULL, 'l'},
+      {"drop-rate", required_argument, NULL, 'p'},
+      {"collision-rate", required_argument, NULL, 'x'},
+      {"no-co-channel", no_argument, NULL, 'X'},
+      {"output", required_argument, NULL, 'o'},
+      {"decode", no_argument, NULL, 'd'},
+      {"help", no_argument, NULL, 'h'},
+      {0},
+  };
+
+  uint64_t packets           = 15000;
+  int controllers            = 1;
+  int script                 = TRAFFIC_SCRIPT_PLAY;
+  uint32_t seed              = 1;
+  int channel                = 0;
+  const char *output         = NULL;
+  bool decode                = false;
+  struct traffic_model model = {.burst_bits = 8, .co_channel_collisions = true};
+
+  int option;
+  while ((option = getopt_long(argc, argv, "n:c:s:S:C:o:dh", options, NULL)) != -1) {
+    switch (option) {
+      case 'n':
+        packets = strtoull(optarg, NULL, 0);
+        break;
+      case 'c':
+        controllers = atoi(optarg);
+        break;
+      case 's':
+        script = -1;
+        for (int i = 0; i < (int)(sizeof(SCRIPT_NAMES) / sizeof(SCRIPT_NAMES[0])); i++) {
+          if (strcmp(optarg, SCRIPT_NAMES[i]) == 0)
+            script = i;
+        }
+        break;
+      case 'S':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      case 'C':
+        channel = atoi(optarg);
+        break;
+      case 'b':
+        model.bit_error_rate = atof(optarg);
+        break;
+      case 'r':
+        model.burst_rate = atof(optarg);
+        break;
+      case 'l':
+        model.burst_bits = atoi(optarg);
+        break;
+      case 'p':
+        model.drop_rate = atof(optarg);
+        break;
+      case 'x':
+        model.collision_rate = atof(optarg);
+        break;
+      case 'X':
+        model.co_channel_collisions = false;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'd':
+        decode = true;
+        break;
+      default:
+        usage(argv[0]);
+        return option == 'h' ? 0 : 1;
+    }
+  }
+
+  if (controllers < 1 || controllers > TRAFFIC_MAX_CONTROLLERS || script < 0 || channel < 0 || channel > 15 ||
+      model.drop_rate >= 1.0f || (!output && !decode)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Set up the channel, with controller IDs spread over the ID space
+  struct traffic_generator generator;
+  traffic_init(&generator, seed);
+  generator.channel = channel;
+  generator.model   = model;
+  for (int i = 0; i < controllers; i++)
+    traffic_add_controller(&generator, (0x2B1 + i * 0x95) & WB_MESSAGE_HEADER_CONTROLLER_ID, script);
+
+  FILE *file = NULL;
+  if (output) {
+    file = fopen(output, "wb");
+    if (!file || capture_write_header(file) < 0) {
+      perror(output);
+      return 1;
+    }
+  }
+
+  // Generate the packets in batches
+  struct capture_record records[WRITE_BATCH];
+  uint8_t messages[WRITE_BATCH][WAVEBIRD_MESSAGE_BYTES];
+  uint64_t decoded = 0, wrong = 0, corrected_bits = 0;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (uint64_t done = 0; done < packets;) {
+    size_t batch = packets - done < WRITE_BATCH ? packets - done : WRITE_BATCH;
+    for (size_t i = 0; i < batch; i++)
+      traffic_next(&generator, &records[i], messages[i]);
+
+    if (decode) {
+      for (size_t i = 0; i < batch; i++) {
+        uint8_t message[WAVEBIRD_MESSAGE_BYTES];
+        wavebird_decode_result_t result;
+        if (wavebird_packet_decode_ex(message, &result, records[i].packet) < 0)
+          continue;
+
+        decoded++;
+        corrected_bits += result.corrected_bits;
+        if (memcmp(message, messages[i], WAVEBIRD_MESSAGE_BYTES) != 0)
+          wrong++;
+      }
+    }
+
+    if (file && capture_write_records(file, records, batch) < 0) {
+      perror(output);
+      return 1;
+    }
+
+    done += batch;
+  }
+
+  double seconds = elapsed_seconds(&start);
+  if (file)
+    fclose(file);
+
+  // Report the traffic generated, and what made it through
+  fprintf(stderr, "%llu packets (%.1f s of traffic) in %.3f s, %.2fM packets/s\n", (unsigned long long)packets,
+          (double)generator.period * TRAFFIC_PACKET_PERIOD_US * 1e-6, seconds, packets / seconds * 1e-6);
+  fprintf(stderr, "channel: %llu dropped, %llu collisions, %llu bit errors\n", (unsigned long long)generator.dropped,
+          (unsigned long long)generator.collisions, (unsigned long long)generator.bit_errors);
+
+  if (decode) {
+    fprintf(stderr, "decoded: %llu (%.2f%%), %llu wrong, %llu bits corrected\n", (unsigned long long)decoded,
+            100.0 * decoded / packets, (unsigned long long)wrong, (unsigned long long)corrected_bits);
+  }
+
+  return 0;
+}